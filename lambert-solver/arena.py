@@ -0,0 +1,133 @@
+"""
+Arena allocators for the batch kernel and the trajectory searches.
+
+ScratchArena hands out typed scratch buffers by bumping an offset into large
+preallocated blocks; reset() returns everything in one step at the end of a
+chunk. NodeArena stores search-tree nodes as parallel columns addressed by an
+integer index, so expanding a node appends to a few lists instead of creating
+an object, and a whole generation is dropped with reset().
+"""
+import threading
+from array import array
+
+DEFAULT_BLOCK_SIZE = 1 << 16
+
+class ScratchArena:
+    """
+    Bump allocator for typed scratch buffers.
+
+    :param block_size: Minimum number of items per block
+    """
+    def __init__(self, block_size=DEFAULT_BLOCK_SIZE):
+        self.block_size = block_size
+        self.blocks = {}      # typecode -> list of array blocks
+        self.offsets = {}     # typecode -> offset into the last block
+        self.high_water = {}  # typecode -> most items used in one generation
+        self.used = {}        # typecode -> items used in this generation
+
+    def take(self, n, typecode='d'):
+        """
+        Return a writable memoryview of n items. Contents are not cleared.
+
+        The view stays valid until the next reset().
+        """
+        blocks = self.blocks.setdefault(typecode, [])
+        offset = self.offsets.get(typecode, 0)
+        if not blocks or offset + n > len(blocks[-1]):
+            size = max(n, self.block_size)
+            blocks.append(array(typecode, bytes(size * array(typecode).itemsize)))
+            offset = 0
+        self.offsets[typecode] = offset + n
+        self.used[typecode] = self.used.get(typecode, 0) + n
+        return memoryview(blocks[-1])[offset:offset + n]
+
+    def reset(self):
+        """
+        Release every buffer handed out since the last reset. If a generation
+        needed several blocks, they are replaced by one block big enough for
+        the high-water mark, so steady-state chunks allocate nothing.
+        """
+        for typecode, blocks in self.blocks.items():
+            used = self.used.get(typecode, 0)
+            self.high_water[typecode] = max(self.high_water.get(typecode, 0), used)
+            if len(blocks) > 1:
+                size = max(self.high_water[typecode], self.block_size)
+                self.blocks[typecode] = [array(typecode, bytes(size * array(typecode).itemsize))]
+            self.offsets[typecode] = 0
+            self.used[typecode] = 0
+
+class NodeArena:
+    """
+    Struct-of-arrays storage for search-tree nodes.
+
+    :param fields: Column names, e.g. ('parent', 'body', 'epoch', 'cost')
+    """
+    def __init__(self, fields):
+        self.fields = tuple(fields)
+        self.columns = {name: [] for name in self.fields}
+        self.size = 0
+
+    def allocate(self, **values):
+        """
+        Append a node and return its index. Missing fields are set to None.
+        Slots left over from a previous generation are overwritten in place.
+        """
+        index = self.size
+        for name in self.fields:
+            column = self.columns[name]
+            value = values.get(name)
+            if index < len(column):
+                column[index] = value
+            else:
+                column.append(value)
+        self.size += 1
+        return index
+
+    def get(self, field, index):
+        return self.columns[field][index]
+
+    def set(self, field, index, value):
+        self.columns[field][index] = value
+
+    def path(self, index, parent_field='parent'):
+        """Indices from the root to index, following parent links."""
+        out = []
+        while index is not None:
+            out.append(index)
+            index = self.columns[parent_field][index]
+        out.reverse()
+        return out
+
+    def reset(self):
+        """Drop every node; the column storage is kept for the next generation."""
+        self.size = 0
+
+    def __len__(self):
+        return self.size
+
+_local = threading.local()
+
+def thread_scratch():
+    """ScratchArena owned by the calling thread (one per worker process thread)."""
+    arena = getattr(_local, 'scratch', None)
+    if arena is None:
+        arena = ScratchArena()
+        _local.scratch = arena
+    return arena
+
+def thread_nodes(fields, slot=0):
+    """
+    NodeArena with the given fields owned by the calling thread. Searches
+    reset it when they start, so its columns are reused from one to the next.
+
+    :param slot: Picks one of several arenas with the same fields, e.g. the
+                 two generations of a double-buffered search
+    """
+    arenas = getattr(_local, 'nodes', None)
+    if arenas is None:
+        arenas = {}
+        _local.nodes = arenas
+    key = (tuple(fields), slot)
+    if key not in arenas:
+        arenas[key] = NodeArena(fields)
+    return arenas[key]
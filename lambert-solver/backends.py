@@ -0,0 +1,455 @@
+"""
+Alternative Lambert backends and automatic backend selection.
+
+Besides the universal-variable method of LambertSolver.solve there are three
+backends:
+
+- izzo: Izzo's algorithm (2015) in the Lancaster-Blanchard variable x, in
+  which every time of flight has a single root per revolution count and
+  branch. Time of flight from the Battin series, Lagrange's or Lancaster's
+  expression by distance from the parabola, analytic derivatives and Halley
+  iterations. Handles multi-revolution transfers (left and right branches).
+  It borrows Gooding's use of x but is not Gooding's method.
+- hypergeometric: the same Halley solver in x, but with the time of flight
+  everywhere from Battin's hypergeometric function 2F1(3, 1; 5/2; z),
+  evaluated by Gauss's continued fraction, which stays accurate near 180
+  degrees and near the parabola.
+- battin: Battin's method (Battin and Vaughan, 1984). The problem is mapped
+  to one with the same semi-major axis and eccentric anomaly difference and
+  a pericentre at the mean point, whose equations hold unchanged through 180
+  degrees; x is found by successive substitution through a cubic in y, with
+  Battin's continued fractions xi(x) and K(u). Velocities are recovered in
+  the Lancaster-Blanchard form, with lambda from cos(dnu / 2), rather than
+  from Lagrange coefficients, whose g vanishes at 180 degrees, so it keeps
+  full precision close to 180 degrees. Zero-revolution transfers only.
+
+Every backend takes max_iterations and tolerance, the iteration limit and
+the step size at which its iteration stops.
+
+select_backend picks a backend per regime bucket (see kernel.classify) from a
+policy table; solvers and batches only use it when asked for backend='auto'.
+The table is written by `python benchmark.py policy` to policy_path(), in the
+user's configuration directory, or to a path the caller chooses; without a
+table DEFAULT_POLICY is used.
+"""
+import json
+import math
+import os
+from main import LambertSolver, vector_cross, vector_dot, vector_norm, vector_subtract
+from kernel import BUCKET_NAMES, classify
+
+# Fastest backend per bucket from `python benchmark.py policy 200` (us per
+# solve through solve_batch, CPython 3.11, one core; no backend failed):
+#
+#   bucket          universal   izzo   hypergeometric   battin
+#   near_pi             208      47         132            155
+#   hyperbolic          123      42         102            113
+#   elliptic_fast        62      47         117            130
+#   elliptic             57      31         165            149
+#   elliptic_slow        82      43         211            164
+#   elliptic_long        96      45         222            183
+#
+# Degenerate lanes never reach a backend.
+DEFAULT_POLICY = {
+    'degenerate': 'universal',
+    'near_pi': 'izzo',
+    'hyperbolic': 'izzo',
+    'elliptic_fast': 'izzo',
+    'elliptic': 'izzo',
+    'elliptic_slow': 'izzo',
+    'elliptic_long': 'izzo',
+}
+
+# Distances from x = 1 below which the Battin series and the Lagrange form are used
+BATTIN_DISTANCE = 0.01
+LAGRANGE_DISTANCE = 0.2
+
+def _geometry(r1, r2, clockwise):
+    r1_norm = vector_norm(r1)
+    r2_norm = vector_norm(r2)
+    c = vector_norm(vector_subtract(r2, r1))
+    s = (r1_norm + r2_norm + c) / 2
+    ir1 = [x / r1_norm for x in r1]
+    ir2 = [x / r2_norm for x in r2]
+    ih = vector_cross(ir1, ir2)
+    ih_norm = vector_norm(ih)
+    if ih_norm < 1e-12:
+        raise ValueError("Position vectors are collinear; the transfer plane is undefined.")
+    ih = [x / ih_norm for x in ih]
+    lam = math.sqrt(max(1 - c / s, 0.0))
+    # Same direction convention as LambertSolver.solve: counterclockwise about +z
+    if ih[2] < 0:
+        lam = -lam
+        it1 = vector_cross(ir1, ih)
+        it2 = vector_cross(ir2, ih)
+    else:
+        it1 = vector_cross(ih, ir1)
+        it2 = vector_cross(ih, ir2)
+    if clockwise:
+        lam = -lam
+        it1 = [-x for x in it1]
+        it2 = [-x for x in it2]
+    return lam, s, c, r1_norm, r2_norm, ir1, ir2, it1, it2
+
+def _hypergeometric_series(z, tolerance=1e-11):
+    # 2F1(3, 1; 5/2; z) by its power series, used next to the parabola
+    total = term = 1.0
+    j = 0
+    while True:
+        term *= (3 + j) * (1 + j) / (2.5 + j) * z / (j + 1)
+        total += term
+        j += 1
+        if abs(term) <= tolerance:
+            return total
+
+def _hypergeometric_cf(z, tolerance=1e-15, max_terms=200):
+    # 2F1(3, 1; 5/2; z) = 2F1(3, 0 + 1; 3/2 + 1; z) / 2F1(3, 0; 3/2; z) by
+    # Gauss's continued fraction 1 / (1 - k1 z / (1 - k2 z / ...)), which
+    # converges on the whole cut plane. Evaluated forwards (modified Lentz).
+    a, b, c = 3.0, 0.0, 1.5
+    tiny = 1e-300
+    f = C = 1.0
+    D = 0.0
+    for i in range(1, max_terms + 1):
+        if i % 2:
+            n = (i - 1) // 2
+            k = (a + n) * (c - b + n) / ((c + 2 * n) * (c + 2 * n + 1))
+        else:
+            n = i // 2
+            k = (b + n) * (c - a + n) / ((c + 2 * n - 1) * (c + 2 * n))
+        term = -k * z
+        D = 1 + term * D
+        D = 1 / (D if D != 0 else tiny)
+        C = 1 + term / C
+        if C == 0:
+            C = tiny
+        delta = C * D
+        f *= delta
+        if abs(delta - 1) < tolerance:
+            break
+    return 1 / f
+
+def _tof_lagrange(x, revolutions, lam):
+    a = 1 / (1 - x * x)
+    if a > 0:
+        alpha = 2 * math.acos(x)
+        beta = 2 * math.asin(math.sqrt(lam * lam / a))
+        if lam < 0:
+            beta = -beta
+        return a * math.sqrt(a) * ((alpha - math.sin(alpha)) - (beta - math.sin(beta))
+                                   + 2 * math.pi * revolutions) / 2
+    alpha = 2 * math.acosh(x)
+    beta = 2 * math.asinh(math.sqrt(-lam * lam / a))
+    if lam < 0:
+        beta = -beta
+    return -a * math.sqrt(-a) * ((beta - math.sinh(beta)) - (alpha - math.sinh(alpha))) / 2
+
+def _tof_battin(x, revolutions, lam, hypergeometric):
+    E = x * x - 1
+    eta = math.sqrt(1 + lam * lam * E) - lam * x
+    Q = 4 / 3 * hypergeometric(0.5 * (1 - lam - x * eta))
+    tof = (eta**3 * Q + 4 * lam * eta) / 2
+    if revolutions:
+        tof += revolutions * math.pi / abs(E)**1.5
+    return tof
+
+def tof_izzo(x, revolutions, lam):
+    """Non-dimensional time of flight T(x) for the izzo backend."""
+    distance = abs(x - 1)
+    if distance < BATTIN_DISTANCE:
+        return _tof_battin(x, revolutions, lam, _hypergeometric_series)
+    if distance < LAGRANGE_DISTANCE:
+        return _tof_lagrange(x, revolutions, lam)
+    # Lancaster's expression
+    E = x * x - 1
+    z = math.sqrt(1 + lam * lam * E)
+    y = math.sqrt(abs(E))
+    g = x * z - lam * E
+    if E < 0:
+        d = revolutions * math.pi + math.acos(g)
+    else:
+        d = math.log(y * (z - lam * x) + g)
+    return (x - lam * z - d / y) / E
+
+def tof_hypergeometric(x, revolutions, lam):
+    """Non-dimensional time of flight T(x) for the hypergeometric backend."""
+    return _tof_battin(x, revolutions, lam, _hypergeometric_cf)
+
+def _derivatives(x, T, lam):
+    # First three derivatives of T(x)
+    l2 = lam * lam
+    l3 = l2 * lam
+    umx2 = 1 - x * x
+    y = math.sqrt(1 - l2 * umx2)
+    y3 = y**3
+    dT = (3 * T * x - 2 + 2 * l3 * x / y) / umx2
+    ddT = (3 * T + 5 * x * dT + 2 * (1 - l2) * l3 / y3) / umx2
+    dddT = (7 * x * ddT + 8 * dT - 6 * (1 - l2) * l3 * l2 * x / (y3 * y * y)) / umx2
+    return dT, ddT, dddT
+
+def _halley(T, x, revolutions, lam, tof, tolerance=1e-13, max_iterations=50):
+    for _ in range(max_iterations):
+        T_x = tof(x, revolutions, lam)
+        dT, ddT, _ = _derivatives(x, T_x, lam)
+        delta = T_x - T
+        step = delta * dT / (dT * dT - delta * ddT / 2)
+        x -= step
+        if abs(step) < tolerance:
+            return x
+    raise ValueError(f"No convergence after {max_iterations} iterations")
+
+def minimum_time(lam, revolutions, tof=tof_izzo, max_iterations=50):
+    """Smallest non-dimensional time of flight with the given revolution count."""
+    T00 = math.acos(lam) + lam * math.sqrt(1 - lam * lam)
+    x = 0.0
+    T = T00 + revolutions * math.pi
+    for _ in range(max_iterations):
+        dT, ddT, dddT = _derivatives(x, T, lam)
+        if dT == 0:
+            break
+        step = dT * ddT / (ddT * ddT - dT * dddT / 2)
+        x -= step
+        T = tof(x, revolutions, lam)
+        if abs(step) < 1e-13:
+            break
+    return T
+
+def _initial_guess(T, lam, revolutions, branch):
+    if revolutions == 0:
+        T00 = math.acos(lam) + lam * math.sqrt(1 - lam * lam)
+        T1 = 2 / 3 * (1 - lam**3)
+        if T >= T00:
+            return (T00 / T)**(2 / 3) - 1
+        if T <= T1:
+            return 5 / 2 * T1 / T * (T1 - T) / (1 - lam**5) + 1
+        return (T00 / T)**math.log2(T1 / T00) - 1
+    if branch == 'left':
+        x = ((revolutions * math.pi + math.pi) / (8 * T))**(2 / 3)
+    else:
+        x = ((8 * T) / (revolutions * math.pi))**(2 / 3)
+    return (x - 1) / (x + 1)
+
+def _lancaster_velocities(mu, geometry, x):
+    # Velocities from the root x, in radial and transverse components
+    lam, s, c, r1_norm, r2_norm, ir1, ir2, it1, it2 = geometry
+    gamma = math.sqrt(mu * s / 2)
+    rho = (r1_norm - r2_norm) / c
+    sigma = math.sqrt(1 - rho * rho)
+    y = math.sqrt(1 - lam * lam + lam * lam * x * x)
+    vr1 = gamma * ((lam * y - x) - rho * (lam * y + x)) / r1_norm
+    vr2 = -gamma * ((lam * y - x) + rho * (lam * y + x)) / r2_norm
+    vt = gamma * sigma * (y + lam * x)
+    v1 = [vr1 * ir1[i] + vt / r1_norm * it1[i] for i in range(3)]
+    v2 = [vr2 * ir2[i] + vt / r2_norm * it2[i] for i in range(3)]
+    return v1, v2
+
+def solve_lancaster(mu, r1, r2, dt, clockwise=False, revolutions=0, branch='left', tof=tof_izzo,
+                    max_iterations=50, tolerance=1e-13):
+    """
+    Lambert solution in the Lancaster-Blanchard variable x.
+
+    :param revolutions: Number of complete revolutions
+    :param branch: 'left' or 'right' solution for revolutions > 0
+    :param tof: Time-of-flight function T(x, revolutions, lambda)
+    :param max_iterations: Halley iterations
+    :param tolerance: Halley step in x at which to stop
+    :return: (v1, v2) Initial and final velocity vectors
+    """
+    geometry = _geometry(r1, r2, clockwise)
+    lam, s = geometry[:2]
+    T = math.sqrt(2 * mu / s**3) * dt
+    if revolutions > 0 and T < minimum_time(lam, revolutions, tof):
+        raise ValueError(f"No {revolutions}-revolution solution for this time of flight")
+    x = _halley(T, _initial_guess(T, lam, revolutions, branch), revolutions, lam, tof, tolerance, max_iterations)
+    return _lancaster_velocities(mu, geometry, x)
+
+def solve_izzo(mu, r1, r2, dt, clockwise=False, revolutions=0, branch='left', max_iterations=50, tolerance=1e-13):
+    return solve_lancaster(mu, r1, r2, dt, clockwise, revolutions, branch, tof_izzo, max_iterations, tolerance)
+
+def solve_hypergeometric(mu, r1, r2, dt, clockwise=False, revolutions=0, branch='left', max_iterations=50,
+                         tolerance=1e-13):
+    return solve_lancaster(mu, r1, r2, dt, clockwise, revolutions, branch, tof_hypergeometric, max_iterations,
+                           tolerance)
+
+def _battin_xi(x, tolerance=1e-15, max_terms=100):
+    # xi(x) = 8 (sqrt(1 + x) + 1) / (3 + 1 / (5 + eta + 9/7 eta / (1 + 16/63 eta / (1 + ...)))),
+    # with eta = x / (sqrt(1 + x) + 1)^2 and coefficients n^2 / (4 n^2 - 1) from n = 3.
+    # The inner fraction S = 1/5 / (1 + 9/35 eta / (1 + ...)) is summed forwards.
+    root = math.sqrt(1 + x)
+    eta = x / (1 + root)**2
+    total = term = 0.2
+    d = 1.0
+    for n in range(3, max_terms):
+        d = 1 / (1 + n * n / (4 * n * n - 1) * eta * d)
+        term *= d - 1
+        total += term
+        if abs(term) <= tolerance * abs(total):
+            break
+    return 8 * (1 + root) / (3 + total / (1 + eta * total))
+
+def _battin_k(u, tolerance=1e-15, max_terms=100):
+    # K(u) = 1/3 / (1 + 4/27 u / (1 + 8/27 u / (1 + 2/9 u / (1 + ...)))), whose
+    # coefficients alternate 2 (3n + 2)(6n + 1) / (9 (4n + 1)(4n + 3)) and
+    # 2 (3n + 1)(6n - 1) / (9 (4n - 1)(4n + 1)); summed forwards.
+    total = term = 1 / 3
+    d = 1.0
+    for k in range(max_terms):
+        n, odd = divmod(k, 2)
+        if odd:
+            n += 1
+            gamma = 2 * (3 * n + 1) * (6 * n - 1) / (9 * (4 * n - 1) * (4 * n + 1))
+        else:
+            gamma = 2 * (3 * n + 2) * (6 * n + 1) / (9 * (4 * n + 1) * (4 * n + 3))
+        d = 1 / (1 + gamma * u * d)
+        term *= d - 1
+        total += term
+        if abs(term) <= tolerance * abs(total):
+            break
+    return total
+
+def solve_battin(mu, r1, r2, dt, clockwise=False, revolutions=0, branch='left', max_iterations=50,
+                 tolerance=1e-13):
+    """
+    Lambert solution by Battin's method.
+
+    :param max_iterations: Successive substitutions in x
+    :param tolerance: Change in x, relative once |x| > 1, at which to stop
+    :return: (v1, v2) Initial and final velocity vectors
+    """
+    if revolutions:
+        raise ValueError("The battin backend only solves zero-revolution transfers")
+    geometry = _geometry(r1, r2, clockwise)
+    lam, s, c, r1_norm, r2_norm = geometry[:5]
+    dnu = math.atan2(vector_norm(vector_cross(r1, r2)), vector_dot(r1, r2))
+    if lam < 0:
+        dnu = 2 * math.pi - dnu
+    # lambda without the cancellation in 1 - c / s near 180 degrees
+    lam = math.sqrt(r1_norm * r2_norm) * math.cos(dnu / 2) / s
+    geometry = (lam,) + geometry[1:]
+    # Mean-point pericentre radius rp and the parameters l and m of the transformed problem
+    ratio = r2_norm / r1_norm
+    tan2w = (ratio - 1)**2 / 4 / (math.sqrt(ratio) + ratio * (2 + math.sqrt(ratio)))
+    rp = math.sqrt(r1_norm * r2_norm) * (math.cos(dnu / 4)**2 + tan2w)
+    if dnu < math.pi:
+        l = (math.sin(dnu / 4)**2 + tan2w) / (math.sin(dnu / 4)**2 + tan2w + math.cos(dnu / 2))
+    else:
+        l = (math.cos(dnu / 4)**2 + tan2w - math.cos(dnu / 2)) / (math.cos(dnu / 4)**2 + tan2w)
+    m = mu * dt * dt / (8 * rp**3)
+    x = l
+    for _ in range(max_iterations):
+        xi = _battin_xi(x)
+        denominator = (1 + 2 * x + l) * (4 * x + xi * (3 + x))
+        h1 = (l + x)**2 * (1 + 3 * x + xi) / denominator
+        h2 = m * (x - l + xi) / denominator
+        # Largest root of y^3 - (1 + h1) y^2 - h2 = 0
+        B = 27 * h2 / (4 * (1 + h1)**3)
+        u = B / (2 * (math.sqrt(1 + B) + 1))
+        K = _battin_k(u)
+        y = (1 + h1) / 3 * (2 + math.sqrt(1 + B) / (1 + 2 * u * K * K))
+        x_new = math.sqrt(((1 - l) / 2)**2 + m / (y * y)) - (1 + l) / 2
+        step = x_new - x
+        x = x_new
+        if abs(step) < tolerance * max(1.0, abs(x)):
+            break
+    else:
+        raise ValueError(f"No convergence after {max_iterations} iterations")
+    # x = tan^2(dE / 4) (-tanh^2(dH / 4) for hyperbolas), and s / 2a from
+    # a = mu t^2 / (16 rp^2 x y^2). The Lancaster-Blanchard x is cos(alpha / 2)
+    # with alpha / 2 = dE / 2 + beta / 2 and sin(beta / 2) = lambda sqrt(s / 2a).
+    q = 8 * s * rp * rp * x * y * y / (mu * dt * dt)
+    if x >= 0:
+        half = 2 * math.atan(math.sqrt(x))
+        sin_beta = lam * math.sqrt(q)
+        x_lancaster = math.cos(half) * math.sqrt(1 - sin_beta * sin_beta) - math.sin(half) * sin_beta
+    else:
+        half = 2 * math.atanh(math.sqrt(-x))
+        sinh_beta = lam * math.sqrt(-q)
+        x_lancaster = math.cosh(half) * math.sqrt(1 + sinh_beta * sinh_beta) + math.sinh(half) * sinh_beta
+    return _lancaster_velocities(mu, geometry, x_lancaster)
+
+def solve_universal(mu, r1, r2, dt, clockwise=False, revolutions=0, branch='left', max_iterations=1000,
+                    tolerance=1e-8):
+    if revolutions:
+        raise ValueError("The universal backend only solves zero-revolution transfers")
+    return LambertSolver(mu).solve(r1, r2, dt, clockwise, max_iterations, tolerance)
+
+BACKENDS = {
+    'universal': solve_universal,
+    'izzo': solve_izzo,
+    'hypergeometric': solve_hypergeometric,
+    'battin': solve_battin,
+}
+
+def policy_path():
+    """Default policy file: backend_policy.json in the user's configuration directory."""
+    config = os.environ.get('XDG_CONFIG_HOME') or os.path.join(os.path.expanduser('~'), '.config')
+    return os.path.join(config, 'lambert-solver', 'backend_policy.json')
+
+def load_policy(path=None):
+    """
+    Bucket name -> backend name, from a policy file if there is one.
+
+    :param path: Policy file written by `python benchmark.py policy`; None for policy_path()
+    """
+    policy = dict(DEFAULT_POLICY)
+    if path is None:
+        path = policy_path()
+    if os.path.exists(path):
+        with open(path) as f:
+            policy.update(json.load(f))
+    for name, backend in policy.items():
+        if backend not in BACKENDS:
+            raise ValueError(f"Unknown Lambert backend {backend!r} for bucket {name!r} in {path}")
+    return policy
+
+def resolve_policy(policy=None):
+    """Policy dictionary from a dictionary, a policy file path, or None for the default file."""
+    if isinstance(policy, dict):
+        return {**DEFAULT_POLICY, **policy}
+    return load_policy(policy)
+
+def select_backend(mu, r1, r2, dt, clockwise=False, revolutions=0, policy=None):
+    """
+    Backend name for one problem. Multi-revolution problems always use izzo.
+
+    :param policy: Policy dictionary, e.g. from load_policy(); None loads the default file
+    """
+    if revolutions:
+        return 'izzo'
+    if policy is None:
+        policy = load_policy()
+    bucket, _ = classify(mu, r1, r2, dt, clockwise)
+    return policy[BUCKET_NAMES[bucket]]
+
+def batch_policy(backend, policy=None):
+    """
+    Bucket name -> backend name for a batch solve with the given backend or 'auto'.
+
+    :param policy: For 'auto': policy dictionary or file path, as for resolve_policy
+    """
+    if backend == 'auto':
+        return resolve_policy(policy)
+    if backend not in BACKENDS:
+        raise ValueError(f"Unknown Lambert backend {backend!r}")
+    return {name: backend for name in BUCKET_NAMES}
+
+def solve_with_backend(backend, mu, r1, r2, dt, clockwise=False, revolutions=0, branch='left', policy=None,
+                       max_iterations=None, tolerance=None):
+    """
+    Solve with the named backend, or with the selected one for backend 'auto'.
+
+    :param policy: Policy dictionary for 'auto'; pass one loaded up front when
+                   solving many problems, None loads the default file
+    :param max_iterations: Iteration limit for the backend; None for its default
+    :param tolerance: Step at which the backend's iteration stops; None for its default
+    """
+    if backend == 'auto':
+        backend = select_backend(mu, r1, r2, dt, clockwise, revolutions, policy)
+    if backend not in BACKENDS:
+        raise ValueError(f"Unknown Lambert backend {backend!r}")
+    settings = {}
+    if max_iterations is not None:
+        settings['max_iterations'] = max_iterations
+    if tolerance is not None:
+        settings['tolerance'] = tolerance
+    return BACKENDS[backend](mu, r1, r2, dt, clockwise, revolutions, branch, **settings)
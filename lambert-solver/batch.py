@@ -0,0 +1,746 @@
+import heapq
+import math
+import random
+import sys
+from array import array
+from collections import deque
+from concurrent.futures import ProcessPoolExecutor
+from itertools import chain, islice
+from main import vector_norm, vector_subtract, vector_add, propagate_orbit, solve_in_plane
+from arena import thread_scratch
+from robust import RESIDUAL_TOLERANCE, conservation_residual, escalate
+from kernel import (OK, SMALL_ANGLE, NUMERIC_ERROR, PLANE_ERROR, CHECK_FAILED, RESIDUAL_FAILED, DEGENERATE, ELLIPTIC,
+                    BUCKET_NAMES, BUCKET_INITIAL_Z, BUCKET_Z_RANGE, METRIC_COUNT, METRIC_FIELDS, classify, kepler_miss,
+                    lane_metrics, solve_lanes, propagate_lanes, status_message)
+from backends import BACKENDS, batch_policy
+
+# Work is always split into chunks of this size, whatever the number of workers.
+# Reductions are done per chunk and then combined in chunk order, so results
+# are bitwise identical on 1 or 64 workers.
+DEFAULT_CHUNK_SIZE = 256
+
+def make_chunks(count, chunk_size=DEFAULT_CHUNK_SIZE):
+    """
+    Split range(count) into fixed-shape chunks.
+
+    :param count: Number of items
+    :param chunk_size: Number of items per chunk
+    :return: List of (start, stop) index pairs
+    """
+    if chunk_size < 1:
+        raise ValueError("chunk_size must be at least 1")
+    return [(start, min(start + chunk_size, count)) for start in range(0, count, chunk_size)]
+
+def map_chunks(function, chunk_args, workers=1, placement=None):
+    """
+    Apply function to every chunk argument tuple and return results in chunk order.
+
+    :param function: Module-level function (it must be picklable for workers > 1)
+    :param chunk_args: Argument tuples, one per chunk (a list or a lazy iterable)
+    :param workers: Number of worker processes; 1 runs in the calling process
+    :param placement: Optional numa.NumaPlacement; it then decides the workers
+    :return: List of per-chunk results, ordered like chunk_args
+    """
+    return list(imap_chunks(function, chunk_args, workers, placement))
+
+# Chunks submitted per worker ahead of the one imap_chunks is waiting for
+LOOKAHEAD = 2
+
+def imap_chunks(function, chunk_args, workers=1, placement=None):
+    """
+    Like map_chunks, but yield each chunk result, in chunk order, as soon as it
+    is ready. chunk_args is consumed lazily: only LOOKAHEAD chunks per worker
+    are in flight (per worker of each node with a placement, see
+    numa.NumaPlacement.imap), so a generator of arguments is never
+    materialized and results are not held beyond what the caller keeps.
+    """
+    if placement is not None:
+        yield from placement.imap(function, chunk_args)
+        return
+    chunk_args = iter(chunk_args)
+    head = list(islice(chunk_args, 2))
+    if workers <= 1 or len(head) <= 1:
+        for args in chain(head, chunk_args):
+            yield function(*args)
+        return
+    with ProcessPoolExecutor(max_workers=workers) as executor:
+        pending = deque()
+        for args in chain(head, chunk_args):
+            pending.append(executor.submit(function, *args))
+            if len(pending) >= LOOKAHEAD * workers:
+                yield pending.popleft().result()
+        while pending:
+            yield pending.popleft().result()
+
+# Deterministic reductions
+
+def chunked_sum(values, chunk_size=DEFAULT_CHUNK_SIZE):
+    """
+    Sum values with a fixed reduction shape: exactly rounded sum per chunk,
+    then an exactly rounded sum of the chunk partials. None entries are skipped.
+    """
+    partials = []
+    for start, stop in make_chunks(len(values), chunk_size):
+        partials.append(math.fsum(x for x in values[start:stop] if x is not None))
+    return math.fsum(partials)
+
+def chunked_mean(values, chunk_size=DEFAULT_CHUNK_SIZE):
+    count = sum(1 for x in values if x is not None)
+    if count == 0:
+        return None
+    return chunked_sum(values, chunk_size) / count
+
+def best_index(values):
+    """
+    Index of the smallest value, skipping None. Ties go to the lowest index.
+
+    :return: (index, value) or (None, None) if every value is None
+    """
+    best = (None, None)
+    for i, x in enumerate(values):
+        if x is None:
+            continue
+        if best[1] is None or x < best[1]:
+            best = (i, x)
+    return best
+
+def merge_best(partials):
+    """
+    Merge per-chunk (index, value) minima. Ties go to the lowest global index,
+    so the winner does not depend on how chunks were scheduled.
+    """
+    best = (None, None)
+    for index, value in partials:
+        if value is None:
+            continue
+        if best[1] is None or value < best[1] or (value == best[1] and index < best[0]):
+            best = (index, value)
+    return best
+
+def histogram(values, edges):
+    """
+    Count values into bins [edges[k], edges[k + 1]). None entries are skipped.
+
+    :return: List of integer counts, len(edges) - 1 long
+    """
+    counts = [0] * (len(edges) - 1)
+    for x in values:
+        if x is None or x < edges[0] or x >= edges[-1]:
+            continue
+        lo, hi = 0, len(edges) - 1
+        while hi - lo > 1:
+            mid = (lo + hi) // 2
+            if x >= edges[mid]:
+                lo = mid
+            else:
+                hi = mid
+        counts[lo] += 1
+    return counts
+
+def merge_histograms(partials):
+    counts = [0] * len(partials[0]) if partials else []
+    for partial in partials:
+        for k, c in enumerate(partial):
+            counts[k] += c
+    return counts
+
+# Streaming selection
+
+class Selection:
+    """
+    Which results a sweep or batch keeps instead of materializing all of them.
+
+    :param top_k: Keep only the k smallest values (ties go to the lowest index)
+    :param threshold: Keep only values strictly below threshold
+    :param predicate: Optional predicate(index, value) -> bool; it must be a
+                      module-level function when workers > 1
+    :param key: For solve_batch_select: key(index, problem, v1, v2) -> value,
+                also module-level when workers > 1
+    """
+    def __init__(self, top_k=None, threshold=None, predicate=None, key=None):
+        if top_k is None and threshold is None and predicate is None:
+            raise ValueError("Selection needs top_k, threshold or predicate")
+        if top_k is not None and top_k < 1:
+            raise ValueError("top_k must be at least 1")
+        self.top_k = top_k
+        self.threshold = threshold
+        self.predicate = predicate
+        self.key = key
+
+    def accepts(self, index, value):
+        if value is None:
+            return False
+        if self.threshold is not None and not value < self.threshold:
+            return False
+        return self.predicate is None or self.predicate(index, value)
+
+    def push(self, selected, index, value, payload=None):
+        """
+        Offer one result to a per-chunk selection list. With top_k the list is
+        a bounded max-heap of (-value, -index, payload), so memory stays at k.
+        """
+        if self.accepts(index, value):
+            self._keep(selected, index, value, payload)
+
+    def _keep(self, selected, index, value, payload):
+        if self.top_k is None:
+            selected.append((-value, -index, payload))
+        elif len(selected) < self.top_k:
+            heapq.heappush(selected, (-value, -index, payload))
+        elif (value, index) < (-selected[0][0], -selected[0][1]):
+            heapq.heapreplace(selected, (-value, -index, payload))
+
+    def absorb(self, selected, partial):
+        """
+        Fold one chunk's selection list into a running one. Entries were
+        accepted when they were pushed, so only the top_k bound is applied.
+        """
+        for v, i, p in partial:
+            self._keep(selected, -i, -v, p)
+
+    def entries(self, selected):
+        """(index, value, payload) entries of a selection list, sorted by value, then index."""
+        return [(-i, -v, p) for v, i, p in sorted(selected, key=lambda e: (-e[0], -e[1]))]
+
+    def merge(self, partials):
+        """
+        Merge per-chunk selection lists, as they arrive, into (index, value,
+        payload) entries sorted by value, then index. Only one running list
+        is held, and the order does not depend on scheduling.
+        """
+        selected = []
+        for partial in partials:
+            self.absorb(selected, partial)
+        return self.entries(selected)
+
+# Batch solve
+
+class BatchResult:
+    """
+    Per-problem results of a batch solve, in the original problem order.
+    Failed problems have v1 and v2 set to None and the error message in errors.
+    """
+    def __init__(self, count):
+        self.v1 = [None] * count
+        self.v2 = [None] * count
+        self.errors = [None] * count
+        self.metrics = None  # per-problem dictionaries keyed by kernel.METRIC_FIELDS, if requested
+
+    def __len__(self):
+        return len(self.v1)
+
+    def succeeded(self, i):
+        return self.errors[i] is None
+
+    def failures(self):
+        return sum(1 for e in self.errors if e is not None)
+
+def normalize_problem(problem):
+    """
+    Accept (r1, r2, dt), (r1, r2, dt, clockwise) or (r1, r2, dt, clockwise,
+    plane_normal) and return the 5-tuple form (plane_normal None if not given).
+    """
+    if len(problem) == 3:
+        r1, r2, dt = problem
+        return r1, r2, dt, False, None
+    if len(problem) == 4:
+        r1, r2, dt, clockwise = problem
+        return r1, r2, dt, clockwise, None
+    r1, r2, dt, clockwise, plane_normal = problem
+    return r1, r2, dt, clockwise, plane_normal
+
+def _solve_packed(mu, r1, r2, dt, clockwise, v1_out, v2_out, status_out, scratch,
+                  max_iterations, tolerance, bucketing=True, escalation=True, plane_normal=None,
+                  policy=None, vb1=None, vb2=None, metrics_out=None, check=None):
+    # Solve lanes stored as flat buffers. Lanes are gathered into scratch in
+    # bucket order, solved one contiguous bucket at a time and scattered back.
+    # policy maps bucket names to backends (see backends.py); buckets without
+    # one, or with 'universal', go through the lane kernel.
+    # With escalation, lanes that failed or have a large residual go up the
+    # robust.escalate ladder; a lane whose residual stays large gets
+    # RESIDUAL_FAILED. Lanes with a nonzero plane_normal row skip the
+    # kernel and use main.solve_in_plane. With metrics_out, kernel.lane_metrics
+    # (relative to body velocities vb1 and vb2, if given) is filled in the same
+    # scatter pass. With check, every solved lane's v1 is propagated
+    # analytically (kernel.kepler_miss, seeded with the kernel's converged
+    # universal anomaly where there is one) and lanes whose relative arrival miss exceeds check
+    # get CHECK_FAILED. Failed lanes get NaN velocities and metrics.
+    n = len(dt)
+    in_plane = [plane_normal is not None and any(plane_normal[3 * i:3 * i + 3]) for i in range(n)]
+    if bucketing:
+        buckets = [(DEGENERATE, False) if in_plane[i] else
+                   classify(mu, r1[3 * i:3 * i + 3], r2[3 * i:3 * i + 3], dt[i],
+                            clockwise is not None and clockwise[i], tolerance) for i in range(n)]
+        order = sorted(range(n), key=lambda i: buckets[i])
+    else:
+        buckets = [(DEGENERATE, False) if in_plane[i] else (ELLIPTIC, False) for i in range(n)]
+        order = sorted(range(n), key=lambda i: buckets[i])
+    lane_r1 = scratch.take(3 * n)
+    lane_r2 = scratch.take(3 * n)
+    lane_dt = scratch.take(n)
+    lane_cw = scratch.take(n, 'b')
+    lane_v1 = scratch.take(3 * n)
+    lane_v2 = scratch.take(3 * n)
+    lane_status = scratch.take(n, 'b')
+    lane_chi = None
+    if check is not None:
+        lane_chi = scratch.take(n)
+        for lane in range(n):
+            lane_chi[lane] = float('nan')
+    for lane, i in enumerate(order):
+        lane_r1[3 * lane:3 * lane + 3] = r1[3 * i:3 * i + 3]
+        lane_r2[3 * lane:3 * lane + 3] = r2[3 * i:3 * i + 3]
+        lane_dt[lane] = dt[i]
+        lane_cw[lane] = clockwise is not None and bool(clockwise[i])
+    # One kernel call per contiguous bucket
+    start = 0
+    while start < n:
+        bucket = buckets[order[start]]
+        stop = start + 1
+        while stop < n and buckets[order[stop]] == bucket:
+            stop += 1
+        backend = policy.get(BUCKET_NAMES[bucket[0]], 'universal') if policy and bucketing else 'universal'
+        if bucket[0] == DEGENERATE:
+            for lane in range(start, stop):
+                lane_status[lane] = SMALL_ANGLE
+        elif backend != 'universal':
+            solve = BACKENDS[backend]
+            for lane in range(start, stop):
+                try:
+                    v1, v2 = solve(mu, lane_r1[3 * lane:3 * lane + 3], lane_r2[3 * lane:3 * lane + 3],
+                                   lane_dt[lane], bool(lane_cw[lane]), max_iterations=max_iterations,
+                                   tolerance=tolerance)
+                    lane_v1[3 * lane:3 * lane + 3] = array('d', v1)
+                    lane_v2[3 * lane:3 * lane + 3] = array('d', v2)
+                    lane_status[lane] = OK
+                except (ValueError, ZeroDivisionError, OverflowError):
+                    lane_status[lane] = NUMERIC_ERROR
+        else:
+            if bucketing:
+                initial_z = BUCKET_INITIAL_Z[bucket[0]]
+                z_range = BUCKET_Z_RANGE[bucket[0]]
+            else:
+                initial_z = 0.0
+                z_range = (None, None)
+            solve_lanes(mu, lane_r1[3 * start:3 * stop], lane_r2[3 * start:3 * stop], lane_dt[start:stop],
+                        lane_cw[start:stop], lane_v1[3 * start:3 * stop], lane_v2[3 * start:3 * stop],
+                        lane_status[start:stop], scratch, max_iterations, tolerance, initial_z, z_range,
+                        None if lane_chi is None else lane_chi[start:stop])
+        start = stop
+    nan = float('nan')
+    for lane, i in enumerate(order):
+        if in_plane[i]:
+            try:
+                v1, v2 = solve_in_plane(mu, r1[3 * i:3 * i + 3], r2[3 * i:3 * i + 3], dt[i],
+                                        plane_normal[3 * i:3 * i + 3], bool(lane_cw[lane]),
+                                        max_iterations, tolerance)
+                lane_status[lane] = OK
+                lane_v1[3 * lane:3 * lane + 3] = array('d', v1)
+                lane_v2[3 * lane:3 * lane + 3] = array('d', v2)
+            except (ValueError, ZeroDivisionError, OverflowError):
+                lane_status[lane] = PLANE_ERROR
+        elif escalation:
+            p1, p2 = r1[3 * i:3 * i + 3], r2[3 * i:3 * i + 3]
+            if (lane_status[lane] != OK or conservation_residual(
+                    mu, p1, p2, lane_v1[3 * lane:3 * lane + 3], lane_v2[3 * lane:3 * lane + 3]) > RESIDUAL_TOLERANCE):
+                retried = escalate(mu, p1, p2, dt[i], bool(lane_cw[lane]))
+                if retried is None:
+                    # A kernel result whose residual no tier could bring down is not kept
+                    if lane_status[lane] == OK:
+                        lane_status[lane] = RESIDUAL_FAILED
+                else:
+                    lane_status[lane] = OK
+                    lane_v1[3 * lane:3 * lane + 3] = array('d', retried[0])
+                    lane_v2[3 * lane:3 * lane + 3] = array('d', retried[1])
+                    if lane_chi is not None:
+                        lane_chi[lane] = float('nan')
+        if check is not None and lane_status[lane] == OK and kepler_miss(
+                mu, r1[3 * i:3 * i + 3], lane_v1[3 * lane:3 * lane + 3], r2[3 * i:3 * i + 3], dt[i],
+                lane_chi[lane], lane_v2[3 * lane:3 * lane + 3]) > check:
+            lane_status[lane] = CHECK_FAILED
+        status_out[i] = lane_status[lane]
+        if lane_status[lane] == OK:
+            v1_out[3 * i:3 * i + 3] = lane_v1[3 * lane:3 * lane + 3]
+            v2_out[3 * i:3 * i + 3] = lane_v2[3 * lane:3 * lane + 3]
+            if metrics_out is not None:
+                metrics_out[METRIC_COUNT * i:METRIC_COUNT * (i + 1)] = array('d', lane_metrics(
+                    mu, r1[3 * i:3 * i + 3], lane_v1[3 * lane:3 * lane + 3],
+                    r2[3 * i:3 * i + 3], lane_v2[3 * lane:3 * lane + 3],
+                    None if vb1 is None else vb1[3 * i:3 * i + 3],
+                    None if vb2 is None else vb2[3 * i:3 * i + 3]))
+        else:
+            for k in range(3):
+                v1_out[3 * i + k] = v2_out[3 * i + k] = nan
+            if metrics_out is not None:
+                for k in range(METRIC_COUNT):
+                    metrics_out[METRIC_COUNT * i + k] = nan
+
+def _solve_chunk(mu, problems, max_iterations, tolerance, bucketing=True, escalation=True, policy=None,
+                 velocities=None, metrics=False, check=None):
+    # Inputs, outputs and kernel intermediates all come from the worker's
+    # scratch arena and are released together when the chunk is done.
+    # Returns (v1, v2, error) per problem, or (v1, v2, error, metrics) with
+    # metrics a kernel.METRIC_FIELDS tuple (None on failure) if metrics is
+    # set; velocities optionally gives (vb1, vb2) body velocities per problem.
+    scratch = thread_scratch()
+    n = len(problems)
+    r1 = scratch.take(3 * n)
+    r2 = scratch.take(3 * n)
+    dt = scratch.take(n)
+    clockwise = scratch.take(n, 'b')
+    v1 = scratch.take(3 * n)
+    v2 = scratch.take(3 * n)
+    status = scratch.take(n, 'b')
+    plane_normal = None
+    if any(len(p) > 4 and p[4] is not None for p in problems):
+        plane_normal = scratch.take(3 * n)
+    for i, p in enumerate(problems):
+        r1[3 * i:3 * i + 3] = array('d', p[0])
+        r2[3 * i:3 * i + 3] = array('d', p[1])
+        dt[i] = p[2]
+        clockwise[i] = bool(p[3])
+        if plane_normal is not None:
+            plane_normal[3 * i:3 * i + 3] = array('d', p[4] if len(p) > 4 and p[4] is not None else (0, 0, 0))
+    vb1 = vb2 = metrics_out = None
+    if velocities is not None:
+        vb1 = scratch.take(3 * n)
+        vb2 = scratch.take(3 * n)
+        for i, (b1, b2) in enumerate(velocities):
+            vb1[3 * i:3 * i + 3] = array('d', b1)
+            vb2[3 * i:3 * i + 3] = array('d', b2)
+    if metrics:
+        metrics_out = scratch.take(METRIC_COUNT * n)
+    _solve_packed(mu, r1, r2, dt, clockwise, v1, v2, status, scratch, max_iterations, tolerance,
+                  bucketing, escalation, plane_normal, policy, vb1, vb2, metrics_out, check)
+    out = []
+    for i in range(n):
+        if status[i] == OK:
+            entry = (v1[3 * i:3 * i + 3].tolist(), v2[3 * i:3 * i + 3].tolist(), None)
+        else:
+            entry = (None, None, status_message(status[i], max_iterations))
+        if metrics:
+            entry += (tuple(metrics_out[METRIC_COUNT * i:METRIC_COUNT * (i + 1)]) if status[i] == OK else None,)
+        out.append(entry)
+    scratch.reset()
+    return out
+
+def solve_batch(solver, problems, workers=1, chunk_size=DEFAULT_CHUNK_SIZE,
+                max_iterations=1000, tolerance=1e-8, bucketing=True, escalation=True, backend='universal',
+                metrics=False, body_velocities=None, check=None, placement=None):
+    """
+    Solve many Lambert problems.
+
+    :param solver: LambertSolver providing mu
+    :param problems: List of (r1, r2, dt), (r1, r2, dt, clockwise) or
+                     (r1, r2, dt, clockwise, plane_normal) tuples; a plane normal
+                     (e.g. of a reference orbit) makes collinear problems solvable
+    :param workers: Number of worker processes
+    :param chunk_size: Problems per chunk (fixes the reduction shape)
+    :param bucketing: Sort each chunk into regime buckets with their own starting z;
+                      False (with escalation=False) reproduces LambertSolver.solve exactly
+    :param escalation: Retry failed or inaccurate problems with the robust.py ladder
+    :param backend: 'universal' (the lane kernel), 'izzo', 'hypergeometric', 'battin',
+                    or 'auto' to pick one per regime bucket from the benchmark's policy
+                    table (see backends.py). max_iterations and tolerance bound every
+                    backend's iteration
+    :param metrics: Also compute energy, C3, v-infinities, total Δv and the transfer
+                    orbit's a, e and i (kernel.METRIC_FIELDS) in the solve pass
+    :param body_velocities: Optional (vb1, vb2) per problem for C3, the v-infinities and Δv,
+                            which are NaN without them
+    :param check: Relative arrival-miss tolerance for an analytic propagation of
+                  each solution (e.g. 1e-6); lanes above it fail. None to skip
+    :param placement: Optional numa.NumaPlacement for the worker processes
+    :return: BatchResult in the original problem order
+    """
+    problems = [normalize_problem(p) for p in problems]
+    chunks = make_chunks(len(problems), chunk_size)
+    policy = batch_policy(backend, solver.policy)
+    args = ((solver.mu, problems[start:stop], max_iterations, tolerance, bucketing, escalation, policy,
+             None if body_velocities is None else body_velocities[start:stop], metrics, check)
+            for start, stop in chunks)
+    result = BatchResult(len(problems))
+    if metrics:
+        result.metrics = [None] * len(problems)
+    for (start, _), chunk_out in zip(chunks, imap_chunks(_solve_chunk, args, workers, placement)):
+        for k, entry in enumerate(chunk_out):
+            result.v1[start + k] = entry[0]
+            result.v2[start + k] = entry[1]
+            result.errors[start + k] = entry[2]
+            if metrics and entry[3] is not None:
+                result.metrics[start + k] = dict(zip(METRIC_FIELDS, entry[3]))
+    return result
+
+def _select_chunk(mu, problems, start, select, max_iterations, tolerance, policy=None):
+    selected = []
+    for k, (v1, v2, error) in enumerate(_solve_chunk(mu, problems, max_iterations, tolerance, policy=policy)):
+        if error is None:
+            index = start + k
+            select.push(selected, index, select.key(index, problems[k], v1, v2), (v1, v2))
+    return selected
+
+def solve_batch_select(solver, problems, select, workers=1, chunk_size=DEFAULT_CHUNK_SIZE,
+                       max_iterations=1000, tolerance=1e-8, backend='universal', placement=None):
+    """
+    Solve many Lambert problems but keep only the results picked by select.
+
+    :param select: Selection with a key(index, problem, v1, v2) function
+    :return: List of (index, value, (v1, v2)) sorted by value, then index
+    """
+    if select.key is None:
+        raise ValueError("solve_batch_select needs a Selection with a key function")
+    problems = [normalize_problem(p) for p in problems]
+    chunks = make_chunks(len(problems), chunk_size)
+    policy = batch_policy(backend, solver.policy)
+    args = ((solver.mu, problems[start:stop], start, select, max_iterations, tolerance, policy)
+            for start, stop in chunks)
+    return select.merge(imap_chunks(_select_chunk, args, workers, placement))
+
+# Buffer interface
+
+_NATIVE_ORDER = '<' if sys.byteorder == 'little' else '>'
+
+def _native(view, typecodes):
+    # True if view holds native-endian items of one of typecodes, however the
+    # exporter spells the format ('d', '@d', '<d' from ctypes, ...).
+    fmt = view.format
+    if fmt[:1] in ('@', '=', _NATIVE_ORDER):
+        fmt = fmt[1:]
+    return fmt in typecodes
+
+def _flatten(values):
+    for x in values:
+        if isinstance(x, (list, tuple)):
+            yield from _flatten(x)
+        else:
+            yield x
+
+def as_doubles(values):
+    """
+    Flat float64 view of values. C-contiguous float64 buffers (array('d'),
+    NumPy float64 arrays of any shape, ...) are viewed without copying; other
+    buffers and nested sequences are copied into an array('d').
+    """
+    try:
+        view = memoryview(values)
+    except TypeError:
+        return memoryview(array('d', _flatten(values)))
+    if _native(view, 'd') and view.c_contiguous:
+        return view.cast('B').cast('d')
+    return memoryview(array('d', _flatten(view.tolist())))
+
+def _as_flags(values, n):
+    if values is None:
+        return None
+    try:
+        view = memoryview(values)
+    except TypeError:
+        return memoryview(array('b', (bool(x) for x in values)))
+    if _native(view, 'bB?') and view.c_contiguous and view.nbytes == n:
+        return view.cast('B')
+    return memoryview(array('b', (bool(x) for x in _flatten(view.tolist()))))
+
+def _output(values, n, typecode, name):
+    # Caller-supplied outputs must be writable and exactly typed, since they
+    # are written in place; missing outputs are allocated here.
+    if values is None:
+        values = array(typecode, bytes(n * array(typecode).itemsize))
+    view = memoryview(values)
+    if view.readonly or not view.c_contiguous or not _native(view, typecode):
+        raise ValueError(f"{name} must be a writable C-contiguous buffer of type '{typecode}'")
+    view = view.cast('B').cast(typecode)
+    if len(view) != n:
+        raise ValueError(f"{name} must hold {n} items, not {len(view)}")
+    return values, view
+
+def _doubles(data):
+    return None if data is None else memoryview(data).cast('d')
+
+def _solve_array_chunk(mu, r1, r2, dt, clockwise, plane_normal, max_iterations, tolerance, bucketing, escalation,
+                       policy, vb1=None, vb2=None, metrics=False, check=None):
+    # Worker side of solve_batch_arrays: buffers cross the process boundary as bytes.
+    scratch = thread_scratch()
+    r1 = memoryview(r1).cast('d')
+    n = len(r1) // 3
+    v1 = scratch.take(3 * n)
+    v2 = scratch.take(3 * n)
+    status = scratch.take(n, 'b')
+    metrics_out = scratch.take(METRIC_COUNT * n) if metrics else None
+    _solve_packed(mu, r1, _doubles(r2), _doubles(dt), None if clockwise is None else memoryview(clockwise),
+                  v1, v2, status, scratch, max_iterations, tolerance, bucketing, escalation,
+                  _doubles(plane_normal), policy, _doubles(vb1), _doubles(vb2), metrics_out, check)
+    out = bytes(v1), bytes(v2), bytes(status), None if metrics_out is None else bytes(metrics_out)
+    scratch.reset()
+    return out
+
+def solve_batch_arrays(solver, r1, r2, dt, clockwise=None, plane_normal=None,
+                       v1_out=None, v2_out=None, status_out=None,
+                       workers=1, chunk_size=DEFAULT_CHUNK_SIZE, max_iterations=1000, tolerance=1e-8,
+                       bucketing=True, escalation=True, backend='universal', vb1=None, vb2=None,
+                       metrics=False, metrics_out=None, check=None, placement=None):
+    """
+    Solve many Lambert problems given as flat buffers.
+
+    Inputs and outputs may be any buffer-protocol objects (array('d'), NumPy
+    arrays, ...). C-contiguous float64 inputs are read in place and outputs are
+    written in place; in a single process no problem data is copied.
+
+    :param r1: n x 3 departure positions (km), any shape with 3n float64 items
+    :param r2: n x 3 arrival positions (km)
+    :param dt: n times of flight (s)
+    :param clockwise: Optional n direction flags (bool or int8)
+    :param plane_normal: Optional n x 3 transfer plane normals; rows of zeros mean none
+    :param v1_out: Optional preallocated 3n float64 buffer for departure velocities
+    :param v2_out: Optional preallocated 3n float64 buffer for arrival velocities
+    :param status_out: Optional preallocated n int8 buffer for kernel status codes
+                       (kernel.OK on success, see kernel.status_message)
+    :param backend: Backend name or 'auto', as for solve_batch
+    :param vb1: Optional n x 3 departure body velocities for the metrics
+    :param vb2: Optional n x 3 arrival body velocities for the metrics (C3, v-infinities
+                and Δv are NaN without them)
+    :param metrics: Compute kernel.METRIC_FIELDS per problem in the solve pass
+    :param metrics_out: Optional preallocated n x 8 float64 buffer for the metrics
+                        (implies metrics)
+    :param check: Relative arrival-miss tolerance for the analytic self-check, as for solve_batch
+    :return: (v1_out, v2_out, status_out), plus metrics_out when metrics are
+             computed; allocated as array objects when not supplied. Failed
+             lanes have NaN velocities and metrics
+    """
+    r1 = as_doubles(r1)
+    r2 = as_doubles(r2)
+    dt = as_doubles(dt)
+    n = len(dt)
+    if len(r1) != 3 * n or len(r2) != 3 * n:
+        raise ValueError("r1 and r2 must hold three components per time of flight")
+    clockwise = _as_flags(clockwise, n)
+    policy = batch_policy(backend, solver.policy)
+    vectors = {}
+    for name, values in (('plane_normal', plane_normal), ('vb1', vb1), ('vb2', vb2)):
+        if values is not None:
+            values = as_doubles(values)
+            if len(values) != 3 * n:
+                raise ValueError(f"{name} must hold three components per time of flight")
+        vectors[name] = values
+    v1_out, v1 = _output(v1_out, 3 * n, 'd', 'v1_out')
+    v2_out, v2 = _output(v2_out, 3 * n, 'd', 'v2_out')
+    status_out, status = _output(status_out, n, 'b', 'status_out')
+    metrics = metrics or metrics_out is not None
+    metrics_view = None
+    if metrics:
+        metrics_out, metrics_view = _output(metrics_out, METRIC_COUNT * n, 'd', 'metrics_out')
+
+    def rows(name, start, stop):
+        values = vectors[name]
+        return None if values is None else values[3 * start:3 * stop]
+
+    chunks = make_chunks(n, chunk_size)
+    if placement is None and (workers <= 1 or len(chunks) <= 1):
+        scratch = thread_scratch()
+        for start, stop in chunks:
+            _solve_packed(solver.mu, r1[3 * start:3 * stop], r2[3 * start:3 * stop], dt[start:stop],
+                          None if clockwise is None else clockwise[start:stop],
+                          v1[3 * start:3 * stop], v2[3 * start:3 * stop], status[start:stop],
+                          scratch, max_iterations, tolerance, bucketing, escalation,
+                          rows('plane_normal', start, stop), policy, rows('vb1', start, stop), rows('vb2', start, stop),
+                          None if metrics_view is None else metrics_view[METRIC_COUNT * start:METRIC_COUNT * stop],
+                          check)
+            scratch.reset()
+    else:
+        def as_bytes(values):
+            return None if values is None else bytes(values)
+        args = ((solver.mu, bytes(r1[3 * start:3 * stop]), bytes(r2[3 * start:3 * stop]), bytes(dt[start:stop]),
+                 None if clockwise is None else bytes(clockwise[start:stop]),
+                 as_bytes(rows('plane_normal', start, stop)), max_iterations, tolerance, bucketing, escalation,
+                 policy, as_bytes(rows('vb1', start, stop)), as_bytes(rows('vb2', start, stop)), metrics, check)
+                for start, stop in chunks)
+        for (start, stop), (chunk_v1, chunk_v2, chunk_status, chunk_metrics) in zip(
+                chunks, imap_chunks(_solve_array_chunk, args, workers, placement)):
+            v1[3 * start:3 * stop] = memoryview(chunk_v1).cast('d')
+            v2[3 * start:3 * stop] = memoryview(chunk_v2).cast('d')
+            status[start:stop] = memoryview(chunk_status).cast('b')
+            if metrics:
+                metrics_view[METRIC_COUNT * start:METRIC_COUNT * stop] = memoryview(chunk_metrics).cast('d')
+    if metrics:
+        return v1_out, v2_out, status_out, metrics_out
+    return v1_out, v2_out, status_out
+
+def _propagate_array_chunk(mu, r0, v0, dt, num_steps):
+    r0 = memoryview(r0).cast('d')
+    r_out = array('d', bytes(len(r0) * 8))
+    v_out = array('d', bytes(len(r0) * 8))
+    propagate_lanes(mu, r0, memoryview(v0).cast('d'), memoryview(dt).cast('d'), r_out, v_out, num_steps)
+    return r_out.tobytes(), v_out.tobytes()
+
+def propagate_batch_arrays(mu, r0, v0, dt, r_out=None, v_out=None, num_steps=1000, workers=1,
+                           chunk_size=DEFAULT_CHUNK_SIZE, placement=None):
+    """
+    RK4-propagate many states given as flat buffers (see solve_batch_arrays).
+
+    :param r0: n x 3 initial positions (km)
+    :param v0: n x 3 initial velocities (km/s)
+    :param dt: n propagation times (s)
+    :param r_out: Optional preallocated 3n float64 buffer for final positions
+    :param v_out: Optional preallocated 3n float64 buffer for final velocities
+    :return: (r_out, v_out)
+    """
+    r0 = as_doubles(r0)
+    v0 = as_doubles(v0)
+    dt = as_doubles(dt)
+    n = len(dt)
+    if len(r0) != 3 * n or len(v0) != 3 * n:
+        raise ValueError("r0 and v0 must hold three components per propagation time")
+    r_out, r = _output(r_out, 3 * n, 'd', 'r_out')
+    v_out, v = _output(v_out, 3 * n, 'd', 'v_out')
+    chunks = make_chunks(n, chunk_size)
+    if placement is None and (workers <= 1 or len(chunks) <= 1):
+        propagate_lanes(mu, r0, v0, dt, r, v, num_steps)
+        return r_out, v_out
+    args = ((mu, bytes(r0[3 * start:3 * stop]), bytes(v0[3 * start:3 * stop]), bytes(dt[start:stop]), num_steps)
+            for start, stop in chunks)
+    for (start, stop), (chunk_r, chunk_v) in zip(chunks, imap_chunks(_propagate_array_chunk, args, workers, placement)):
+        r[3 * start:3 * stop] = memoryview(chunk_r).cast('d')
+        v[3 * start:3 * stop] = memoryview(chunk_v).cast('d')
+    return r_out, v_out
+
+# Monte Carlo dispersion
+
+def _dispersion_chunk(mu, r1, v1, r2, dt, sigma_v, seed, chunk_index, count, num_steps, edges):
+    # One random stream per chunk, seeded from the chunk index, so the samples
+    # do not depend on which worker runs the chunk.
+    rng = random.Random(seed * 1000003 + chunk_index)
+    misses = []
+    for _ in range(count):
+        dv = [rng.gauss(0.0, sigma_v) for _ in range(3)]
+        r_end, _ = propagate_orbit(r1, vector_add(v1, dv), dt, mu, num_steps)
+        misses.append(vector_norm(vector_subtract(r_end, r2)))
+    worst = max(misses) if misses else None
+    return math.fsum(misses), len(misses), worst, histogram(misses, edges)
+
+def monte_carlo_dispersion(solver, r1, r2, dt, sigma_v, samples, seed=0, workers=1,
+                           chunk_size=DEFAULT_CHUNK_SIZE, num_steps=200, edges=None, placement=None):
+    """
+    Disperse the Lambert departure velocity and measure the arrival miss distance.
+
+    :param sigma_v: Standard deviation of the velocity error per axis (km/s)
+    :param samples: Number of Monte Carlo samples
+    :param seed: Base random seed
+    :param num_steps: RK4 steps per propagation
+    :param edges: Histogram bin edges for the miss distance (km)
+    :param placement: Optional numa.NumaPlacement for the worker processes
+    :return: Dictionary with mean_miss, max_miss and histogram
+    """
+    v1, _ = solver.solve(r1, r2, dt)
+    if edges is None:
+        edges = [0.0, 1.0, 10.0, 100.0, 1000.0, float('inf')]
+    chunks = make_chunks(samples, chunk_size)
+    args = [(solver.mu, r1, v1, r2, dt, sigma_v, seed, k, stop - start, num_steps, edges)
+            for k, (start, stop) in enumerate(chunks)]
+    partials = map_chunks(_dispersion_chunk, args, workers, placement)
+    total = math.fsum(p[0] for p in partials)
+    count = sum(p[1] for p in partials)
+    worst = max((p[2] for p in partials if p[2] is not None), default=None)
+    return {
+        'mean_miss': total / count if count else None,
+        'max_miss': worst,
+        'histogram': merge_histograms([p[3] for p in partials]),
+        'edges': edges,
+    }
@@ -0,0 +1,138 @@
+"""
+Throughput benchmark for the batch and sweep engines.
+
+Runs solve_batch on a mixed LEO-GEO batch and porkchop_sweep on an
+Earth-Mars grid, once with plain worker processes and once with a
+numa.NumaPlacement (per-node pools, pinned workers, per-worker ephemeris
+replicas), and prints timings together with the placement report.
+
+Usage: python benchmark.py [workers] [problems] [grid side]
+       python benchmark.py policy [problems per bucket] [policy file]
+
+The policy command times every Lambert backend on each regime bucket and
+writes the fastest reliable one per bucket to the policy file (by default
+backends.policy_path(), in the user's configuration directory), which
+backend='auto' solves then use.
+"""
+import json
+import math
+import os
+import random
+import sys
+import time
+from main import LambertSolver, parabolic_transfer_time
+from batch import solve_batch
+from kernel import BUCKET_NAMES, DEGENERATE, classify
+from backends import BACKENDS, policy_path
+from sweep import porkchop_sweep
+from ephemeris import CircularOrbit, EphemerisTable
+from numa import NumaPlacement, Replica
+
+MU_EARTH = 398600.4418  # km^3/s^2
+MU_SUN = 1.32712440018e11  # km^3/s^2
+AU = 1.495978707e8  # km
+DAY = 86400.0  # s
+
+def leo_geo_problems(count, seed=0):
+    """Random coplanar LEO -> GEO problems with mixed transfer angles and times."""
+    rng = random.Random(seed)
+    problems = []
+    for _ in range(count):
+        r_leo = 6371 + rng.uniform(300, 1200)
+        angle = rng.uniform(0.3, 5.9)
+        r1 = [r_leo, 0.0, 0.0]
+        r2 = [42164.0 * math.cos(angle), 42164.0 * math.sin(angle), 0.0]
+        problems.append((r1, r2, rng.uniform(2, 12) * 3600))
+    return problems
+
+def bucket_problems(per_bucket, seed=0):
+    """
+    Random planar Earth-orbit problems, per_bucket of each non-degenerate
+    regime bucket: radii from LEO to beyond GEO, any transfer angle (some
+    within a milliradian of 180 degrees) and times of flight from a third
+    to fifty times the parabolic time.
+    """
+    rng = random.Random(seed)
+    buckets = {b: [] for b in range(len(BUCKET_NAMES)) if b != DEGENERATE}
+    while any(len(problems) < per_bucket for problems in buckets.values()):
+        angle = math.pi + rng.uniform(-1e-3, 1e-3) if rng.random() < 0.1 else rng.uniform(0.1, 2 * math.pi - 0.1)
+        r1 = [rng.uniform(6700, 50000), 0.0, 0.0]
+        radius = rng.uniform(6700, 50000)
+        r2 = [radius * math.cos(angle), radius * math.sin(angle), 0.0]
+        dt = parabolic_transfer_time(r1, r2, MU_EARTH) * math.exp(rng.uniform(math.log(0.3), math.log(50)))
+        bucket, _ = classify(MU_EARTH, r1, r2, dt)
+        if bucket in buckets and len(buckets[bucket]) < per_bucket:
+            buckets[bucket].append((r1, r2, dt))
+    return buckets
+
+def backend_policy(per_bucket=200, path=None):
+    """
+    Time each backend on each bucket through solve_batch and write the
+    fastest one with the fewest failures per bucket to path (None for
+    backends.policy_path()).
+
+    :return: Policy dictionary bucket name -> backend name
+    """
+    solver = LambertSolver(MU_EARTH)
+    policy = {}
+    for bucket, problems in bucket_problems(per_bucket).items():
+        timings = []
+        for backend in BACKENDS:
+            result, seconds = _timed(lambda: solve_batch(solver, problems, backend=backend))
+            timings.append((result.failures(), seconds, backend))
+            print(f"  {BUCKET_NAMES[bucket]:14} {backend:10} {seconds / len(problems) * 1e6:8.1f} us/solve, "
+                  f"{result.failures()} failures")
+        policy[BUCKET_NAMES[bucket]] = min(timings)[2]
+    policy[BUCKET_NAMES[DEGENERATE]] = 'universal'
+    if path is None:
+        path = policy_path()
+    os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+    with open(path, 'w') as f:
+        json.dump(policy, f, indent=2, sort_keys=True)
+    print(f"Wrote {path}: {policy}")
+    return policy
+
+def _timed(function):
+    start = time.perf_counter()
+    value = function()
+    return value, time.perf_counter() - start
+
+def run(workers=2, problems=2000, grid=40):
+    batch = leo_geo_problems(problems)
+    earth_solver = LambertSolver(MU_EARTH)
+    sun_solver = LambertSolver(MU_SUN)
+
+    earth = CircularOrbit(1.0 * AU, MU_SUN)
+    mars = CircularOrbit(1.524 * AU, MU_SUN, phase=0.8, inclination=0.032)
+    departure_times = [k * 10 * DAY for k in range(grid)]
+    tofs = [120 * DAY + k * 8 * DAY for k in range(grid)]
+    t_stop = departure_times[-1] + tofs[-1]
+    tables = {'earth': EphemerisTable(earth, 0.0, t_stop, 2 * DAY),
+              'mars': EphemerisTable(mars, 0.0, t_stop, 2 * DAY)}
+    with NumaPlacement(replicas=tables) as placement:
+        print(f"solve_batch: {problems} problems")
+        result, seconds = _timed(lambda: solve_batch(earth_solver, batch, workers=workers))
+        print(f"  {str(workers) + ' workers:':16} {seconds:8.3f} s  ({problems / seconds:9.0f} solves/s, "
+              f"{result.failures()} failures)")
+        result, seconds = _timed(lambda: solve_batch(earth_solver, batch, placement=placement))
+        print(f"  {'NUMA placement:':16} {seconds:8.3f} s  ({problems / seconds:9.0f} solves/s, "
+              f"{result.failures()} failures)")
+        print(placement.report())
+
+        cells = grid * grid
+        print(f"porkchop_sweep: {grid} x {grid} grid")
+        result, seconds = _timed(lambda: porkchop_sweep(sun_solver, tables['earth'], tables['mars'],
+                                                        departure_times, tofs, workers=workers))
+        print(f"  {str(workers) + ' workers:':16} {seconds:8.3f} s  ({cells / seconds:9.0f} cells/s, "
+              f"best {result.best})")
+        result, seconds = _timed(lambda: porkchop_sweep(sun_solver, Replica('earth'), Replica('mars'),
+                                                        departure_times, tofs, placement=placement))
+        print(f"  {'NUMA placement:':16} {seconds:8.3f} s  ({cells / seconds:9.0f} cells/s, "
+              f"best {result.best})")
+        print(placement.report())
+
+if __name__ == "__main__":
+    if sys.argv[1:2] == ['policy']:
+        backend_policy(*[int(a) for a in sys.argv[2:3]], *sys.argv[3:4])
+    else:
+        run(*[int(a) for a in sys.argv[1:4]])
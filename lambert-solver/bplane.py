@@ -0,0 +1,204 @@
+"""
+B-plane parameters and B-plane targeting for flybys and arrivals.
+
+bplane turns a planet-relative hyperbolic state into B . T, B . R and the
+linearized time of flight (LTOF). S is the incoming asymptote direction,
+T = S x pole / |S x pole| and R = S x T. B = S x h / v_inf points from the
+planet to where the incoming asymptote crosses the B-plane.
+
+target_bplane is the patched-conic corrector. The heliocentric Lambert leg
+from r1 ends at the hand-off point r_planet + x, where x lies on a sphere of
+the given radius around the planet (e.g. the sphere of influence). The
+planet-relative state there, (x, v2 - v_planet), defines the approach
+hyperbola. Newton on x drives (B . T, B . R, |x|) to the aim point and the
+radius. The Jacobian comes from the analytic Lambert partials
+(sensitivity.lambert_partials) pushed through bplane on dual numbers, so each
+iteration costs three partial solves. The result gives the departure
+velocity v1 that hits the aim point.
+"""
+import math
+from batch import DEFAULT_CHUNK_SIZE, make_chunks, imap_chunks
+from sensitivity import cross, dot, lambert_partials, lift_vector, norm, sqrt, value
+
+class BPlane:
+    """
+    B-plane parameters: b_t = B . T and b_r = B . R (km), ltof (s), v_inf
+    (km/s), and the unit vectors s, t and r.
+    """
+    def __init__(self, b_t, b_r, ltof, v_inf, s, t, r):
+        self.b_t = b_t
+        self.b_r = b_r
+        self.ltof = ltof
+        self.v_inf = v_inf
+        self.s = s
+        self.t = t
+        self.r = r
+
+    @property
+    def b(self):
+        return math.hypot(self.b_t, self.b_r)
+
+def _bplane_vectors(mu, r, v, pole):
+    # S, T, R, B and v_inf for float or Dual components
+    h = cross(r, v)
+    r_norm = norm(r)
+    v_sq = dot(v, v)
+    rv = dot(r, v)
+    e_vec = [((v_sq - mu / r_norm) * r[k] - rv * v[k]) / mu for k in range(3)]
+    e_sq = dot(e_vec, e_vec)
+    if value(e_sq) <= 1:
+        raise ValueError("State is not hyperbolic relative to the body; the B-plane is undefined.")
+    v_inf = sqrt(v_sq - 2 * mu / r_norm)
+    # Incoming asymptote: e_vec / e^2 + sqrt(e^2 - 1) / e^2 * (h x e_vec) / |h|
+    he = cross(h, e_vec)
+    k_he = sqrt(e_sq - 1) / (e_sq * norm(h))
+    s = [e_vec[k] / e_sq + k_he * he[k] for k in range(3)]
+    t = cross(s, pole)
+    t_norm = norm(t)
+    if value(t_norm) < 1e-12:
+        raise ValueError("Asymptote is along the reference pole; T is undefined.")
+    t = [x / t_norm for x in t]
+    r_axis = cross(s, t)
+    b = [x / v_inf for x in cross(s, h)]
+    return s, t, r_axis, b, v_inf
+
+def bplane(mu, r, v, pole=(0.0, 0.0, 1.0)):
+    """
+    B-plane parameters of a hyperbolic approach.
+
+    :param mu: Gravitational parameter of the flyby or arrival body (km^3/s^2)
+    :param r: Position relative to the body (km)
+    :param v: Velocity relative to the body (km/s), e.g. the Lambert arrival v_inf
+              plus the geometry at the hand-off point
+    :param pole: Reference pole for T (default +z of the working frame)
+    :return: BPlane; ltof is the time to reach the B-plane moving along S at
+             v_inf from the current position
+    """
+    s, t, r_axis, b, v_inf = _bplane_vectors(mu, r, v, pole)
+    return BPlane(dot(b, t), dot(b, r_axis), -dot(r, s) / v_inf, v_inf, s, t, r_axis)
+
+def _residual(mu, mu_body, r1, dt, planet, x, aim, radius, pole, clockwise, z, direction):
+    # (B . T - aim, B . R - aim, |x| - radius) with derivatives along direction
+    rp, vp = planet
+    r2 = [rp[k] + x[k] for k in range(3)]
+    v1, v2, _, dv2, z = lambert_partials(mu, r1, r2, dt, clockwise, dr2=direction, z=z)
+    X = lift_vector(x, direction)
+    V = lift_vector([v2[k] - vp[k] for k in range(3)], dv2)
+    _, t, r_axis, b, _ = _bplane_vectors(mu_body, X, V, pole)
+    return [dot(b, t) - aim[0], dot(b, r_axis) - aim[1], norm(X) - radius], v1, v2, z
+
+def _solve3(J, f):
+    # Cramer's rule for the 3 x 3 Newton step J dx = f
+    def det(m):
+        return (m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+                - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+                + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]))
+    d = det(J)
+    if d == 0:
+        raise ValueError("Singular B-plane Jacobian")
+    out = []
+    for c in range(3):
+        m = [[f[i] if j == c else J[i][j] for j in range(3)] for i in range(3)]
+        out.append(det(m) / d)
+    return out
+
+class BPlaneTarget:
+    """
+    Converged B-plane transfer: departure and arrival heliocentric velocities,
+    the hand-off offset x from the planet, the achieved BPlane, Newton
+    iterations and the final z.
+    """
+    def __init__(self, v1, v2, x, bplane, iterations, z):
+        self.v1 = v1
+        self.v2 = v2
+        self.x = x
+        self.bplane = bplane
+        self.iterations = iterations
+        self.z = z
+
+def _target(mu, mu_body, r1, dt, planet, aim, radius, pole, clockwise, x, z, tolerance, max_iterations):
+    rp, vp = planet
+    if x is None:
+        # Straight-line guess: Lambert to the planet centre for S, then start
+        # on the sphere where the aimed asymptote enters it
+        _, v2, _, _, z = lambert_partials(mu, r1, rp, dt, clockwise)
+        v_rel = [v2[k] - vp[k] for k in range(3)]
+        v_norm = math.sqrt(dot(v_rel, v_rel))
+        s = [c / v_norm for c in v_rel]
+        t = cross(s, pole)
+        t_norm = math.sqrt(dot(t, t))
+        t = [c / t_norm for c in t]
+        r_axis = cross(s, t)
+        along = math.sqrt(max(radius**2 - aim[0]**2 - aim[1]**2, 0.0))
+        x = [aim[0] * t[k] + aim[1] * r_axis[k] - along * s[k] for k in range(3)]
+    scale = max(radius, 1.0)
+    for iteration in range(1, max_iterations + 1):
+        columns = []
+        for axis in range(3):
+            direction = [1.0 if k == axis else 0.0 for k in range(3)]
+            residual, v1, v2, z_next = _residual(mu, mu_body, r1, dt, planet, x, aim, radius, pole,
+                                                 clockwise, z, direction)
+            columns.append([d.b for d in residual])
+        z = z_next
+        f = [d.a for d in residual]
+        if max(abs(c) for c in f) <= tolerance * scale:
+            v_rel = [v2[k] - vp[k] for k in range(3)]
+            return BPlaneTarget(v1, v2, x, bplane(mu_body, x, v_rel, pole), iteration, z)
+        J = [[columns[j][i] for j in range(3)] for i in range(3)]
+        step = _solve3(J, f)
+        x = [x[k] - step[k] for k in range(3)]
+    raise ValueError(f"B-plane targeting did not converge after {max_iterations} iterations")
+
+def target_bplane(solver, r1, dt, planet_state, mu_body, aim, radius, pole=(0.0, 0.0, 1.0), clockwise=False,
+                  x=None, tolerance=1e-10, max_iterations=20):
+    """
+    Departure velocity whose heliocentric leg reaches the planet's hand-off
+    sphere on an approach hyperbola with the given B-plane aim point.
+
+    :param solver: LambertSolver for the central body
+    :param r1: Departure position (km)
+    :param dt: Time of flight to the hand-off point (s)
+    :param planet_state: (r, v) of the planet at arrival
+    :param mu_body: Gravitational parameter of the planet (km^3/s^2)
+    :param aim: Target (B . T, B . R) (km)
+    :param radius: Hand-off sphere radius (km), e.g. the sphere of influence
+    :param x: Optional starting hand-off offset from the planet (km)
+    :param tolerance: Relative tolerance on B . T, B . R and |x| (fraction of radius)
+    :return: BPlaneTarget
+    :raises ValueError: If the iteration fails or the approach is not hyperbolic
+    """
+    return _target(solver.mu, mu_body, r1, dt, planet_state, aim, radius, pole, clockwise, x, None,
+                   tolerance, max_iterations)
+
+def _bplane_chunk(mu, problems, mu_body, aim, radius, pole, clockwise, tolerance, max_iterations):
+    out = []
+    x = z = None
+    for r1, dt, planet_state in problems:
+        try:
+            target = _target(mu, mu_body, r1, dt, planet_state, aim, radius, pole, clockwise, x, z,
+                             tolerance, max_iterations)
+        except (ValueError, ZeroDivisionError, OverflowError):
+            x = z = None
+            out.append(None)
+            continue
+        x, z = target.x, target.z
+        out.append(target)
+    return out
+
+def target_bplane_batch(solver, problems, mu_body, aim, radius, pole=(0.0, 0.0, 1.0), clockwise=False,
+                        workers=1, chunk_size=DEFAULT_CHUNK_SIZE, tolerance=1e-10, max_iterations=20,
+                        placement=None):
+    """
+    target_bplane over many (r1, dt, planet_state) problems, e.g. one per
+    arrival epoch. Within a chunk each problem starts from the previous
+    hand-off offset; chunk boundaries depend only on chunk_size.
+
+    :return: List of BPlaneTarget, None where targeting failed
+    """
+    chunks = make_chunks(len(problems), chunk_size)
+    args = ((solver.mu, problems[start:stop], mu_body, aim, radius, pole, clockwise, tolerance, max_iterations)
+            for start, stop in chunks)
+    out = []
+    for chunk_out in imap_chunks(_bplane_chunk, args, workers, placement):
+        out.extend(chunk_out)
+    return out
@@ -0,0 +1,207 @@
+"""
+Iso-contours straight from a porkchop sweep.
+
+The departure-time × time-of-flight grid is processed in square tiles. Each
+tile solves its own nodes (sharing one row/column of nodes with its
+neighbours), runs marching squares and keeps only the contour segments; the
+node values are dropped as soon as the tile is done. Segment end points are
+identified by the grid edge they lie on, so segments from neighbouring tiles
+join exactly when the polylines are stitched at the end.
+"""
+from main import LambertSolver
+from kernel import METRIC_FIELDS
+from batch import _solve_chunk, imap_chunks
+from sweep import _collinear_plane
+
+def transfer_metrics(solver, departure_body, arrival_body, t0, tof, clockwise=False, max_iterations=1000,
+                     tolerance=1e-8):
+    """
+    :param max_iterations: Newton iterations, as for LambertSolver.solve
+    :param tolerance: Newton convergence tolerance, as for LambertSolver.solve
+    :return: Dictionary with dv (total Δv), dv1, dv2, c3 (departure v∞²) and
+             vinf2 (arrival v∞), or None if the solve fails
+    """
+    return _transfer_metrics_batch(solver.mu, departure_body, arrival_body, [(t0, tof)], clockwise,
+                                   max_iterations, tolerance)[0]
+
+def _transfer_metrics_batch(mu, departure_body, arrival_body, nodes, clockwise, max_iterations, tolerance):
+    states = []
+    for t0, tof in nodes:
+        r1, vb1 = departure_body.state(t0)
+        r2, vb2 = arrival_body.state(t0 + tof)
+        states.append((r1, vb1, r2, vb2, tof))
+    # Collinear nodes are solved in the departure body's orbit plane, as in the sweep.
+    problems = [(r1, r2, tof, clockwise, _collinear_plane(r1, vb1, r2)) for r1, vb1, r2, _, tof in states]
+    velocities = [(vb1, vb2) for _, vb1, _, vb2, _ in states]
+    out = []
+    for _, _, error, metrics in _solve_chunk(mu, problems, max_iterations, tolerance, velocities=velocities,
+                                             metrics=True):
+        out.append(None if error is not None else _metrics(dict(zip(METRIC_FIELDS, metrics))))
+    return out
+
+def _metrics(fused):
+    return {'dv': fused['dv'], 'dv1': fused['vinf1'], 'dv2': fused['vinf2'], 'c3': fused['c3'],
+            'vinf2': fused['vinf2']}
+
+def _value(solver, departure_body, arrival_body, t0, tof, clockwise, quantity, max_iterations, tolerance):
+    metrics = transfer_metrics(solver, departure_body, arrival_body, t0, tof, clockwise, max_iterations, tolerance)
+    return None if metrics is None else metrics[quantity]
+
+# Marching-squares cases: corner bits are (i, j)=1, (i, j+1)=2, (i+1, j+1)=4,
+# (i+1, j)=8 with a bit set when the node is above the level. Edges are
+# 0 = top (i, j)-(i, j+1), 1 = right, 2 = bottom, 3 = left.
+_CASES = {
+    1: [(3, 0)], 2: [(0, 1)], 3: [(3, 1)], 4: [(1, 2)], 6: [(0, 2)], 7: [(3, 2)],
+    8: [(2, 3)], 9: [(2, 0)], 11: [(2, 1)], 12: [(1, 3)], 13: [(1, 0)], 14: [(0, 3)],
+}
+
+def _edge_key(i, j, edge):
+    if edge == 0:
+        return ('h', i, j)
+    if edge == 1:
+        return ('v', i, j + 1)
+    if edge == 2:
+        return ('h', i + 1, j)
+    return ('v', i, j)
+
+def _crossing(solver, departure_body, arrival_body, departure_times, tofs, key, level,
+              values, clockwise, quantity, refine, max_iterations, tolerance):
+    """Point where the level crosses grid edge key, optionally refined by extra solves."""
+    kind, i, j = key
+    i2, j2 = (i, j + 1) if kind == 'h' else (i + 1, j)
+    a = (departure_times[i], tofs[j])
+    b = (departure_times[i2], tofs[j2])
+    fa = values[(i, j)] - level
+    fb = values[(i2, j2)] - level
+    s = fa / (fa - fb)
+    # Regula falsi along the edge (Illinois variant: an end point kept twice
+    # in a row has its value halved, so one-sided convergence cannot stall).
+    # Every step is one extra solve.
+    lo, hi = 0.0, 1.0
+    side = 0
+    for _ in range(refine):
+        t0 = a[0] + s * (b[0] - a[0])
+        tof = a[1] + s * (b[1] - a[1])
+        fs = _value(solver, departure_body, arrival_body, t0, tof, clockwise, quantity, max_iterations, tolerance)
+        if fs is None:
+            break
+        fs -= level
+        if fs == 0:
+            break
+        if (fs < 0) == (fa < 0):
+            lo, fa = s, fs
+            if side == -1:
+                fb /= 2
+            side = -1
+        else:
+            hi, fb = s, fs
+            if side == 1:
+                fa /= 2
+            side = 1
+        s = lo + (hi - lo) * fa / (fa - fb)
+    return (a[0] + s * (b[0] - a[0]), a[1] + s * (b[1] - a[1]))
+
+def _contour_tile(mu, departure_body, arrival_body, departure_times, tofs, i0, i1, j0, j1,
+                  levels, clockwise, quantity, refine, max_iterations, tolerance):
+    solver = LambertSolver(mu)
+    keys = [(i, j) for i in range(i0, i1 + 1) for j in range(j0, j1 + 1)]
+    nodes = [(departure_times[i], tofs[j]) for i, j in keys]
+    values = {}
+    for key, metrics in zip(keys, _transfer_metrics_batch(mu, departure_body, arrival_body, nodes, clockwise,
+                                                                max_iterations, tolerance)):
+        values[key] = None if metrics is None else metrics[quantity]
+    segments = {level: [] for level in levels}
+    points = {}
+    for i in range(i0, i1):
+        for j in range(j0, j1):
+            corners = [values[(i, j)], values[(i, j + 1)], values[(i + 1, j + 1)], values[(i + 1, j)]]
+            if any(c is None for c in corners):
+                continue
+            for level in levels:
+                case = sum(1 << k for k, c in enumerate(corners) if c > level)
+                if case == 5 or case == 10:
+                    # Saddle: resolve with the cell-centre average.
+                    centre = sum(corners) / 4 > level
+                    if (case == 5) == centre:
+                        pairs = [(0, 1), (2, 3)]
+                    else:
+                        pairs = [(3, 0), (1, 2)]
+                else:
+                    pairs = _CASES.get(case, [])
+                for e1, e2 in pairs:
+                    k1 = _edge_key(i, j, e1)
+                    k2 = _edge_key(i, j, e2)
+                    for key in (k1, k2):
+                        if (level, key) not in points:
+                            points[(level, key)] = _crossing(
+                                solver, departure_body, arrival_body, departure_times, tofs,
+                                key, level, values, clockwise, quantity, refine, max_iterations, tolerance)
+                    segments[level].append((k1, k2))
+    return segments, points
+
+def _stitch(segments, points, level):
+    """Join segments sharing an edge key into polylines of (t0, tof) points."""
+    ends = {}
+    for n, (k1, k2) in enumerate(segments):
+        ends.setdefault(k1, []).append(n)
+        ends.setdefault(k2, []).append(n)
+    used = [False] * len(segments)
+    lines = []
+    for n in range(len(segments)):
+        if used[n]:
+            continue
+        used[n] = True
+        keys = list(segments[n])
+        # Grow forwards from the last key, then backwards from the first.
+        for forward in (True, False):
+            while True:
+                tip = keys[-1] if forward else keys[0]
+                nxt = next((m for m in ends[tip] if not used[m]), None)
+                if nxt is None:
+                    break
+                used[nxt] = True
+                k1, k2 = segments[nxt]
+                other = k2 if k1 == tip else k1
+                if forward:
+                    keys.append(other)
+                else:
+                    keys.insert(0, other)
+        lines.append([points[(level, key)] for key in keys])
+    return lines
+
+def porkchop_contours(solver, departure_body, arrival_body, departure_times, tofs, levels,
+                      quantity='dv', clockwise=False, tile_size=32, refine=0, workers=1,
+                      on_tile=None, placement=None, max_iterations=1000, tolerance=1e-8):
+    """
+    Iso-contours of a transfer quantity over a porkchop grid.
+
+    :param levels: Contour levels
+    :param quantity: 'dv', 'dv1', 'dv2', 'c3' or 'vinf2' (see transfer_metrics)
+    :param tile_size: Grid cells per tile side
+    :param refine: Extra solves per contour crossing to move it off the linear interpolant
+    :param workers: Number of worker processes (tiles are independent)
+    :param on_tile: Optional callback(tile_index, segments) called, in tile order, as soon as
+                    each tile is done
+    :param placement: Optional numa.NumaPlacement for the worker processes
+    :param max_iterations: Newton iterations per solve, as for LambertSolver.solve
+    :param tolerance: Newton convergence tolerance, as for LambertSolver.solve
+    :return: Dictionary level -> list of polylines; a polyline is a list of
+             (departure time, time of flight) points and is closed when its
+             first and last points are equal
+    """
+    tiles = []
+    for i0 in range(0, len(departure_times) - 1, tile_size):
+        for j0 in range(0, len(tofs) - 1, tile_size):
+            i1 = min(i0 + tile_size, len(departure_times) - 1)
+            j1 = min(j0 + tile_size, len(tofs) - 1)
+            tiles.append((solver.mu, departure_body, arrival_body, departure_times, tofs,
+                          i0, i1, j0, j1, levels, clockwise, quantity, refine, max_iterations, tolerance))
+    all_segments = {level: [] for level in levels}
+    all_points = {}
+    for index, (segments, points) in enumerate(imap_chunks(_contour_tile, tiles, workers, placement)):
+        if on_tile is not None:
+            on_tile(index, segments)
+        for level in levels:
+            all_segments[level].extend(segments[level])
+        all_points.update(points)
+    return {level: _stitch(all_segments[level], all_points, level) for level in levels}
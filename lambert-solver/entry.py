@@ -0,0 +1,176 @@
+"""
+Lambert targeting of an atmospheric entry interface.
+
+Return trajectories aim at a flight-path angle on the entry sphere rather
+than at a fixed point. The arrival point r2 = R (cos a p + sin a q) moves
+around the entry sphere in the plane with normal plane_normal. Its angle a
+is iterated by Newton until the arrival flight-path angle
+asin(r2 . v2 / (|r2| |v2|)) matches the target. The derivative with respect
+to a comes from the dual-number Lambert partials in sensitivity.py, so every
+Newton step costs one solve.
+
+Without a starting angle, the circle is scanned for the first sign change
+(in increasing a) and the root is polished inside that bracket.
+target_entry_batch sweeps many departure states, e.g. return epochs. Each
+chunk warm-starts from the previous problem's angle and z, and rescans only
+when that fails.
+"""
+import math
+from batch import DEFAULT_CHUNK_SIZE, make_chunks, imap_chunks
+from sensitivity import Dual, asin, cross, dot, lambert_partials, lift_vector, norm
+
+TWO_PI = 2 * math.pi
+
+class EntryTarget:
+    """
+    Converged entry transfer: arrival point r2 on the entry sphere, v1, v2,
+    the arrival angle in the targeting plane (rad, counterclockwise about the
+    plane normal from the projection of r1), the flight-path angle reached
+    (rad), Newton iterations and the final z.
+    """
+    def __init__(self, r2, v1, v2, angle, flight_path_angle, iterations, z):
+        self.r2 = r2
+        self.v1 = v1
+        self.v2 = v2
+        self.angle = angle
+        self.flight_path_angle = flight_path_angle
+        self.iterations = iterations
+        self.z = z
+
+def flight_path_angle(r, v):
+    """Flight-path angle asin(r . v / (|r| |v|)) in radians; negative when descending."""
+    return asin(dot(r, v) / (norm(r) * norm(v)))
+
+def _plane_basis(r1, plane_normal):
+    n_norm = math.sqrt(dot(plane_normal, plane_normal))
+    n = [x / n_norm for x in plane_normal]
+    q = cross(n, r1)
+    q_norm = math.sqrt(dot(q, q))
+    if q_norm <= 1e-12 * math.sqrt(dot(r1, r1)):
+        raise ValueError("Departure position is along the plane normal; the targeting plane is undefined.")
+    q = [x / q_norm for x in q]
+    return cross(q, n), q, n
+
+def _evaluate(mu, r1, dt, radius, basis, clockwise, angle, z):
+    # Transfer to the entry point at angle, and the flight-path angle as a
+    # Dual whose derivative is d(gamma)/d(angle)
+    p, q, n = basis
+    c, s = math.cos(angle), math.sin(angle)
+    r2 = [radius * (c * p[k] + s * q[k]) for k in range(3)]
+    dr2 = [radius * (-s * p[k] + c * q[k]) for k in range(3)]
+    v1, v2, _, dv2, z = lambert_partials(mu, r1, r2, dt, clockwise, dr2=dr2, z=z, normal=n)
+    gamma = flight_path_angle(lift_vector(r2, dr2), lift_vector(v2, dv2))
+    return r2, v1, v2, gamma, z
+
+def _newton(mu, r1, dt, radius, gamma_target, basis, clockwise, angle, z, bracket, tolerance, max_iterations):
+    # Newton on the angle; with a bracket (lo, hi, residual at lo), steps that
+    # leave it are replaced by bisection and the bracket shrinks every step.
+    for iteration in range(1, max_iterations + 1):
+        try:
+            r2, v1, v2, gamma, z = _evaluate(mu, r1, dt, radius, basis, clockwise, angle, z)
+        except (ValueError, ZeroDivisionError, OverflowError):
+            if bracket is None:
+                raise
+            # A midpoint can land exactly opposite r1, where the transfer plane
+            # is undefined; step off it inside the bracket
+            angle += 1e-6 * (bracket[1] - angle)
+            continue
+        residual = gamma.a - gamma_target
+        if abs(residual) <= tolerance:
+            return EntryTarget(r2, v1, v2, angle % TWO_PI, gamma.a, iteration, z)
+        if bracket is not None:
+            lo, hi, residual_lo = bracket
+            if (residual < 0) == (residual_lo < 0):
+                bracket = angle, hi, residual
+            else:
+                bracket = lo, angle, residual_lo
+        step = residual / gamma.b if gamma.b != 0 else float('inf')
+        angle_next = angle - step
+        if bracket is not None and not bracket[0] < angle_next < bracket[1]:
+            angle_next = (bracket[0] + bracket[1]) / 2
+        elif bracket is None and not 0 < angle_next < TWO_PI:
+            break
+        angle = angle_next
+    raise ValueError(f"Entry targeting did not converge after {max_iterations} iterations")
+
+def _target(mu, r1, dt, radius, gamma_target, basis, clockwise, angle, z, tolerance, max_iterations, scan):
+    if angle is not None:
+        try:
+            return _newton(mu, r1, dt, radius, gamma_target, basis, clockwise, angle, z, None,
+                           tolerance, max_iterations)
+        except (ValueError, ZeroDivisionError, OverflowError):
+            pass
+    # Sample the circle away from 0 and 180 degrees and take the first sign change
+    previous = None
+    for k in range(scan):
+        a = (k + 0.5) * TWO_PI / scan
+        try:
+            _, _, _, gamma, z_a = _evaluate(mu, r1, dt, radius, basis, clockwise, a, None)
+        except (ValueError, ZeroDivisionError, OverflowError):
+            previous = None
+            continue
+        residual = gamma.a - gamma_target
+        if previous is not None and (residual < 0) != (previous[1] < 0):
+            lo, residual_lo, z_lo = previous
+            return _newton(mu, r1, dt, radius, gamma_target, basis, clockwise, (lo + a) / 2, z_lo,
+                           (lo, a, residual_lo), tolerance, max_iterations)
+        previous = a, residual, z_a
+    raise ValueError("No point on the entry sphere reaches the target flight-path angle.")
+
+def target_entry(solver, r1, dt, entry_radius, flight_path_angle, plane_normal=(0.0, 0.0, 1.0),
+                 clockwise=False, angle=None, tolerance=1e-10, max_iterations=50, scan=36):
+    """
+    Lambert transfer from r1 to the entry sphere that arrives with the given
+    flight-path angle.
+
+    :param solver: LambertSolver (supplies mu)
+    :param r1: Departure position (km)
+    :param dt: Time of flight (s)
+    :param entry_radius: Entry interface radius (km), e.g. Earth radius + 122 km
+    :param flight_path_angle: Target arrival flight-path angle (rad, negative for entry)
+    :param plane_normal: Normal of the plane the arrival point moves in; the
+                         transfer runs counterclockwise about it (clockwise if set)
+    :param angle: Optional starting arrival angle (rad); the circle is scanned if
+                  None or if Newton fails from it
+    :param tolerance: Flight-path angle tolerance (rad)
+    :param scan: Number of samples in the scan for a bracket
+    :return: EntryTarget
+    :raises ValueError: If no arrival point meets the constraint
+    """
+    basis = _plane_basis(r1, plane_normal)
+    return _target(solver.mu, r1, dt, entry_radius, flight_path_angle, basis, clockwise, angle, None,
+                   tolerance, max_iterations, scan)
+
+def _entry_chunk(mu, problems, entry_radius, gamma_target, plane_normal, clockwise, tolerance,
+                 max_iterations, scan):
+    out = []
+    angle = z = None
+    for r1, dt in problems:
+        try:
+            target = _target(mu, r1, dt, entry_radius, gamma_target, _plane_basis(r1, plane_normal),
+                             clockwise, angle, z, tolerance, max_iterations, scan)
+        except (ValueError, ZeroDivisionError, OverflowError):
+            out.append(None)
+            continue
+        angle, z = target.angle, target.z
+        out.append(target)
+    return out
+
+def target_entry_batch(solver, problems, entry_radius, flight_path_angle, plane_normal=(0.0, 0.0, 1.0),
+                       clockwise=False, workers=1, chunk_size=DEFAULT_CHUNK_SIZE, tolerance=1e-10,
+                       max_iterations=50, scan=36, placement=None):
+    """
+    target_entry over many (r1, dt) problems, e.g. one per return epoch.
+    Problems are chunked as in batch.solve_batch; within a chunk each
+    problem starts from the previous solution. Chunk boundaries depend only
+    on chunk_size, so results do not depend on the number of workers.
+
+    :return: List of EntryTarget, None where targeting failed
+    """
+    chunks = make_chunks(len(problems), chunk_size)
+    args = ((solver.mu, problems[start:stop], entry_radius, flight_path_angle, plane_normal, clockwise,
+             tolerance, max_iterations, scan) for start, stop in chunks)
+    out = []
+    for chunk_out in imap_chunks(_entry_chunk, args, workers, placement):
+        out.extend(chunk_out)
+    return out
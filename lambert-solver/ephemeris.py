@@ -0,0 +1,105 @@
+import math
+from array import array
+
+class CircularOrbit:
+    """
+    Simple ephemeris for a body on a circular orbit around the central body.
+
+    :param radius: Orbit radius (km)
+    :param mu: Gravitational parameter of the central body (km^3/s^2)
+    :param phase: True longitude at t = 0 (rad)
+    :param inclination: Inclination of the orbit plane about the x-axis (rad)
+    """
+    def __init__(self, radius, mu, phase=0.0, inclination=0.0):
+        self.radius = radius
+        self.mu = mu
+        self.phase = phase
+        self.inclination = inclination
+        self.mean_motion = math.sqrt(mu / radius**3)
+        self.speed = math.sqrt(mu / radius)
+
+    def state(self, t):
+        """
+        Position and velocity of the body at time t.
+
+        :param t: Time since epoch (s)
+        :return: (r, v) Position (km) and velocity (km/s) vectors
+        """
+        theta = self.phase + self.mean_motion * t
+        ci = math.cos(self.inclination)
+        si = math.sin(self.inclination)
+        x = self.radius * math.cos(theta)
+        y = self.radius * math.sin(theta)
+        vx = -self.speed * math.sin(theta)
+        vy = self.speed * math.cos(theta)
+        return [x, y * ci, y * si], [vx, vy * ci, vy * si]
+
+    def period(self):
+        return 2 * math.pi / self.mean_motion
+
+def synodic_period(body_a, body_b):
+    """Synodic period of two circular-orbit bodies (s)."""
+    dn = abs(body_a.mean_motion - body_b.mean_motion)
+    if dn == 0:
+        return float('inf')
+    return 2 * math.pi / dn
+
+class EphemerisTable:
+    """
+    Read-only table of body states sampled at a fixed step, with cubic Hermite
+    interpolation between samples. Lookups never call back into the source
+    ephemeris, so a table can be copied to every worker (see numa.py).
+
+    :param body: Object with state(t) -> (r, v)
+    :param t_start: First sample time (s)
+    :param t_stop: Last time the table must cover (s)
+    :param step: Sample spacing (s)
+    """
+    def __init__(self, body, t_start, t_stop, step):
+        if step <= 0 or t_stop < t_start:
+            raise ValueError("EphemerisTable needs step > 0 and t_stop >= t_start")
+        self.t_start = t_start
+        self.step = step
+        self.count = int(math.ceil((t_stop - t_start) / step)) + 1
+        self.r = array('d')
+        self.v = array('d')
+        for k in range(self.count):
+            r, v = body.state(t_start + k * step)
+            self.r.extend(r)
+            self.v.extend(v)
+
+    def state(self, t):
+        """
+        Interpolated position and velocity at time t.
+
+        :param t: Time since epoch (s), inside the table span
+        :return: (r, v) Position (km) and velocity (km/s) vectors
+        """
+        x = (t - self.t_start) / self.step
+        k = int(math.floor(x))
+        if k < 0 or k >= self.count - 1:
+            if k == self.count - 1 and x == k:
+                k -= 1
+            else:
+                raise ValueError(f"Time {t} is outside the ephemeris table")
+        s = x - k
+        h = self.step
+        # Cubic Hermite basis functions and their derivatives
+        h00 = 2 * s**3 - 3 * s**2 + 1
+        h10 = s**3 - 2 * s**2 + s
+        h01 = -2 * s**3 + 3 * s**2
+        h11 = s**3 - s**2
+        d00 = (6 * s**2 - 6 * s) / h
+        d10 = 3 * s**2 - 4 * s + 1
+        d01 = (-6 * s**2 + 6 * s) / h
+        d11 = 3 * s**2 - 2 * s
+        r = []
+        v = []
+        for i in range(3):
+            p0 = self.r[3 * k + i]
+            p1 = self.r[3 * k + 3 + i]
+            m0 = self.v[3 * k + i]
+            m1 = self.v[3 * k + 3 + i]
+            r.append(h00 * p0 + h10 * h * m0 + h01 * p1 + h11 * h * m1)
+            v.append(d00 * p0 + d10 * m0 + d01 * p1 + d11 * m1)
+        return r, v
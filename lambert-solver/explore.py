@@ -0,0 +1,314 @@
+"""
+Beam search and Monte Carlo tree search over MGA decisions.
+
+Exhaustive enumeration (mga.search) grows as (bodies x times of flight) to
+the number of legs. These explorers instead build a tree of decisions
+(next body, time of flight) from launch epochs. Both expand nodes in
+batches: every child leg of the nodes being expanded goes through one call
+of the leg solver (an mga.LegCache by default, so legs repeated anywhere in
+the tree are solved once; launch epochs and times of flight are snapped to
+its quantum), and the flyby junctions go through
+flyby.flyby_batch per flyby body. Tree nodes live in the calling thread's
+arena.NodeArena, which every search resets when it starts.
+
+- beam_search keeps the beam_width cheapest open nodes per depth. After each
+  depth the beam, the best complete path and their ancestors are copied into
+  a second arena and the first is reset, so memory stays proportional to the
+  beam instead of to everything expanded.
+- mcts runs UCT. Each round selects `parallel` leaves, adding a virtual loss
+  along each selected path so that the next selection in the same round
+  diverges. It expands all of them in one batch, then backs up the rewards
+  and removes the virtual losses.
+
+Both stop early at a deadline (time.monotonic() seconds) or when stop()
+returns True, and return the best complete path found so far.
+"""
+import math
+import time
+from arena import thread_nodes
+from mga import LegCache, MgaPath, flyby_costs, snap_times
+
+NODE_FIELDS = ('parent', 'body', 'epoch', 'depth', 'cost', 'dv', 'leg', 'terminal',
+               'visits', 'value', 'virtual', 'children', 'dead')
+
+class MgaProblem:
+    """
+    Decision space of an MGA search.
+
+    :param solver: LambertSolver for the central body
+    :param ephemerides: Body name -> object with state(t) -> (r, v)
+    :param launch: Launch body name
+    :param target: Target body name
+    :param flybys: Candidate flyby body names
+    :param launch_epochs: Launch times (s)
+    :param tof_choices: (p, q) -> list of times of flight (s)
+    :param rp_min: Body name -> minimum flyby periapsis radius (km)
+    :param max_flybys: Largest number of flybys
+    :param rendezvous: Add the arrival v_inf to the cost
+    :param graph: Optional tisserand.TisserandGraph; with vinf_launch, prefixes it rules out are not expanded
+    :param legs: Leg solver with the signature of mga.solve_legs (default a new mga.LegCache)
+    """
+    def __init__(self, solver, ephemerides, launch, target, flybys, launch_epochs, tof_choices, rp_min,
+                 max_flybys=3, rendezvous=False, graph=None, vinf_launch=None, slack=1, legs=None,
+                 workers=1, placement=None):
+        self.solver = solver
+        self.ephemerides = ephemerides
+        self.launch = launch
+        self.target = target
+        self.flybys = [b for b in flybys if b != target]
+        self.legs = legs if legs is not None else LegCache()
+        self.launch_epochs = snap_times(self.legs, launch_epochs)
+        self.tof_choices = {pair: snap_times(self.legs, tofs) for pair, tofs in tof_choices.items()}
+        self.rp_min = rp_min
+        self.max_flybys = max_flybys
+        self.rendezvous = rendezvous
+        self.graph = graph
+        self.vinf_launch = vinf_launch
+        self.slack = slack
+        self.workers = workers
+        self.placement = placement
+
+    def allowed(self, sequence):
+        # Tisserand check of a prefix: it must be flyable and still reach the target
+        if self.graph is None or self.vinf_launch is None:
+            return True
+        if sequence[-1] == self.target:
+            return self.graph.feasible(sequence, self.vinf_launch, slack=self.slack)
+        return (self.graph.feasible(sequence, self.vinf_launch, slack=self.slack)
+                and self.graph.feasible(sequence + (self.target,), self.vinf_launch, slack=self.slack))
+
+class ExploreResult:
+    """Best complete path (mga.MgaPath or None), nodes expanded, legs requested and whether the search was cut short."""
+    def __init__(self, best, expanded, legs, stopped):
+        self.best = best
+        self.expanded = expanded
+        self.legs = legs
+        self.stopped = stopped
+
+def _nodes(arena, index):
+    # Launch node to index; the MCTS root above the launch nodes has depth -1
+    return [i for i in arena.path(index) if arena.get('depth', i) >= 0]
+
+def _sequence(arena, index):
+    return tuple(arena.get('body', i) for i in _nodes(arena, index))
+
+def _roots(problem, arena):
+    return [arena.allocate(parent=None, body=problem.launch, epoch=t0, depth=0, cost=0.0, dv=0.0, leg=None,
+                           terminal=False, visits=0, value=0.0, virtual=0, children=None, dead=False)
+            for t0 in problem.launch_epochs]
+
+def _expand(problem, arena, parents):
+    """
+    Children of every node in parents, with their legs solved in one batch.
+
+    :return: (indices of the new child nodes, number of legs requested)
+    """
+    actions = []
+    for parent in parents:
+        body = arena.get('body', parent)
+        depth = arena.get('depth', parent)
+        sequence = _sequence(arena, parent)
+        choices = [problem.target] if depth >= problem.max_flybys else problem.flybys + [problem.target]
+        for nxt in choices:
+            if not problem.allowed(sequence + (nxt,)):
+                continue
+            for tof in problem.tof_choices[(body, nxt)]:
+                actions.append((parent, nxt, tof))
+    legs = [(arena.get('body', p), nxt, arena.get('epoch', p), tof) for p, nxt, tof in actions]
+    solutions = problem.legs(problem.solver, problem.ephemerides, legs,
+                             workers=problem.workers, placement=problem.placement)
+    # Junction Δv, batched per flyby body
+    dvs = [None] * len(actions)
+    groups = {}
+    for k, ((parent, _, _), leg) in enumerate(zip(actions, solutions)):
+        if leg is None:
+            continue
+        if arena.get('depth', parent) == 0:
+            v = leg[0]
+            dvs[k] = math.sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2])
+        else:
+            groups.setdefault(arena.get('body', parent), []).append(k)
+    for body, ks in groups.items():
+        costs = flyby_costs(body, [arena.get('leg', actions[k][0])[1] for k in ks],
+                            [solutions[k][0] for k in ks], problem.rp_min)
+        for k, dv in zip(ks, costs):
+            dvs[k] = dv
+    children = []
+    per_parent = {p: [] for p in parents}
+    for (parent, nxt, tof), leg, dv in zip(actions, solutions, dvs):
+        if dv is None:
+            continue
+        terminal = nxt == problem.target
+        cost = arena.get('cost', parent) + dv
+        if terminal and problem.rendezvous:
+            v = leg[1]
+            cost += math.sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2])
+        child = arena.allocate(parent=parent, body=nxt, epoch=arena.get('epoch', parent) + tof,
+                               depth=arena.get('depth', parent) + 1, cost=cost, dv=dv, leg=leg,
+                               terminal=terminal, visits=0, value=0.0, virtual=0, children=None, dead=terminal)
+        per_parent[parent].append(child)
+        children.append(child)
+    for parent, kids in per_parent.items():
+        arena.set('children', parent, kids)
+        if not kids:
+            arena.set('dead', parent, True)
+    return children, len(legs)
+
+def _path(arena, index):
+    nodes = _nodes(arena, index)
+    return MgaPath(tuple(arena.get('body', i) for i in nodes),
+                   [arena.get('epoch', i) for i in nodes],
+                   [arena.get('leg', i) for i in nodes[1:]],
+                   [arena.get('dv', i) for i in nodes[2:]],
+                   arena.get('cost', index))
+
+def _compact(source, target, keep):
+    """
+    Copy the nodes in keep and their ancestors from source into target, which
+    is reset first. Nodes keep their order, so cost ties break as before.
+
+    :return: Dictionary old index -> new index
+    """
+    target.reset()
+    moved = {}
+    for index in keep:
+        chain = []
+        while index is not None and index not in moved:
+            chain.append(index)
+            index = source.get('parent', index)
+        for index in reversed(chain):
+            values = {name: source.get(name, index) for name in source.fields}
+            if values['parent'] is not None:
+                values['parent'] = moved[values['parent']]
+            values['children'] = None
+            moved[index] = target.allocate(**values)
+    return moved
+
+def _out_of_time(deadline, stop):
+    return (deadline is not None and time.monotonic() >= deadline) or (stop is not None and stop())
+
+def beam_search(problem, beam_width=64, deadline=None, stop=None):
+    """
+    Breadth-first search keeping the beam_width cheapest open nodes per depth.
+
+    :param deadline: Optional time.monotonic() value after which to stop
+    :param stop: Optional callable; the search stops when it returns True
+    :return: ExploreResult
+    """
+    arena = thread_nodes(NODE_FIELDS, 0)
+    spare = thread_nodes(NODE_FIELDS, 1)
+    arena.reset()
+    beam = _roots(problem, arena)
+    best = None
+    expanded = legs = 0
+    while beam:
+        if _out_of_time(deadline, stop):
+            return ExploreResult(None if best is None else _path(arena, best), expanded, legs, True)
+        children, requested = _expand(problem, arena, beam)
+        expanded += len(beam)
+        legs += requested
+        open_nodes = []
+        for child in children:
+            if arena.get('terminal', child):
+                if best is None or arena.get('cost', child) < arena.get('cost', best):
+                    best = child
+            else:
+                open_nodes.append(child)
+        if best is not None:
+            # A child costing more than the best complete path cannot improve on it
+            open_nodes = [c for c in open_nodes if arena.get('cost', c) < arena.get('cost', best)]
+        open_nodes.sort(key=lambda c: (arena.get('cost', c), c))
+        beam = open_nodes[:beam_width]
+        # Drop this generation: only the beam and the best path live on
+        moved = _compact(arena, spare, beam + ([] if best is None else [best]))
+        arena, spare = spare, arena
+        beam = [moved[c] for c in beam]
+        best = None if best is None else moved[best]
+    return ExploreResult(None if best is None else _path(arena, best), expanded, legs, False)
+
+def _reward(cost, scale):
+    return math.exp(-cost / scale)
+
+def mcts(problem, iterations=200, parallel=8, exploration=0.5, cost_scale=5.0, deadline=None, stop=None):
+    """
+    UCT over the decision tree with batched, virtual-loss parallel expansion.
+
+    :param iterations: Number of rounds
+    :param parallel: Leaves selected and expanded together per round
+    :param exploration: UCT exploration constant
+    :param cost_scale: Rewards are exp(-cost / cost_scale) (cost in km/s)
+    :param deadline: Optional time.monotonic() value after which to stop
+    :param stop: Optional callable; the search stops when it returns True
+    :return: ExploreResult
+    """
+    # The tree is kept whole across rounds; it is dropped when the next search starts
+    arena = thread_nodes(NODE_FIELDS)
+    arena.reset()
+    root = arena.allocate(parent=None, body=None, epoch=None, depth=-1, cost=0.0, dv=0.0, leg=None,
+                          terminal=False, visits=0, value=0.0, virtual=0, children=None, dead=False)
+    arena.set('children', root, _roots(problem, arena))
+    for child in arena.get('children', root):
+        arena.set('parent', child, root)
+    best = None
+    expanded = legs = 0
+    stopped = False
+
+    def score(node, parent_visits):
+        n = arena.get('visits', node) + arena.get('virtual', node)
+        if n == 0:
+            return float('inf')
+        # Virtual losses count as visits with zero reward
+        return arena.get('value', node) / n + exploration * math.sqrt(math.log(parent_visits + 1) / n)
+
+    def backup(node, reward):
+        while node is not None:
+            arena.set('visits', node, arena.get('visits', node) + 1)
+            arena.set('value', node, arena.get('value', node) + reward)
+            node = arena.get('parent', node)
+
+    for _ in range(iterations):
+        if arena.get('dead', root):
+            break
+        if _out_of_time(deadline, stop):
+            stopped = True
+            break
+        # Selection with virtual loss
+        leaves = []
+        for _ in range(parallel):
+            node = root
+            path = [root]
+            while arena.get('children', node) is not None:
+                live = [c for c in arena.get('children', node) if not arena.get('dead', c)]
+                if not live:
+                    arena.set('dead', node, True)
+                    break
+                parent_visits = arena.get('visits', node) + arena.get('virtual', node)
+                node = max(live, key=lambda c: (score(c, parent_visits), -c))
+                path.append(node)
+            if arena.get('dead', node) or node in leaves:
+                continue
+            for n in path:
+                arena.set('virtual', n, arena.get('virtual', n) + 1)
+            leaves.append(node)
+        if not leaves:
+            continue
+        # Batched expansion of every selected leaf
+        children, requested = _expand(problem, arena, leaves)
+        expanded += len(leaves)
+        legs += requested
+        for child in children:
+            reward = _reward(arena.get('cost', child), cost_scale)
+            if arena.get('terminal', child) and (best is None or arena.get('cost', child) < arena.get('cost', best)):
+                best = child
+            arena.set('visits', child, 1)
+            arena.set('value', child, reward)
+        # Back up each leaf's best child and release the virtual losses
+        for leaf in leaves:
+            kids = arena.get('children', leaf)
+            reward = max((arena.get('value', c) for c in kids), default=0.0)
+            node = leaf
+            while node is not None:
+                arena.set('virtual', node, arena.get('virtual', node) - 1)
+                node = arena.get('parent', node)
+            backup(leaf, reward)
+    return ExploreResult(None if best is None else _path(arena, best), expanded, legs, stopped)
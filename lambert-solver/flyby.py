@@ -0,0 +1,247 @@
+"""
+Gravity-assist flyby model for multiple-gravity-assist (MGA) chains.
+
+A junction between two Lambert legs has an incoming and an outgoing planet-
+relative v_inf. The flyby has to turn v_inf_in into v_inf_out by the angle
+delta between them:
+
+- Unpowered: |v_inf_in| = |v_inf_out| and delta = 2 asin(1 / e), i.e.
+  rp = mu / v_inf^2 (1 / sin(delta / 2) - 1).
+- Powered, with a tangential burn at periapsis: the incoming and outgoing
+  hyperbolas share rp, and asin(1 / e_in) + asin(1 / e_out) = delta with
+  e = 1 + rp v_inf^2 / mu. The burn is
+  dv = |sqrt(v_in^2 + 2 mu / rp) - sqrt(v_out^2 + 2 mu / rp)|.
+
+solve_flybys solves the periapsis equation for whole arrays of junctions.
+All active lanes take Newton steps on ln rp in lockstep, as in
+kernel.solve_lanes. Junctions that would need rp below the minimum are
+TURN_LIMITED: they fly at rp_min with the periapsis burn above and pay for
+the remaining turn delta - delta_max by rotating v_inf_out, 2 v_out
+sin((delta - delta_max) / 2), so Δv is continuous at the turn limit. rotate_flybys is the unpowered forward model
+(v_inf_in, rp, B-plane angle) -> v_inf_out.
+"""
+import math
+from arena import thread_scratch
+from batch import DEFAULT_CHUNK_SIZE, _output, as_doubles, make_chunks, imap_chunks
+
+# Gravitational parameter (km^3/s^2) and equatorial radius (km)
+PLANETS = {
+    'mercury': (22031.86855, 2439.7),
+    'venus': (324858.592, 6051.8),
+    'earth': (398600.4418, 6378.137),
+    'mars': (42828.375214, 3396.19),
+    'jupiter': (126712764.8, 71492.0),
+    'saturn': (37940585.2, 60268.0),
+    'uranus': (5794556.4, 25559.0),
+    'neptune': (6836527.1, 24764.0),
+}
+
+def min_periapsis(planet, altitude=300.0):
+    """Smallest allowed flyby periapsis radius (km) for a planet name and altitude (km)."""
+    return PLANETS[planet][1] + altitude
+
+# Flyby status codes
+FLYBY_OK = 0
+TURN_LIMITED = 1
+FLYBY_ERROR = 2
+
+def _turn(rp, a, b):
+    # Turn angle of the powered flyby at rp, with a, b = v_inf^2 / mu
+    return math.asin(1 / (1 + rp * a)) + math.asin(1 / (1 + rp * b))
+
+def solve_flybys(mu, vinf_in, vinf_out, rp_min, rp_out, dv_out, status_out, scratch,
+                 max_iterations=50, tolerance=1e-12):
+    """
+    Powered-flyby periapsis and Δv for n junctions stored as flat buffers.
+
+    :param mu: Gravitational parameter of the flyby body (km^3/s^2)
+    :param vinf_in: 3n incoming v_inf components (km/s)
+    :param vinf_out: 3n outgoing v_inf components (km/s)
+    :param rp_min: Minimum periapsis radius (km)
+    :param rp_out: n writable buffer for the periapsis radii (inf for no turn)
+    :param dv_out: n writable buffer for the periapsis Δv (km/s)
+    :param status_out: n writable buffer for FLYBY_OK, TURN_LIMITED or FLYBY_ERROR
+    :param scratch: arena.ScratchArena for per-lane intermediates
+    """
+    n = len(rp_out)
+    a = scratch.take(n)
+    b = scratch.take(n)
+    delta = scratch.take(n)
+    x = scratch.take(n)
+    step = scratch.take(n)
+    active = scratch.take(n, 'b')
+
+    # Turn angles and feasibility
+    for i in range(n):
+        ix, iy, iz = vinf_in[3 * i], vinf_in[3 * i + 1], vinf_in[3 * i + 2]
+        ox, oy, oz = vinf_out[3 * i], vinf_out[3 * i + 1], vinf_out[3 * i + 2]
+        v_in_sq = ix * ix + iy * iy + iz * iz
+        v_out_sq = ox * ox + oy * oy + oz * oz
+        active[i] = 0
+        status_out[i] = FLYBY_OK
+        if v_in_sq == 0 or v_out_sq == 0:
+            status_out[i] = FLYBY_ERROR
+            rp_out[i] = dv_out[i] = float('nan')
+            continue
+        cos_delta = (ix * ox + iy * oy + iz * oz) / math.sqrt(v_in_sq * v_out_sq)
+        delta[i] = math.acos(max(min(cos_delta, 1.0), -1.0))
+        a[i] = v_in_sq / mu
+        b[i] = v_out_sq / mu
+        if delta[i] == 0:
+            rp_out[i] = float('inf')
+            continue
+        turn_max = _turn(rp_min, a[i], b[i])
+        if turn_max < delta[i]:
+            status_out[i] = TURN_LIMITED
+            rp_out[i] = rp_min
+            delta[i] -= turn_max
+            continue
+        # Start from the unpowered formula with the mean v_inf^2
+        mean = (a[i] + b[i]) / 2
+        x[i] = math.log(max((1 / math.sin(delta[i] / 2) - 1) / mean, rp_min))
+        step[i] = float('inf')
+        active[i] = 1
+
+    # Newton on x = ln rp, all active lanes in lockstep. The turn decreases
+    # with rp, so steps below ln rp_min are halved back toward the bound.
+    x_min = math.log(rp_min)
+    remaining = sum(active)
+    iterations = 0
+    while remaining and iterations < max_iterations:
+        iterations += 1
+        for i in range(n):
+            if not active[i]:
+                continue
+            try:
+                rp = math.exp(x[i])
+                e_in = 1 + rp * a[i]
+                e_out = 1 + rp * b[i]
+                f = math.asin(1 / e_in) + math.asin(1 / e_out) - delta[i]
+                # d(turn)/d(ln rp) = -rp (a / (e_in sqrt(e_in^2 - 1)) + b / (e_out sqrt(e_out^2 - 1)))
+                df = -rp * (a[i] / (e_in * math.sqrt(e_in * e_in - 1))
+                            + b[i] / (e_out * math.sqrt(e_out * e_out - 1)))
+                s = f / df
+            except (ValueError, ZeroDivisionError, OverflowError):
+                # Parabolic limit (v_inf ~ 0) or runaway rp: leave the lane unconverged
+                active[i] = 0
+                remaining -= 1
+                step[i] = float('inf')
+                continue
+            x_next = x[i] - s
+            if x_next < x_min:
+                x_next = (x[i] + x_min) / 2
+            step[i] = x_next - x[i]
+            x[i] = x_next
+            if abs(step[i]) <= tolerance:
+                active[i] = 0
+                remaining -= 1
+
+    # Periapsis and Δv
+    for i in range(n):
+        if status_out[i] == FLYBY_ERROR:
+            continue
+        v_in = math.sqrt(a[i] * mu)
+        v_out = math.sqrt(b[i] * mu)
+        if status_out[i] == TURN_LIMITED:
+            # Periapsis burn at rp_min plus the rotation of v_inf_out by the turn deficit
+            dv_out[i] = (abs(math.sqrt(v_in * v_in + 2 * mu / rp_min) - math.sqrt(v_out * v_out + 2 * mu / rp_min))
+                         + 2 * v_out * math.sin(delta[i] / 2))
+            continue
+        if rp_out[i] == float('inf') and delta[i] == 0:
+            dv_out[i] = abs(v_in - v_out)
+            continue
+        if active[i] or abs(step[i]) > tolerance:
+            status_out[i] = FLYBY_ERROR
+            rp_out[i] = dv_out[i] = float('nan')
+            continue
+        rp = math.exp(x[i])
+        rp_out[i] = rp
+        dv_out[i] = abs(math.sqrt(v_in * v_in + 2 * mu / rp) - math.sqrt(v_out * v_out + 2 * mu / rp))
+
+def flyby(mu, vinf_in, vinf_out, rp_min):
+    """
+    One powered-flyby junction.
+
+    :return: (rp, dv, status)
+    """
+    rp, dv, status = [0.0], [0.0], [0]
+    scratch = thread_scratch()
+    solve_flybys(mu, vinf_in, vinf_out, rp_min, rp, dv, status, scratch)
+    scratch.reset()
+    return rp[0], dv[0], status[0]
+
+def _flyby_chunk(mu, vinf_in, vinf_out, rp_min):
+    scratch = thread_scratch()
+    vinf_in = memoryview(vinf_in).cast('d')
+    n = len(vinf_in) // 3
+    rp = scratch.take(n)
+    dv = scratch.take(n)
+    status = scratch.take(n, 'b')
+    solve_flybys(mu, vinf_in, memoryview(vinf_out).cast('d'), rp_min, rp, dv, status, scratch)
+    out = bytes(rp), bytes(dv), bytes(status)
+    scratch.reset()
+    return out
+
+def flyby_batch(mu, vinf_in, vinf_out, rp_min, rp_out=None, dv_out=None, status_out=None,
+                workers=1, chunk_size=DEFAULT_CHUNK_SIZE, placement=None):
+    """
+    solve_flybys over flat buffers or nested sequences of v_inf pairs, as
+    batch.solve_batch_arrays does for Lambert problems.
+
+    :param vinf_in: n x 3 incoming v_inf (any buffer-protocol object or sequence)
+    :param vinf_out: n x 3 outgoing v_inf
+    :param rp_min: Minimum periapsis radius (km), e.g. min_periapsis('venus')
+    :return: (rp_out, dv_out, status_out), allocated as array objects when not supplied
+    """
+    vinf_in = as_doubles(vinf_in)
+    vinf_out = as_doubles(vinf_out)
+    if len(vinf_in) % 3 or len(vinf_in) != len(vinf_out):
+        raise ValueError("vinf_in and vinf_out must hold the same number of 3-vectors")
+    n = len(vinf_in) // 3
+    rp_out, rp = _output(rp_out, n, 'd', 'rp_out')
+    dv_out, dv = _output(dv_out, n, 'd', 'dv_out')
+    status_out, status = _output(status_out, n, 'b', 'status_out')
+    chunks = make_chunks(n, chunk_size)
+    if placement is None and (workers <= 1 or len(chunks) <= 1):
+        scratch = thread_scratch()
+        for start, stop in chunks:
+            solve_flybys(mu, vinf_in[3 * start:3 * stop], vinf_out[3 * start:3 * stop], rp_min,
+                         rp[start:stop], dv[start:stop], status[start:stop], scratch)
+            scratch.reset()
+        return rp_out, dv_out, status_out
+    args = ((mu, bytes(vinf_in[3 * start:3 * stop]), bytes(vinf_out[3 * start:3 * stop]), rp_min)
+            for start, stop in chunks)
+    for (start, stop), (chunk_rp, chunk_dv, chunk_status) in zip(
+            chunks, imap_chunks(_flyby_chunk, args, workers, placement)):
+        rp[start:stop] = memoryview(chunk_rp).cast('d')
+        dv[start:stop] = memoryview(chunk_dv).cast('d')
+        status[start:stop] = memoryview(chunk_status).cast('b')
+    return rp_out, dv_out, status_out
+
+def rotate_flybys(mu, vinf_in, rp, beta, vinf_out, pole=(0.0, 0.0, 1.0)):
+    """
+    Unpowered flybys: outgoing v_inf for n incoming v_inf, periapsis radii and
+    B-plane angles, stored as flat buffers. The flyby turns v_inf by
+    2 asin(1 / e) away from the B vector cos(beta) T + sin(beta) R (see
+    bplane.py), with T = S x pole / |S x pole| and R = S x T.
+
+    :param vinf_in: 3n incoming v_inf components (km/s)
+    :param rp: n periapsis radii (km)
+    :param beta: n B-plane angles (rad), atan2(B . R, B . T)
+    :param vinf_out: 3n writable buffer for the outgoing v_inf
+    """
+    px, py, pz = pole
+    for i in range(len(rp)):
+        sx, sy, sz = vinf_in[3 * i], vinf_in[3 * i + 1], vinf_in[3 * i + 2]
+        v = math.sqrt(sx * sx + sy * sy + sz * sz)
+        sx, sy, sz = sx / v, sy / v, sz / v
+        tx, ty, tz = sy * pz - sz * py, sz * px - sx * pz, sx * py - sy * px
+        t = math.sqrt(tx * tx + ty * ty + tz * tz)
+        tx, ty, tz = tx / t, ty / t, tz / t
+        rx, ry, rz = sy * tz - sz * ty, sz * tx - sx * tz, sx * ty - sy * tx
+        delta = 2 * math.asin(1 / (1 + rp[i] * v * v / mu))
+        cb, sb = math.cos(beta[i]), math.sin(beta[i])
+        c, s = v * math.cos(delta), v * math.sin(delta)
+        vinf_out[3 * i] = c * sx - s * (cb * tx + sb * rx)
+        vinf_out[3 * i + 1] = c * sy - s * (cb * ty + sb * ry)
+        vinf_out[3 * i + 2] = c * sz - s * (cb * tz + sb * rz)
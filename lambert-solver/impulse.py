@@ -0,0 +1,251 @@
+"""
+Three-impulse transfers with an intermediate Lambert node.
+
+The direct transfer burns at r1 (v_start -> v1) and at r2 (v2 -> v_end).
+Splitting the arc at a point r_m reached at time t_m adds a midcourse burn
+between two Lambert legs, r1 -> r_m in t_m and r_m -> r2 in dt - t_m. Some
+geometries are cheaper this way, e.g. plane changes made far from the
+central body, or transfer angles near 180 degrees.
+
+three_impulse seeds candidate nodes around the direct arc: fractions of
+the transfer angle and time, scaled radially and optionally lifted out of
+plane. Both legs of every candidate go through one batch.solve_batch call.
+The cheapest candidates are then refined by BFGS over (r_m, t_m). The
+gradient of the total Δv comes from the analytic Lambert partials
+(sensitivity.lambert_partials): four directions per leg, so one gradient
+costs eight partial solves. The result reports the direct Δv and whether
+the midcourse burn beats it.
+"""
+import math
+from batch import DEFAULT_CHUNK_SIZE, make_chunks, imap_chunks, solve_batch
+from sensitivity import cross, dot, lambert_partials, norm
+
+# Δv (km/s) a midcourse burn must save before it counts as an improvement;
+# smaller savings are below what a real burn can be executed to.
+MIN_SAVING = 1e-3
+
+class ThreeImpulse:
+    """
+    Best three-impulse transfer: node r_m (km) and time t_m (s), the leg
+    velocities (v1, v_m_in, v_m_out, v2), the three burns (km/s vectors),
+    the total Δv, the direct two-impulse Δv (None if the direct solve
+    failed), improved (the three-impulse transfer saves more than min_saving)
+    and BFGS iterations.
+    """
+    def __init__(self, r_m, t_m, velocities, burns, dv, direct_dv, improved, iterations):
+        self.r_m = r_m
+        self.t_m = t_m
+        self.velocities = velocities
+        self.burns = burns
+        self.dv = dv
+        self.direct_dv = direct_dv
+        self.improved = improved
+        self.iterations = iterations
+
+    @property
+    def saving(self):
+        """Δv saved against the direct transfer (km/s), or None."""
+        return None if self.direct_dv is None else self.direct_dv - self.dv
+
+def _difference(a, b):
+    return [a[k] - b[k] for k in range(3)]
+
+def _candidates(r1, r2, dt, clockwise, fractions, scales, heights):
+    # Nodes on rotated, radially scaled copies of the transfer arc
+    r1_norm = norm(r1)
+    r2_norm = norm(r2)
+    n = cross(r1, r2)
+    n_norm = norm(n)
+    if n_norm <= 1e-12 * r1_norm * r2_norm:
+        raise ValueError("Position vectors are collinear; the transfer plane is undefined.")
+    n = [x / n_norm for x in n]
+    dnu = math.acos(max(min(dot(r1, r2) / (r1_norm * r2_norm), 1.0), -1.0))
+    if (not clockwise and n[2] < 0) or (clockwise and n[2] >= 0):
+        n = [-x for x in n]
+        dnu = 2 * math.pi - dnu
+    u1 = [x / r1_norm for x in r1]
+    w = cross(n, u1)
+    out = []
+    for f in fractions:
+        theta = f * dnu
+        radius = r1_norm + f * (r2_norm - r1_norm)
+        u = [math.cos(theta) * u1[k] + math.sin(theta) * w[k] for k in range(3)]
+        for scale in scales:
+            for height in heights:
+                out.append(([radius * (scale * u[k] + height * n[k]) for k in range(3)], f * dt))
+    return out
+
+def _legs(mu, r1, v_start, r2, v_end, dt, clockwise, x, z, gradient):
+    # Total Δv at node x = (r_m, t_m) and, if gradient, its derivatives
+    r_m, t_m = x[:3], x[3]
+    if not 0 < t_m < dt:
+        return float('inf'), None, None, z
+    directions = [(None, 0.0)]
+    if gradient:
+        directions = [([1.0 if k == axis else 0.0 for k in range(3)], 0.0) for axis in range(3)] + [(None, 1.0)]
+    za, zb = z
+    partials_a = []
+    partials_b = []
+    for direction, ddt in directions:
+        va1, va2, dva1, dva2, za = lambert_partials(mu, r1, r_m, t_m, clockwise, dr2=direction, ddt=ddt, z=za)
+        vb1, vb2, dvb1, dvb2, zb = lambert_partials(mu, r_m, r2, dt - t_m, clockwise, dr1=direction, ddt=-ddt,
+                                                    z=zb)
+        partials_a.append((dva1, dva2))
+        partials_b.append((dvb1, dvb2))
+    burns = [_difference(va1, v_start), _difference(vb1, va2), _difference(v_end, vb2)]
+    sizes = [norm(b) for b in burns]
+    total = sum(sizes)
+    grad = None
+    if gradient:
+        grad = []
+        for (dva1, dva2), (dvb1, dvb2) in zip(partials_a, partials_b):
+            d_burns = [dva1, _difference(dvb1, dva2), [-c for c in dvb2]]
+            grad.append(sum(dot(b, d) / s for b, d, s in zip(burns, d_burns, sizes) if s > 0))
+    state = ((va1, va2, vb1, vb2), burns)
+    return total, grad, state, (za, zb)
+
+def _refine(mu, r1, v_start, r2, v_end, dt, clockwise, x, tolerance, max_iterations):
+    # BFGS in scaled variables (r_m / length, t_m / dt), Armijo backtracking
+    length = max(norm(r1), norm(r2))
+    scale = [length, length, length, dt]
+
+    def evaluate(u, z, gradient):
+        try:
+            f, g, state, z = _legs(mu, r1, v_start, r2, v_end, dt, clockwise,
+                                   [u[k] * scale[k] for k in range(4)], z, gradient)
+        except (ValueError, ZeroDivisionError, OverflowError):
+            return float('inf'), None, None, z
+        return f, None if g is None else [g[k] * scale[k] for k in range(4)], state, z
+
+    u = [x[k] / scale[k] for k in range(4)]
+    f, g, state, z = evaluate(u, (None, None), True)
+    if g is None:
+        return None
+    H = [[1.0 if i == j else 0.0 for j in range(4)] for i in range(4)]
+    iteration = 0
+    for iteration in range(1, max_iterations + 1):
+        p = [-sum(H[i][j] * g[j] for j in range(4)) for i in range(4)]
+        slope = sum(p[k] * g[k] for k in range(4))
+        if slope >= 0:
+            H = [[1.0 if i == j else 0.0 for j in range(4)] for i in range(4)]
+            p = [-c for c in g]
+            slope = -sum(c * c for c in g)
+        # Keep trial nodes within a tenth of the length scale and of dt
+        step = min(1.0, 0.1 / max(max(abs(c) for c in p), 1e-300))
+        for _ in range(40):
+            trial = [u[k] + step * p[k] for k in range(4)]
+            f_trial, _, _, z_trial = evaluate(trial, z, False)
+            if f_trial <= f + 1e-4 * step * slope:
+                break
+            step *= 0.5
+        else:
+            break
+        f_new, g_new, state_new, z = evaluate(trial, z_trial, True)
+        if g_new is None:
+            break
+        s = [trial[k] - u[k] for k in range(4)]
+        y = [g_new[k] - g[k] for k in range(4)]
+        sy = sum(s[k] * y[k] for k in range(4))
+        done = f - f_new <= tolerance * max(f_new, 1e-12)
+        u, f, g, state = trial, f_new, g_new, state_new
+        if done:
+            break
+        if sy > 1e-300:
+            Hy = [sum(H[i][j] * y[j] for j in range(4)) for i in range(4)]
+            yHy = sum(y[i] * Hy[i] for i in range(4))
+            for i in range(4):
+                for j in range(4):
+                    H[i][j] += ((sy + yHy) * s[i] * s[j] / sy**2 - (Hy[i] * s[j] + s[i] * Hy[j]) / sy)
+    x = [u[k] * scale[k] for k in range(4)]
+    return f, x, state, iteration
+
+def _three_impulse(mu, r1, v_start, r2, v_end, dt, clockwise, direct, fractions, scales, heights, refine,
+                   tolerance, max_iterations, min_saving, solve):
+    candidates = _candidates(r1, r2, dt, clockwise, fractions, scales, heights)
+    problems = ([(r1, r_m, t_m, clockwise) for r_m, t_m in candidates]
+                + [(r_m, r2, dt - t_m, clockwise) for r_m, t_m in candidates])
+    result = solve(problems)
+    ranked = []
+    count = len(candidates)
+    for k, (r_m, t_m) in enumerate(candidates):
+        if not (result.succeeded(k) and result.succeeded(count + k)):
+            continue
+        dv = (norm(_difference(result.v1[k], v_start)) + norm(_difference(result.v1[count + k], result.v2[k]))
+              + norm(_difference(v_end, result.v2[count + k])))
+        ranked.append((dv, k))
+    ranked.sort()
+    best = None
+    for _, k in ranked[:refine]:
+        r_m, t_m = candidates[k]
+        refined = _refine(mu, r1, v_start, r2, v_end, dt, clockwise, list(r_m) + [t_m], tolerance,
+                          max_iterations)
+        if refined is not None and (best is None or refined[0] < best[0]):
+            best = refined
+    if best is None:
+        return None
+    dv, x, (velocities, burns), iterations = best
+    direct_dv = None
+    if direct is not None:
+        direct_dv = norm(_difference(direct[0], v_start)) + norm(_difference(v_end, direct[1]))
+    improved = direct_dv is None or dv < direct_dv - min_saving
+    return ThreeImpulse(x[:3], x[3], velocities, burns, dv, direct_dv, improved, iterations)
+
+def three_impulse(solver, r1, v_start, r2, v_end, dt, clockwise=False, fractions=(0.25, 0.5, 0.75),
+                  scales=(0.8, 1.0, 1.25), heights=(0.0,), refine=3, tolerance=1e-9, max_iterations=100,
+                  min_saving=MIN_SAVING, workers=1, placement=None):
+    """
+    Cheapest transfer from (r1, v_start) to (r2, v_end) in time dt with one
+    midcourse burn, compared with the direct solver.solve transfer.
+
+    :param v_start: Velocity before the first burn, e.g. on the departure orbit (km/s)
+    :param v_end: Velocity after the last burn, e.g. on the arrival orbit (km/s)
+    :param fractions: Candidate node fractions of the transfer angle and of dt
+    :param scales: Candidate node radius scales
+    :param heights: Candidate out-of-plane offsets (fractions of the node radius)
+    :param refine: Number of cheapest candidates refined by BFGS
+    :param tolerance: Relative Δv change that ends refinement
+    :param min_saving: Δv (km/s) the midcourse burn must save over the direct
+                       transfer for the result to count as improved
+    :param workers: Worker processes for the candidate batch
+    :return: ThreeImpulse, or None if no candidate could be solved
+    """
+    try:
+        direct = solver.solve(r1, r2, dt, clockwise)
+    except (ValueError, ZeroDivisionError, OverflowError):
+        direct = None
+    return _three_impulse(solver.mu, r1, v_start, r2, v_end, dt, clockwise, direct, fractions, scales, heights,
+                          refine, tolerance, max_iterations, min_saving,
+                          lambda problems: solve_batch(solver, problems, workers=workers, placement=placement))
+
+def _three_impulse_chunk(solver, problems, clockwise, fractions, scales, heights, refine, tolerance,
+                         max_iterations, min_saving):
+    out = []
+    for r1, v_start, r2, v_end, dt in problems:
+        try:
+            direct = solver.solve(r1, r2, dt, clockwise)
+        except (ValueError, ZeroDivisionError, OverflowError):
+            direct = None
+        try:
+            out.append(_three_impulse(solver.mu, r1, v_start, r2, v_end, dt, clockwise, direct, fractions, scales,
+                                      heights, refine, tolerance, max_iterations, min_saving,
+                                      lambda batch: solve_batch(solver, batch)))
+        except (ValueError, ZeroDivisionError, OverflowError):
+            out.append(None)
+    return out
+
+def three_impulse_batch(solver, problems, clockwise=False, fractions=(0.25, 0.5, 0.75), scales=(0.8, 1.0, 1.25),
+                        heights=(0.0,), refine=3, tolerance=1e-9, max_iterations=100, min_saving=MIN_SAVING,
+                        workers=1, chunk_size=DEFAULT_CHUNK_SIZE, placement=None):
+    """
+    three_impulse over many (r1, v_start, r2, v_end, dt) problems, e.g. a
+    short list of sweep cells.
+
+    :return: List of ThreeImpulse, None where no candidate could be solved
+    """
+    chunks = make_chunks(len(problems), chunk_size)
+    args = ((solver, problems[start:stop], clockwise, fractions, scales, heights, refine, tolerance,
+             max_iterations, min_saving) for start, stop in chunks)
+    out = []
+    for chunk_out in imap_chunks(_three_impulse_chunk, args, workers, placement):
+        out.extend(chunk_out)
+    return out
@@ -0,0 +1,409 @@
+"""
+Lane-wise batch kernel for the universal-variable Lambert method.
+
+All lanes of a chunk advance through the Newton iteration together. Per-lane
+state (norms, A, z, Newton ratio, iteration counters and the active mask) lives
+in scratch buffers taken from an arena.ScratchArena, so a chunk allocates no
+per-problem objects. With the default starting z and no z range, the
+arithmetic matches LambertSolver.solve step for step.
+
+Mixed batches are first sorted into regime buckets (see classify) so that
+lanes solved together take the same branches and similar iteration counts.
+Each bucket runs with its own starting z and admissible z range.
+"""
+import math
+from stumpff import stumpff_c, stumpff_s, parabolic_time
+
+# Lane status codes
+OK = 0
+SMALL_ANGLE = 1
+ZERO_A = 2
+NO_CONVERGENCE = 3
+SMALL_G = 4
+NUMERIC_ERROR = 5
+PLANE_ERROR = 6
+CHECK_FAILED = 7
+RESIDUAL_FAILED = 8
+
+STATUS_MESSAGES = {
+    SMALL_ANGLE: "Angle between position vectors is zero or very small; cannot compute transfer orbit.",
+    ZERO_A: "Angle between position vectors is zero; cannot compute transfer orbit.",
+    SMALL_G: "g is too close to zero, causing division issues",
+    NUMERIC_ERROR: "Numerical error during iteration",
+    PLANE_ERROR: "Cannot solve in the given transfer plane (positions off the plane or pointing the same way)",
+    CHECK_FAILED: "Analytic propagation of v1 misses r2 by more than the check tolerance",
+    RESIDUAL_FAILED: "Energy and angular momentum residual stays above tolerance after escalation",
+}
+
+def status_message(status, max_iterations):
+    if status == NO_CONVERGENCE:
+        return f"No convergence after {max_iterations} iterations"
+    return STATUS_MESSAGES.get(status)
+
+# Regime buckets. Degenerate lanes (r1 and r2 collinear) never reach a kernel.
+# The other buckets are keyed on dt over the parabolic time of flight.
+DEGENERATE = 0
+NEAR_PI = 1
+HYPERBOLIC = 2
+ELLIPTIC_FAST = 3
+ELLIPTIC = 4
+ELLIPTIC_SLOW = 5
+ELLIPTIC_LONG = 6
+BUCKET_NAMES = ('degenerate', 'near_pi', 'hyperbolic', 'elliptic_fast', 'elliptic',
+                'elliptic_slow', 'elliptic_long')
+
+# Starting z per bucket, picked from iteration counts on mixed LEO-GEO batches.
+# Slow transfers sit close to z = 4 pi^2, where starting from z = 0 costs
+# hundreds of Newton steps.
+BUCKET_INITIAL_Z = {
+    NEAR_PI: 0.0,
+    HYPERBOLIC: -1.0,
+    ELLIPTIC_FAST: 5.0,
+    ELLIPTIC: 25.0,
+    ELLIPTIC_SLOW: 30.0,
+    ELLIPTIC_LONG: 35.0,
+}
+
+# Admissible z range per bucket for the zero-revolution solution. A Newton
+# step that leaves the range is replaced by a half step towards the bound,
+# which keeps elliptic lanes off the multi-revolution branches beyond 4 pi^2.
+FOUR_PI_SQUARED = 4 * math.pi**2
+BUCKET_Z_RANGE = {
+    NEAR_PI: (None, FOUR_PI_SQUARED),
+    HYPERBOLIC: (None, 0.0),
+    ELLIPTIC_FAST: (0.0, FOUR_PI_SQUARED),
+    ELLIPTIC: (0.0, FOUR_PI_SQUARED),
+    ELLIPTIC_SLOW: (0.0, FOUR_PI_SQUARED),
+    ELLIPTIC_LONG: (0.0, FOUR_PI_SQUARED),
+}
+
+# Transfers within this sine of 180 degrees get their own bucket
+NEAR_PI_SIN = 1e-3
+
+def classify(mu, r1, r2, dt, clockwise=False, tolerance=1e-8):
+    """
+    Regime bucket of one problem from its transfer angle, direction and
+    time of flight relative to the parabolic time.
+
+    :return: (bucket, long_way)
+    """
+    r1_norm = math.sqrt(r1[0]**2 + r1[1]**2 + r1[2]**2)
+    r2_norm = math.sqrt(r2[0]**2 + r2[1]**2 + r2[2]**2)
+    cos_dnu = (r1[0] * r2[0] + r1[1] * r2[1] + r1[2] * r2[2]) / (r1_norm * r2_norm)
+    cos_dnu = max(min(cos_dnu, 1.0), -1.0)
+    sin_dnu = math.sqrt(1.0 - cos_dnu**2)
+    cross_z = r1[0] * r2[1] - r1[1] * r2[0]
+    long_way = (not clockwise and cross_z < 0) or (clockwise and cross_z >= 0)
+    if abs(sin_dnu) < tolerance:
+        return DEGENERATE, long_way
+    if sin_dnu < NEAR_PI_SIN and cos_dnu < 0:
+        return NEAR_PI, long_way
+    c = math.sqrt((r2[0] - r1[0])**2 + (r2[1] - r1[1])**2 + (r2[2] - r1[2])**2)
+    s = (r1_norm + r2_norm + c) / 2
+    ratio = dt / parabolic_time(s, c, mu, long_way)
+    if ratio < 1:
+        return HYPERBOLIC, long_way
+    if ratio < 2:
+        return ELLIPTIC_FAST, long_way
+    if ratio < 10:
+        return ELLIPTIC, long_way
+    if ratio < 30:
+        return ELLIPTIC_SLOW, long_way
+    return ELLIPTIC_LONG, long_way
+
+def _compute_y(z, r1n, r2n, A):
+    C = stumpff_c(z)
+    S = stumpff_s(z)
+    if C == 0:
+        return float('inf')
+    return r1n + r2n + A * (z * S - 1.0) / math.sqrt(C)
+
+def _time_of_flight(z, r1n, r2n, A, mu):
+    y = _compute_y(z, r1n, r2n, A)
+    if y < 0:
+        return float('inf')
+    C = stumpff_c(z)
+    S = stumpff_s(z)
+    if C == 0:
+        return float('inf')
+    chi = math.sqrt(y / C)
+    return (chi**3 * S + A * math.sqrt(y)) / math.sqrt(mu)
+
+def solve_lanes(mu, r1, r2, dt, clockwise, v1_out, v2_out, status_out, scratch,
+                max_iterations=1000, tolerance=1e-8, initial_z=0.0, z_range=(None, None), chi_out=None):
+    """
+    Solve n Lambert problems stored as flat buffers.
+
+    :param r1: 3n departure position components (any indexable of floats)
+    :param r2: 3n arrival position components
+    :param dt: n times of flight
+    :param clockwise: n direction flags, or None for all counterclockwise
+    :param v1_out: 3n writable output buffer for departure velocities
+    :param v2_out: 3n writable output buffer for arrival velocities
+    :param status_out: n writable output buffer for lane status codes
+    :param scratch: arena.ScratchArena for per-lane intermediates
+    :param initial_z: Starting z for every lane
+    :param z_range: (low, high) bounds on z, either may be None
+    :param chi_out: Optional n writable buffer for the converged universal
+                    anomaly sqrt(y / C(z)), which seeds kepler_miss
+    """
+    n = len(dt)
+    r1n = scratch.take(n)
+    r2n = scratch.take(n)
+    A = scratch.take(n)
+    z = scratch.take(n)
+    ratio = scratch.take(n)
+    iterations = scratch.take(n, 'l')
+    active = scratch.take(n, 'b')
+
+    # Geometry
+    for i in range(n):
+        status_out[i] = OK
+        x1, y1, z1 = r1[3 * i], r1[3 * i + 1], r1[3 * i + 2]
+        x2, y2, z2 = r2[3 * i], r2[3 * i + 1], r2[3 * i + 2]
+        r1n[i] = math.sqrt(x1**2 + y1**2 + z1**2)
+        r2n[i] = math.sqrt(x2**2 + y2**2 + z2**2)
+        cos_dnu = (x1 * x2 + y1 * y2 + z1 * z2) / (r1n[i] * r2n[i])
+        cos_dnu = max(min(cos_dnu, 1.0), -1.0)
+        sin_dnu = math.sqrt(1.0 - cos_dnu**2)
+        if abs(sin_dnu) < tolerance:
+            status_out[i] = SMALL_ANGLE
+            active[i] = 0
+            continue
+        cross_z = x1 * y2 - y1 * x2
+        cw = clockwise[i] if clockwise is not None else False
+        if (not cw and cross_z < 0) or (cw and cross_z >= 0):
+            sin_dnu = -sin_dnu
+        A[i] = sin_dnu * math.sqrt(r1n[i] * r2n[i] / (1.0 - cos_dnu))
+        if A[i] == 0:
+            status_out[i] = ZERO_A
+            active[i] = 0
+            continue
+        z[i] = initial_z
+        ratio[i] = 1.0
+        iterations[i] = 0
+        active[i] = 1
+
+    # Newton iteration, all active lanes in lockstep
+    sqrt_mu = math.sqrt(mu)
+    z_low, z_high = z_range
+    remaining = sum(active)
+    h = 1e-5
+    while remaining:
+        for i in range(n):
+            if not active[i]:
+                continue
+            if not (abs(ratio[i]) > tolerance and iterations[i] < max_iterations):
+                active[i] = 0
+                remaining -= 1
+                continue
+            iterations[i] += 1
+            try:
+                zi = z[i]
+                y = _compute_y(zi, r1n[i], r2n[i], A[i])
+                if y < 0:
+                    z[i] = zi + 0.1
+                    continue
+                C = stumpff_c(zi)
+                S = stumpff_s(zi)
+                if C == 0:
+                    z[i] = zi + 0.1
+                    continue
+                chi = math.sqrt(y / C)
+                tof = (chi**3 * S + A[i] * math.sqrt(y)) / sqrt_mu
+                tof_plus = _time_of_flight(zi + h, r1n[i], r2n[i], A[i], mu)
+                tof_minus = _time_of_flight(zi - h, r1n[i], r2n[i], A[i], mu)
+                dtof_dz = (tof_plus - tof_minus) / (2 * h)
+                if dtof_dz == 0:
+                    active[i] = 0
+                    remaining -= 1
+                    continue
+                ratio[i] = (tof - dt[i]) / dtof_dz
+                z_next = zi - ratio[i]
+                if z_high is not None and z_next >= z_high:
+                    z_next = (zi + z_high) / 2
+                elif z_low is not None and z_next <= z_low:
+                    z_next = (zi + z_low) / 2
+                z[i] = z_next
+            except (ValueError, ZeroDivisionError, OverflowError):
+                status_out[i] = NUMERIC_ERROR
+                active[i] = 0
+                remaining -= 1
+
+    # Velocities
+    for i in range(n):
+        if status_out[i] != OK:
+            continue
+        if iterations[i] == max_iterations:
+            status_out[i] = NO_CONVERGENCE
+            continue
+        try:
+            y = _compute_y(z[i], r1n[i], r2n[i], A[i])
+            f = 1 - y / r1n[i]
+            g = A[i] * math.sqrt(y / mu)
+            gdot = 1 - y / r2n[i]
+        except (ValueError, ZeroDivisionError, OverflowError):
+            status_out[i] = NUMERIC_ERROR
+            continue
+        if abs(g) < tolerance:
+            status_out[i] = SMALL_G
+            continue
+        if chi_out is not None:
+            chi_out[i] = math.sqrt(y / stumpff_c(z[i]))
+        inv_g = 1 / g
+        for k in range(3):
+            a = r1[3 * i + k]
+            b = r2[3 * i + k]
+            v1_out[3 * i + k] = (b - a * f) * inv_g
+            v2_out[3 * i + k] = (b * gdot - a) * inv_g
+
+def universal_anomaly(r0, vr0, alpha, sqrt_mu, dt, chi, max_iterations=100):
+    """
+    Root chi of the universal Kepler equation from chi, for a state with
+    radius r0, radial velocity vr0 and alpha = 2 / r0 - v0^2 / mu.
+
+    :raises ValueError: If the iteration does not converge
+    """
+    # The time equation increases with chi (its derivative is the radius), so
+    # Newton steps that leave the bracket [low, high] fall back to bisection.
+    low, high = 0.0, None
+    target = sqrt_mu * dt
+    for _ in range(max_iterations):
+        chi2 = chi * chi
+        psi = alpha * chi2
+        C = stumpff_c(psi)
+        S = stumpff_s(psi)
+        F = r0 * vr0 / sqrt_mu * chi2 * C + (1 - alpha * r0) * chi2 * chi * S + r0 * chi - target
+        if abs(F) <= 1e-13 * target:
+            return chi
+        if F > 0:
+            high = chi
+        else:
+            low = chi
+        dF = r0 * vr0 / sqrt_mu * chi * (1 - psi * S) + (1 - alpha * r0) * chi2 * C + r0
+        chi_next = chi - F / dF
+        if not low < chi_next < (high if high is not None else float('inf')):
+            chi_next = (low + high) / 2 if high is not None else 2 * chi + 1
+        if chi_next == chi:
+            return chi
+        chi = chi_next
+    raise ValueError(f"Universal Kepler equation did not converge after {max_iterations} iterations")
+
+def kepler_miss(mu, r1, v1, r2, dt, chi=None, v2=None, max_iterations=100):
+    """
+    Relative arrival miss |r(dt) - r2| / |r2| when v1 is propagated
+    analytically from r1 with the universal Kepler equation and Lagrange f
+    and g. This is an independent check on a solution: only r1, v1 and dt go
+    into the propagation.
+
+    :param chi: Starting universal anomaly, e.g. the kernel's converged
+                sqrt(y / C(z)), which is already the root for a good solution;
+                None or NaN to start from v2 or, without it, the standard guess
+    :param v2: Arrival velocity of the solution; chi = sigma2 - sigma1 +
+               alpha sqrt(mu) dt with sigma = r . v / sqrt(mu) then gives the
+               root directly for solvers that do not produce a chi
+    :return: Relative miss (inf if the Kepler iteration fails)
+    """
+    x, y, z = r1[0], r1[1], r1[2]
+    vx, vy, vz = v1[0], v1[1], v1[2]
+    r0 = math.sqrt(x * x + y * y + z * z)
+    vr0 = (x * vx + y * vy + z * vz) / r0
+    alpha = 2 / r0 - (vx * vx + vy * vy + vz * vz) / mu
+    sqrt_mu = math.sqrt(mu)
+    if chi is None or chi != chi:
+        if v2 is not None:
+            chi = ((r2[0] * v2[0] + r2[1] * v2[1] + r2[2] * v2[2]) / sqrt_mu - r0 * vr0 / sqrt_mu
+                   + alpha * sqrt_mu * dt)
+        else:
+            chi = sqrt_mu * abs(alpha) * dt
+    try:
+        chi = universal_anomaly(r0, vr0, alpha, sqrt_mu, dt, chi, max_iterations)
+        chi2 = chi * chi
+        psi = alpha * chi2
+        f = 1 - chi2 / r0 * stumpff_c(psi)
+        g = dt - chi2 * chi / sqrt_mu * stumpff_s(psi)
+    except (ValueError, ZeroDivisionError, OverflowError):
+        return float('inf')
+    bx, by, bz = r2[0], r2[1], r2[2]
+    miss = math.sqrt((f * x + g * vx - bx)**2 + (f * y + g * vy - by)**2 + (f * z + g * vz - bz)**2)
+    return miss / math.sqrt(bx * bx + by * by + bz * bz)
+
+def _acceleration(mu, x, y, z):
+    k = -mu / math.sqrt(x**2 + y**2 + z**2)**3
+    return x * k, y * k, z * k
+
+def propagate_lanes(mu, r0, v0, dt, r_out, v_out, num_steps=1000):
+    """
+    RK4-propagate n states stored as flat buffers, with the same steps and
+    arithmetic as main.propagate_orbit.
+
+    :param r0: 3n initial position components
+    :param v0: 3n initial velocity components
+    :param dt: n propagation times
+    :param r_out: 3n writable output buffer for final positions
+    :param v_out: 3n writable output buffer for final velocities
+    """
+    for i in range(len(dt)):
+        h = dt[i] / num_steps
+        rx, ry, rz = r0[3 * i], r0[3 * i + 1], r0[3 * i + 2]
+        vx, vy, vz = v0[3 * i], v0[3 * i + 1], v0[3 * i + 2]
+        for _ in range(num_steps):
+            a1x, a1y, a1z = _acceleration(mu, rx, ry, rz)
+            k2rx, k2ry, k2rz = vx + a1x * (h / 2), vy + a1y * (h / 2), vz + a1z * (h / 2)
+            a2x, a2y, a2z = _acceleration(mu, rx + vx * (h / 2), ry + vy * (h / 2), rz + vz * (h / 2))
+            k3rx, k3ry, k3rz = vx + a2x * (h / 2), vy + a2y * (h / 2), vz + a2z * (h / 2)
+            a3x, a3y, a3z = _acceleration(mu, rx + k2rx * (h / 2), ry + k2ry * (h / 2), rz + k2rz * (h / 2))
+            k4rx, k4ry, k4rz = vx + a3x * h, vy + a3y * h, vz + a3z * h
+            a4x, a4y, a4z = _acceleration(mu, rx + k3rx * h, ry + k3ry * h, rz + k3rz * h)
+            rx += (vx + k2rx * 2 + k3rx * 2 + k4rx) * (h / 6)
+            ry += (vy + k2ry * 2 + k3ry * 2 + k4ry) * (h / 6)
+            rz += (vz + k2rz * 2 + k3rz * 2 + k4rz) * (h / 6)
+            vx += (a1x + a2x * 2 + a3x * 2 + a4x) * (h / 6)
+            vy += (a1y + a2y * 2 + a3y * 2 + a4y) * (h / 6)
+            vz += (a1z + a2z * 2 + a3z * 2 + a4z) * (h / 6)
+        r_out[3 * i], r_out[3 * i + 1], r_out[3 * i + 2] = rx, ry, rz
+        v_out[3 * i], v_out[3 * i + 1], v_out[3 * i + 2] = vx, vy, vz
+
+# Derived quantities computed per lane by lane_metrics, in this order
+METRIC_FIELDS = ('energy', 'c3', 'vinf1', 'vinf2', 'dv', 'a', 'e', 'inclination')
+METRIC_COUNT = len(METRIC_FIELDS)
+
+def lane_metrics(mu, r1, v1, r2, v2, vb1=None, vb2=None):
+    """
+    Transfer metrics from one solved lane, written out per component so the
+    batch engine can compute them while the lane's vectors are at hand.
+
+    :param vb1: Departure body velocity, or None
+    :param vb2: Arrival body velocity, or None
+    :return: Tuple in METRIC_FIELDS order: specific energy (km^2/s^2), C3
+             (km^2/s^2), departure and arrival v-infinity (km/s), total Δv
+             (km/s), transfer semi-major axis (km, inf for a parabola),
+             eccentricity and inclination (rad). C3 and the departure
+             v-infinity are NaN without vb1, the arrival v-infinity without
+             vb2, and the total Δv without either
+    """
+    x, y, z = r1[0], r1[1], r1[2]
+    vx, vy, vz = v1[0], v1[1], v1[2]
+    r = math.sqrt(x * x + y * y + z * z)
+    v2_sq = vx * vx + vy * vy + vz * vz
+    energy = v2_sq / 2 - mu / r
+    a = -mu / (2 * energy) if energy != 0 else float('inf')
+    hx, hy, hz = y * vz - z * vy, z * vx - x * vz, x * vy - y * vx
+    h = math.sqrt(hx * hx + hy * hy + hz * hz)
+    inclination = math.acos(max(min(hz / h, 1.0), -1.0)) if h > 0 else 0.0
+    rv = x * vx + y * vy + z * vz
+    k = v2_sq - mu / r
+    ex = (k * x - rv * vx) / mu
+    ey = (k * y - rv * vy) / mu
+    ez = (k * z - rv * vz) / mu
+    e = math.sqrt(ex * ex + ey * ey + ez * ez)
+    # Without a body velocity there is no v-infinity, and |v| is not a C3
+    if vb1 is None:
+        d1 = float('nan')
+    else:
+        d1 = math.sqrt((vx - vb1[0])**2 + (vy - vb1[1])**2 + (vz - vb1[2])**2)
+    if vb2 is None:
+        d2 = float('nan')
+    else:
+        d2 = math.sqrt((v2[0] - vb2[0])**2 + (v2[1] - vb2[1])**2 + (v2[2] - vb2[2])**2)
+    return energy, d1 * d1, d1, d2, d1 + d2, a, e, inclination
@@ -1,4 +1,6 @@
 import math
+import kernel
+from stumpff import stumpff_c, stumpff_s, parabolic_time
 
 # Vector operations
 def vector_add(a, b):
@@ -23,33 +25,121 @@ def vector_cross(a, b):
         a[0] * b[1] - a[1] * b[0]
     ]
 
-# Stumpff functions
-def stumpff_c(z):
-    if z > 0:
-        sz = math.sqrt(z)
-        return (1 - math.cos(sz)) / z
-    elif z < 0:
-        sz = math.sqrt(-z)
-        return (1 - math.cosh(sz)) / z
-    else:
-        return 0.5
-
-def stumpff_s(z):
-    if z > 0:
-        sz = math.sqrt(z)
-        return (sz - math.sin(sz)) / (sz**3)
-    elif z < 0:
-        sz = math.sqrt(-z)
-        return (math.sinh(sz) - sz) / (sz**3)
-    else:
-        return 1/6
+def universal_time_of_flight(z, r1_norm, r2_norm, A, mu):
+    """
+    Time of flight on the zero-revolution branch of the universal-variable
+    equations: 0 where y < 0 (below the branch), infinite at z >= 4 pi^2.
+    """
+    C = stumpff_c(z)
+    if C <= 0:
+        return float('inf')
+    y = r1_norm + r2_norm + A * (z * stumpff_s(z) - 1) / math.sqrt(C)
+    if y < 0:
+        return 0.0
+    chi = math.sqrt(y / C)
+    return (chi**3 * stumpff_s(z) + A * math.sqrt(y)) / math.sqrt(mu)
+
+def bisect_z(mu, r1_norm, r2_norm, A, dt, max_iterations=200, tolerance=0.0):
+    """
+    Zero-revolution root of tof(z) = dt by bisection. The time of flight
+    increases from 0 to infinity on (-inf, 4 pi^2), so a bracket always exists.
+    Bisection stops once the bracket is no wider than tolerance (in z, like
+    the Newton step in LambertSolver.solve) or cannot be split further.
+    """
+    lo = -4.0
+    while universal_time_of_flight(lo, r1_norm, r2_norm, A, mu) >= dt:
+        lo *= 2
+        if lo < -1e5:
+            raise ValueError("No zero-revolution bracket for this time of flight")
+    hi = 4 * math.pi**2
+    for _ in range(max_iterations):
+        if hi - lo <= tolerance:
+            break
+        mid = (lo + hi) / 2
+        if mid == lo or mid == hi:
+            break
+        if universal_time_of_flight(mid, r1_norm, r2_norm, A, mu) < dt:
+            lo = mid
+        else:
+            hi = mid
+    return (lo + hi) / 2
+
+def solve_in_plane(mu, r1, r2, dt, plane_normal, clockwise=False, max_iterations=200, tolerance=0.0):
+    """
+    Zero-revolution Lambert solution in a given transfer plane. Works for
+    collinear r1 and r2 (including exactly 180 degrees), where the plane is
+    otherwise undefined.
+
+    The transfer angle is measured about plane_normal, so the motion is
+    counterclockwise about it (clockwise=True reverses it). Velocities are
+    built from radial and transverse components, with sigma = r . v / sqrt(mu)
+    from the universal Kepler equation, instead of from the Lagrange
+    coefficients, whose g vanishes at 180 degrees.
+
+    :param plane_normal: Transfer plane normal, e.g. the angular momentum of a
+                         reference orbit; r1 and r2 must lie in the plane
+    :param max_iterations: Bisection steps on z
+    :param tolerance: Bracket width in z at which bisection stops (0 for full precision)
+    :return: (v1, v2) Initial and final velocity vectors (km/s)
+    """
+    r1_norm = vector_norm(r1)
+    r2_norm = vector_norm(r2)
+    n = vector_multiply(plane_normal, (-1 if clockwise else 1) / vector_norm(plane_normal))
+    if abs(vector_dot(n, r1)) > 1e-6 * r1_norm or abs(vector_dot(n, r2)) > 1e-6 * r2_norm:
+        raise ValueError("Position vectors do not lie in the given transfer plane.")
+    dnu = math.atan2(vector_dot(n, vector_cross(r1, r2)), vector_dot(r1, r2))
+    if dnu < 0:
+        dnu += 2 * math.pi
+    if dnu == 0:
+        raise ValueError("Position vectors point the same way; the transfer is rectilinear.")
+    # A = sin(dnu) sqrt(r1 r2 / (1 - cos(dnu))), written without cancellation
+    A = math.sqrt(2 * r1_norm * r2_norm) * math.cos(dnu / 2)
+    z = bisect_z(mu, r1_norm, r2_norm, A, dt, max_iterations, tolerance)
+    C = stumpff_c(z)
+    S = stumpff_s(z)
+    y = r1_norm + r2_norm + A * (z * S - 1) / math.sqrt(C)
+    chi = math.sqrt(y / C)
+    alpha = z / chi**2
+    # Semi-latus rectum p = r1 r2 (1 - cos(dnu)) / y and h = sqrt(mu p)
+    h = math.sqrt(mu * r1_norm * r2_norm * 2 * math.sin(dnu / 2)**2 / y)
+    # From the universal Kepler equation sqrt(mu) dt = chi^3 S + sigma1 chi^2 C + r1 chi (1 - z S)
+    sigma1 = (math.sqrt(mu) * dt - chi**3 * S - r1_norm * chi * (1 - z * S)) / (chi**2 * C)
+    sigma2 = sigma1 * (1 - z * C) + (1 - alpha * r1_norm) * chi * (1 - z * S)
+    velocities = []
+    for r, r_norm, sigma in ((r1, r1_norm, sigma1), (r2, r2_norm, sigma2)):
+        radial = vector_multiply(r, 1 / r_norm)
+        transverse = vector_cross(n, radial)
+        velocities.append(vector_add(vector_multiply(radial, sigma * math.sqrt(mu) / r_norm),
+                                     vector_multiply(transverse, h / r_norm)))
+    return velocities[0], velocities[1]
 
 # Lambert Solver
 class LambertSolver:
-    def __init__(self, mu):
+    def __init__(self, mu, backend='universal', policy=None):
         self.mu = mu  # gravitational parameter
+        self.backend = backend  # 'universal', 'izzo', 'hypergeometric', 'battin' or 'auto' (see backends.py)
+        # Backend policy for 'auto': a dictionary or a policy file path, loaded
+        # on the first solve (None for the default file, see backends.policy_path)
+        self.policy = policy
+        self.policy_resolved = False
+
+    def solve(self, r1, r2, dt, clockwise=False, max_iterations=1000, tolerance=1e-8, initial_z=0.0,
+              plane_normal=None, revolutions=0, branch='left'):
+        if plane_normal is not None:
+            # Explicit transfer plane, needed for collinear r1 and r2
+            return solve_in_plane(self.mu, r1, r2, dt, plane_normal, clockwise, max_iterations, tolerance)
+
+        if self.backend != 'universal' or revolutions:
+            from backends import resolve_policy, solve_with_backend
+            if self.backend == 'auto' and not self.policy_resolved:
+                # Partial dictionaries are completed from DEFAULT_POLICY too
+                self.policy = resolve_policy(self.policy)
+                self.policy_resolved = True
+            # max_iterations and tolerance bound each backend's own iteration
+            return solve_with_backend('izzo' if self.backend == 'universal' else self.backend,
+                                      self.mu, r1, r2, dt, clockwise, revolutions, branch, self.policy,
+                                      max_iterations, tolerance)
 
-    def solve(self, r1, r2, dt, clockwise=False, max_iterations=1000, tolerance=1e-8):
         r1_norm = vector_norm(r1)
         r2_norm = vector_norm(r2)
         
@@ -76,7 +166,7 @@ class LambertSolver:
             raise ValueError("Angle between position vectors is zero; cannot compute transfer orbit.")
 
         # Initial guess for z
-        z = 0.0
+        z = initial_z
 
         # Function to compute y(z)
         def compute_y(z):
@@ -97,7 +187,7 @@ class LambertSolver:
             if C == 0:
                 return float('inf')
             chi = math.sqrt(y / C)
-            tof = (chi**3 * S + A * chi) / math.sqrt(self.mu)
+            tof = (chi**3 * S + A * math.sqrt(y)) / math.sqrt(self.mu)
             return tof
 
         # Use Newton's method to solve for z
@@ -115,7 +205,7 @@ class LambertSolver:
                 z += 0.1
                 continue
             chi = math.sqrt(y / C)
-            tof = (chi**3 * S + A * chi) / math.sqrt(self.mu)
+            tof = (chi**3 * S + A * math.sqrt(y)) / math.sqrt(self.mu)
             # Compute derivative numerically
             h = 1e-5
             tof_plus = time_of_flight(z + h)
@@ -167,8 +257,8 @@ class LambertSolver:
         leo_altitude = 300  # km
         geo_altitude = 35786  # km
         leo_position = [earth_radius + leo_altitude, 0, 0]
-        geo_position = [earth_radius + geo_altitude, 0, 0]
-        return self.solve(leo_position, geo_position, dt, clockwise=not prograde)
+        geo_position = [-(earth_radius + geo_altitude), 0, 0]  # 180 degrees, Hohmann-like
+        return self.solve(leo_position, geo_position, dt, clockwise=not prograde, plane_normal=[0, 0, 1])
 
     def earth_to_moon(self, dt, prograde=True):
         """
@@ -271,6 +361,17 @@ def hohmann_transfer_time(r1, r2, mu):
     a = (r1 + r2) / 2
     return math.pi * math.sqrt(a**3 / mu)
 
+def parabolic_transfer_time(r1, r2, mu, clockwise=False):
+    """
+    Calculate the parabolic transfer time between two position vectors, going
+    the same way round as LambertSolver.solve. Faster transfers are hyperbolic.
+    """
+    c = vector_norm(vector_subtract(r2, r1))
+    s = (vector_norm(r1) + vector_norm(r2) + c) / 2
+    cross_z = vector_cross(r1, r2)[2]
+    long_way = (not clockwise and cross_z < 0) or (clockwise and cross_z >= 0)
+    return parabolic_time(s, c, mu, long_way)
+
 # Constants
 earth_radius = 6371  # km
 earth_mu = 398600.4418  # km^3/s^2
@@ -357,6 +458,7 @@ def main():
             print(f"Velocity error after propagation: {v2_error:.2f} km/s")
             print(f"Relative position error: {r2_error / vector_norm(r2):.2e}")
             print(f"Relative velocity error: {v2_error / vector_norm(v2):.2e}")
+            print(f"Relative position error (analytic Kepler): {kernel.kepler_miss(earth_mu, r1, v1, r2, dt, v2=v2):.2e}")
 
             t_transfer = math.sqrt(vector_norm(vector_subtract(r2, r1))**3 / (8 * earth_mu)) * math.pi
             print(f"Estimated minimum transfer time: {t_transfer:.2f} s")
@@ -0,0 +1,292 @@
+"""
+Multiple-gravity-assist (MGA) sequence search.
+
+candidate_sequences enumerates flyby sequences between a launch and a target
+body and drops the ones the Tisserand graph rules out (see tisserand.py),
+so infeasible sequences never reach the Lambert solver. evaluate_sequence
+grid-searches one sequence over launch epochs and per-leg times of flight.
+It works one leg layer at a time. All legs of a layer go through
+batch.solve_batch together, and all flyby junctions through
+flyby.flyby_batch. Every path is kept, or the best `keep` per layer.
+
+A path's cost is the launch v_inf, plus the powered-flyby Δv at every
+junction, plus the arrival v_inf if rendezvous is set (km/s).
+
+Sequences share legs: E->V at the same epochs appears in E-V-E-J and
+E-V-V-J alike. search therefore runs every sequence through one LegCache
+unless given another leg solver. The cache keeps solved legs keyed by
+(departure body, arrival body, departure epoch, time of flight), quantized
+to a time step, up to a bound on the number of legs, evicting the least
+recently used. Shared legs are then solved once across the whole search,
+and report() gives the hit rates. With a LegCache, evaluate_sequence snaps
+the launch epochs and times of flight to the quantum up front, so every
+epoch of a path, and both legs at a junction, use the same snapped times.
+"""
+import math
+import threading
+from collections import OrderedDict
+from itertools import product
+from batch import solve_batch
+from flyby import FLYBY_ERROR, PLANETS, flyby_batch
+
+def candidate_sequences(graph, launch, target, flybys, max_flybys, vinf_launch, vinf_arrival=None, slack=1):
+    """
+    Flyby sequences launch, f1, ..., fk, target (k <= max_flybys) that the
+    Tisserand graph allows, in order of increasing length.
+
+    :param graph: tisserand.TisserandGraph
+    :param flybys: Candidate flyby body names
+    :param vinf_launch: Largest launch v_inf (km/s)
+    :param vinf_arrival: Largest arrival v_inf (km/s), or None
+    :param slack: v_inf levels a flyby may change by (see TisserandGraph.widen)
+    :return: List of body-name tuples
+    """
+    out = []
+    for k in range(max_flybys + 1):
+        for middle in product(flybys, repeat=k):
+            sequence = (launch,) + middle + (target,)
+            if graph.feasible(sequence, vinf_launch, vinf_arrival, slack):
+                out.append(sequence)
+    return out
+
+class MgaPath:
+    """
+    Best path of a sequence: epochs[k] is the time at body k (s), legs[k]
+    the (v_inf departure, v_inf arrival) vectors of leg k, flyby_dv[k] the
+    Δv at the k-th flyby body and cost the total (km/s).
+    """
+    def __init__(self, sequence, epochs, legs, flyby_dv, cost):
+        self.sequence = sequence
+        self.epochs = epochs
+        self.legs = legs
+        self.flyby_dv = flyby_dv
+        self.cost = cost
+
+def _norm(v):
+    return (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]) ** 0.5
+
+def solve_legs(solver, ephemerides, legs, workers=1, placement=None):
+    """
+    Solve Lambert legs given as (departure body, arrival body, t0, tof).
+
+    :param ephemerides: Body name -> object with state(t) -> (r, v)
+    :return: List of (v_inf departure, v_inf arrival) vector pairs, None for failed legs
+    """
+    problems = []
+    velocities = []
+    for p, q, t0, tof in legs:
+        r1, vb1 = ephemerides[p].state(t0)
+        r2, vb2 = ephemerides[q].state(t0 + tof)
+        problems.append((r1, r2, tof))
+        velocities.append((vb1, vb2))
+    result = solve_batch(solver, problems, workers=workers, placement=placement)
+    out = []
+    for k, (vb1, vb2) in enumerate(velocities):
+        if not result.succeeded(k):
+            out.append(None)
+            continue
+        v1, v2 = result.v1[k], result.v2[k]
+        out.append(([v1[i] - vb1[i] for i in range(3)], [v2[i] - vb2[i] for i in range(3)]))
+    return out
+
+class LegCache:
+    """
+    Memoized Lambert legs, usable wherever solve_legs is. Keys snap the
+    departure epoch and time of flight to multiples of quantum (s), and a
+    leg is solved at its snapped times, so every request for a key gets the
+    same solution. Beyond max_entries legs the least recently used are
+    evicted.
+
+    The cache may be shared by threads. A key that another thread is
+    already solving is waited for, not solved twice.
+
+    :param quantum: Epoch and time-of-flight bin (s)
+    :param solve: Function with the signature of solve_legs for the misses
+    :param max_entries: Largest number of cached legs (None for no bound)
+    """
+    def __init__(self, quantum=3600.0, solve=solve_legs, max_entries=100000):
+        self.quantum = quantum
+        self.solve = solve
+        self.max_entries = max_entries
+        self.entries = OrderedDict()  # least recently used first
+        self.pending = {}             # key -> threading.Event while a thread solves it
+        self.lock = threading.Lock()
+        self.hits = 0
+        self.misses = 0
+        self.waits = 0
+        self.evictions = 0
+
+    def key(self, p, q, t0, tof):
+        return p, q, int(math.floor(t0 / self.quantum + 0.5)), int(math.floor(tof / self.quantum + 0.5))
+
+    def snap(self, t):
+        """t rounded to a multiple of the quantum, the time a leg at t is solved at."""
+        return math.floor(t / self.quantum + 0.5) * self.quantum
+
+    def __call__(self, solver, ephemerides, legs, workers=1, placement=None):
+        keys = [self.key(*leg) for leg in legs]
+        claimed = []
+        waiting = []
+        with self.lock:
+            mine = set()
+            for key in keys:
+                if key in self.entries or key in mine:
+                    if key in self.entries:
+                        self.entries.move_to_end(key)
+                    self.hits += 1
+                elif key in self.pending:
+                    if self.pending[key] not in waiting:
+                        waiting.append(self.pending[key])
+                    self.waits += 1
+                else:
+                    self.pending[key] = threading.Event()
+                    claimed.append(key)
+                    mine.add(key)
+                    self.misses += 1
+        found = {}
+        if claimed:
+            try:
+                found.update(zip(claimed, self._solve(solver, ephemerides, claimed, workers, placement)))
+            except BaseException:
+                with self.lock:
+                    for key in claimed:
+                        self.pending.pop(key).set()
+                raise
+            with self.lock:
+                for key in claimed:
+                    self.entries[key] = found[key]
+                    self.pending.pop(key).set()
+                self._evict()
+        for event in waiting:
+            event.wait()
+        with self.lock:
+            for key in keys:
+                if key not in found and key in self.entries:
+                    found[key] = self.entries[key]
+        # Legs evicted by other requests since this one saw them are solved
+        # again here rather than reported as failures.
+        missing = [key for key in dict.fromkeys(keys) if key not in found]
+        if missing:
+            found.update(zip(missing, self._solve(solver, ephemerides, missing, workers, placement)))
+        return [found[key] for key in keys]
+
+    def _solve(self, solver, ephemerides, keys, workers, placement):
+        q = self.quantum
+        return self.solve(solver, ephemerides, [(k[0], k[1], k[2] * q, k[3] * q) for k in keys],
+                          workers=workers, placement=placement)
+
+    def _evict(self):
+        # Caller holds the lock
+        while self.max_entries is not None and len(self.entries) > self.max_entries:
+            self.entries.popitem(last=False)
+            self.evictions += 1
+
+    def hit_rate(self):
+        requests = self.hits + self.misses + self.waits
+        return (self.hits + self.waits) / requests if requests else 0.0
+
+    def report(self):
+        """Cache summary for search output."""
+        requests = self.hits + self.misses + self.waits
+        return (f"Leg cache: {len(self.entries)} legs, {requests} requests, {self.hits} hits, "
+                f"{self.waits} waited on other threads, {self.misses} solved, {self.evictions} evicted, "
+                f"hit rate {self.hit_rate():.1%}")
+
+def snap_times(legs, times):
+    """
+    times snapped by the leg solver's snap() (e.g. LegCache.snap), duplicates
+    dropped, or unchanged for a solver without one. Epochs derived from
+    snapped times stay on the grid, so a leg's arrival bin is the next
+    leg's departure bin.
+    """
+    snap = getattr(legs, 'snap', None)
+    if snap is None:
+        return list(times)
+    return list(dict.fromkeys(snap(t) for t in times))
+
+def flyby_costs(body, vinf_in, vinf_out, rp_min):
+    """
+    Powered-flyby Δv at body for lists of incoming and outgoing v_inf vectors.
+
+    :param rp_min: Body name -> minimum periapsis radius (km)
+    :return: List of Δv (km/s), None where the flyby model fails
+    """
+    _, dv, status = flyby_batch(PLANETS[body][0], [x for v in vinf_in for x in v],
+                                [x for v in vinf_out for x in v], rp_min[body])
+    return [None if status[k] == FLYBY_ERROR else dv[k] for k in range(len(vinf_in))]
+
+def evaluate_sequence(solver, ephemerides, sequence, launch_epochs, tofs, rp_min, rendezvous=False,
+                      keep=None, workers=1, placement=None, legs=solve_legs):
+    """
+    Grid search of one flyby sequence.
+
+    :param ephemerides: Body name -> object with state(t) -> (r, v)
+    :param sequence: Body names, launch first
+    :param launch_epochs: Launch times (s)
+    :param tofs: One list of times of flight (s) per leg
+    :param rp_min: Body name -> minimum flyby periapsis radius (km)
+    :param rendezvous: Add the arrival v_inf to the cost
+    :param keep: Keep only the best keep paths after each layer (None keeps all)
+    :param legs: Leg solver with the signature of solve_legs, e.g. a LegCache
+                 (launch epochs and times of flight are then snapped to its quantum)
+    :return: Best MgaPath, or None if no path survives
+    """
+    launch_epochs = snap_times(legs, launch_epochs)
+    tofs = [snap_times(legs, leg_tofs) for leg_tofs in tofs]
+    # Path state: (epochs, leg solutions, flyby Δv list, cost so far)
+    paths = [([t0], [], [], 0.0) for t0 in launch_epochs]
+    for k in range(len(sequence) - 1):
+        p, q = sequence[k], sequence[k + 1]
+        extended = [(path, tof) for path in paths for tof in tofs[k]]
+        solutions = legs(solver, ephemerides, [(p, q, path[0][-1], tof) for path, tof in extended],
+                         workers=workers, placement=placement)
+        survivors = [(path, tof, leg) for (path, tof), leg in zip(extended, solutions) if leg is not None]
+        if k == 0:
+            dvs = [_norm(leg[0]) for _, _, leg in survivors]
+        else:
+            dvs = flyby_costs(p, [path[1][-1][1] for path, _, _ in survivors],
+                              [leg[0] for _, _, leg in survivors], rp_min)
+        paths = []
+        for (path, tof, leg), dv in zip(survivors, dvs):
+            if dv is None:
+                continue
+            epochs, path_legs, flyby_dv, cost = path
+            paths.append((epochs + [epochs[-1] + tof], path_legs + [leg],
+                          flyby_dv + ([dv] if k > 0 else []), cost + dv))
+        if keep is not None and len(paths) > keep:
+            paths.sort(key=lambda path: path[3])
+            paths = paths[:keep]
+        if not paths:
+            return None
+    best = None
+    for epochs, path_legs, flyby_dv, cost in paths:
+        if rendezvous:
+            cost += _norm(path_legs[-1][1])
+        if best is None or cost < best.cost:
+            best = MgaPath(tuple(sequence), epochs, path_legs, flyby_dv, cost)
+    return best
+
+def search(solver, ephemerides, graph, launch, target, flybys, max_flybys, launch_epochs, tof_choices,
+           rp_min, vinf_launch, vinf_arrival=None, slack=1, rendezvous=False, keep=None, workers=1,
+           placement=None, legs=None):
+    """
+    Tisserand-pruned MGA search: evaluate_sequence on every candidate sequence.
+
+    :param tof_choices: (p, q) -> list of times of flight (s) for a leg from p to q
+    :param legs: Leg solver shared by all sequences; default a new LegCache, so
+                 launch epochs and times of flight are snapped to its quantum.
+                 Pass solve_legs to solve every leg at its exact times.
+    :return: List of MgaPath sorted by cost
+    """
+    if legs is None:
+        legs = LegCache()
+    out = []
+    for sequence in candidate_sequences(graph, launch, target, flybys, max_flybys, vinf_launch, vinf_arrival,
+                                        slack):
+        tofs = [tof_choices[(sequence[k], sequence[k + 1])] for k in range(len(sequence) - 1)]
+        best = evaluate_sequence(solver, ephemerides, sequence, launch_epochs, tofs, rp_min, rendezvous,
+                                 keep, workers, placement, legs)
+        if best is not None:
+            out.append(best)
+    out.sort(key=lambda path: path.cost)
+    return out
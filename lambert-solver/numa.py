@@ -0,0 +1,222 @@
+"""
+NUMA-aware placement for the batch and grid engines.
+
+NumaPlacement runs one process pool per NUMA node. Its workers are pinned to
+the node's CPUs and each gets its own copy of the read-only replicas (e.g.
+ephemeris.EphemerisTable objects), made after pinning so the pages are first
+touched, and therefore allocated, on that node. Chunks are handed to the
+nodes in turn, a run of one chunk per worker at a time; chunk inputs are
+built inside the workers (sweeps compute body states there), so input and
+output buffers are first touched locally too. Results come back in chunk
+order, so reductions stay deterministic.
+
+imap() reads chunk arguments lazily and keeps at most LOOKAHEAD chunks per
+worker in flight on each node, like batch.imap_chunks without placement, so
+a streaming sweep holds a bounded number of chunks whatever the grid size.
+
+The pools are started on first use and kept until close(), so replicas are
+copied into each worker once, not once per call. Every chunk result carries
+the CPU affinity its worker actually has, and report() shows that rather
+than what was requested.
+
+Pass a placement to batch.map_chunks, solve_batch or sweep.porkchop_sweep:
+
+    with NumaPlacement(replicas={'earth': earth_table, 'mars': mars_table}) as placement:
+        porkchop_sweep(solver, Replica('earth'), Replica('mars'), t0s, tofs, placement=placement)
+        print(placement.report())
+"""
+import glob
+import os
+import pickle
+import re
+from collections import deque
+from concurrent.futures import ProcessPoolExecutor
+
+# Chunks in flight per worker of a node, ahead of the one being waited for
+LOOKAHEAD = 2
+
+_replicas = {}
+_affinity = None  # CPUs this worker process may run on, set by _init_worker
+
+def register_replicas(replicas):
+    """Make replicas available to Replica lookups in this process."""
+    _replicas.update(replicas)
+
+def replica(name):
+    return _replicas[name]
+
+class Replica:
+    """
+    Picklable stand-in for a replicated body table. state(t) looks the table
+    up in the current process, so chunks carry a name instead of the table.
+    """
+    def __init__(self, name):
+        self.name = name
+
+    def state(self, t):
+        return _replicas[self.name].state(t)
+
+def _parse_cpulist(text):
+    cpus = []
+    for part in text.strip().split(','):
+        if not part:
+            continue
+        if '-' in part:
+            lo, hi = part.split('-')
+            cpus.extend(range(int(lo), int(hi) + 1))
+        else:
+            cpus.append(int(part))
+    return cpus
+
+def numa_nodes():
+    """
+    CPUs of each NUMA node that this process may run on.
+
+    :return: Dictionary node id -> list of CPU ids; a single node 0 holding
+             every allowed CPU when the system exposes no NUMA information
+    """
+    allowed = os.sched_getaffinity(0) if hasattr(os, 'sched_getaffinity') else set(range(os.cpu_count() or 1))
+    nodes = {}
+    for path in sorted(glob.glob('/sys/devices/system/node/node[0-9]*')):
+        node = int(re.search(r'node(\d+)$', path).group(1))
+        try:
+            with open(os.path.join(path, 'cpulist')) as f:
+                cpus = [c for c in _parse_cpulist(f.read()) if c in allowed]
+        except OSError:
+            continue
+        if cpus:
+            nodes[node] = cpus
+    if not nodes:
+        nodes[0] = sorted(allowed)
+    return nodes
+
+def _format_cpus(cpus):
+    parts = []
+    start = prev = cpus[0]
+    for c in cpus[1:] + [None]:
+        if c is not None and c == prev + 1:
+            prev = c
+            continue
+        parts.append(str(start) if start == prev else f"{start}-{prev}")
+        if c is not None:
+            start = prev = c
+    return ",".join(parts)
+
+def _init_worker(cpus, replicas):
+    global _affinity
+    if cpus and hasattr(os, 'sched_setaffinity'):
+        try:
+            os.sched_setaffinity(0, cpus)
+        except OSError:
+            pass
+    if hasattr(os, 'sched_getaffinity'):
+        _affinity = tuple(sorted(os.sched_getaffinity(0)))
+    # replicas arrive pickled and are unpickled after pinning, so their pages
+    # are first touched on this node.
+    register_replicas(pickle.loads(replicas))
+
+def _run_placed(function, args):
+    return os.getpid(), _affinity, function(*args)
+
+class NumaPlacement:
+    """
+    :param nodes: Node id -> CPU list (default: numa_nodes())
+    :param workers_per_node: Worker processes per node (default: one per CPU)
+    :param replicas: Name -> read-only object copied into every worker
+    :param pin: Pin workers to their node's CPUs
+    """
+    def __init__(self, nodes=None, workers_per_node=None, replicas=None, pin=True):
+        self.nodes = nodes if nodes is not None else numa_nodes()
+        self.workers_per_node = workers_per_node
+        self.replicas = replicas or {}
+        self.pin = pin
+        self.assignment = {}
+        self.affinity = {}   # node -> {worker pid: CPUs it actually ran on}
+        self.executors = {}  # node -> ProcessPoolExecutor, started on first use
+        register_replicas(self.replicas)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def close(self):
+        """Shut the worker pools down; a later map starts new ones."""
+        for executor in self.executors.values():
+            executor.shutdown()
+        self.executors = {}
+
+    def _executor(self, node):
+        if node not in self.executors:
+            cpus = self.nodes[node] if self.pin else None
+            self.executors[node] = ProcessPoolExecutor(max_workers=self.workers(node),
+                                                       initializer=_init_worker,
+                                                       initargs=(cpus, pickle.dumps(self.replicas)))
+        return self.executors[node]
+
+    def workers(self, node):
+        return self.workers_per_node or len(self.nodes[node])
+
+    def _nodes_in_turn(self):
+        # Node of each successive chunk: workers(node) chunks per node, in turn
+        while True:
+            for node in sorted(self.nodes):
+                for _ in range(self.workers(node)):
+                    yield node
+
+    def imap(self, function, chunk_args):
+        """
+        Run function over chunk_args and yield the results in chunk order.
+        chunk_args is consumed lazily, with at most LOOKAHEAD chunks per
+        worker submitted to a node ahead of the result being waited for.
+        """
+        self.assignment = {node: 0 for node in self.nodes}
+        in_flight = {node: 0 for node in self.nodes}
+        pending = deque()
+
+        def next_result():
+            node, future = pending.popleft()
+            in_flight[node] -= 1
+            pid, affinity, result = future.result()
+            self.affinity.setdefault(node, {})[pid] = affinity
+            return result
+
+        try:
+            for node, args in zip(self._nodes_in_turn(), chunk_args):
+                while in_flight[node] >= LOOKAHEAD * self.workers(node):
+                    yield next_result()
+                pending.append((node, self._executor(node).submit(_run_placed, function, args)))
+                in_flight[node] += 1
+                self.assignment[node] += 1
+            while pending:
+                yield next_result()
+        finally:
+            # Reached on errors and when the caller stops early
+            for _, future in pending:
+                future.cancel()
+
+    def map(self, function, chunk_args):
+        """Run function over chunk_args; the list of results is in chunk order."""
+        return list(self.imap(function, chunk_args))
+
+    def report(self):
+        """Placement summary for benchmark output."""
+        lines = [f"NUMA nodes: {len(self.nodes)} (pinning {'on' if self.pin else 'off'})"]
+        for node in sorted(self.nodes):
+            cpus = self.nodes[node]
+            lines.append(f"  node {node}: cpus {_format_cpus(cpus)} ({len(cpus)}), "
+                         f"{self.workers(node)} workers, {self.assignment.get(node, 0)} chunks")
+            seen = self.affinity.get(node, {})
+            if self.pin and seen:
+                pinned = sum(1 for a in seen.values() if a is not None and set(a) <= set(cpus))
+                line = f"    pinned: {pinned}/{len(seen)} workers seen"
+                stray = sorted({a for a in seen.values() if a is None or not set(a) <= set(cpus)},
+                               key=lambda a: a or ())
+                if stray:
+                    line += ", others ran on " + "; ".join("unknown" if a is None else _format_cpus(list(a))
+                                                           for a in stray)
+                lines.append(line)
+        if self.replicas:
+            lines.append(f"  replicated per worker: {', '.join(sorted(self.replicas))}")
+        return "\n".join(lines)
@@ -0,0 +1,263 @@
+"""
+Streaming pipeline of composable stages.
+
+Items are dictionaries that flow through the stages in fixed-size batches.
+Each stage runs in its own thread and hands batches to the next one through a
+bounded queue, so a slow stage blocks its producers (backpressure) and no
+stage ever holds more than a few batches. Nothing is materialized except what
+the sink decides to keep.
+
+Example:
+    pipeline = Pipeline([
+        EphemerisStage(earth, mars),
+        LambertStage(solver),
+        DeltaVStage(),
+        FilterStage(lambda item: item['dv'] < 6.0),
+        CsvSink('transfers.csv', ['t0', 'tof', 'dv']),
+    ])
+    pipeline.run(grid_source(departure_times, tofs))
+"""
+import csv
+import queue
+import threading
+from main import vector_norm, vector_subtract, propagate_orbit
+from batch import _solve_chunk
+
+_END = object()
+
+class Stage:
+    """
+    Base class for pipeline stages. process() receives a list of items and
+    returns the list passed downstream; finish() is called once at the end
+    and its return value becomes the pipeline result for the last stage. If
+    process() or finish() raises, abort() is called instead so the stage can
+    release what it holds.
+    """
+    def process(self, batch):
+        return batch
+
+    def finish(self):
+        return None
+
+    def abort(self):
+        pass
+
+class EphemerisStage(Stage):
+    """Add r1, vb1 (departure body at t0) and r2, vb2 (arrival body at t0 + tof)."""
+    def __init__(self, departure_body, arrival_body):
+        self.departure_body = departure_body
+        self.arrival_body = arrival_body
+
+    def process(self, batch):
+        for item in batch:
+            item['r1'], item['vb1'] = self.departure_body.state(item['t0'])
+            item['r2'], item['vb2'] = self.arrival_body.state(item['t0'] + item['tof'])
+        return batch
+
+class LambertStage(Stage):
+    """Solve r1 -> r2 in tof for the whole batch; adds v1, v2 and error."""
+    def __init__(self, solver, clockwise=False, max_iterations=1000, tolerance=1e-8):
+        self.solver = solver
+        self.clockwise = clockwise
+        self.max_iterations = max_iterations
+        self.tolerance = tolerance
+
+    def process(self, batch):
+        problems = [(item['r1'], item['r2'], item['tof'], item.get('clockwise', self.clockwise))
+                    for item in batch]
+        out = _solve_chunk(self.solver.mu, problems, self.max_iterations, self.tolerance)
+        for item, (v1, v2, error) in zip(batch, out):
+            item['v1'] = v1
+            item['v2'] = v2
+            item['error'] = error
+        return batch
+
+class DeltaVStage(Stage):
+    """Add departure, arrival and total Δv relative to the body velocities."""
+    def process(self, batch):
+        for item in batch:
+            if item.get('error') is not None:
+                item['dv1'] = item['dv2'] = item['dv'] = None
+                continue
+            item['dv1'] = vector_norm(vector_subtract(item['v1'], item['vb1']))
+            item['dv2'] = vector_norm(vector_subtract(item['v2'], item['vb2']))
+            item['dv'] = item['dv1'] + item['dv2']
+        return batch
+
+class PropagateStage(Stage):
+    """RK4-propagate (r1, v1) over tof and add the arrival miss distance."""
+    def __init__(self, mu, num_steps=1000):
+        self.mu = mu
+        self.num_steps = num_steps
+
+    def process(self, batch):
+        for item in batch:
+            if item.get('error') is not None:
+                item['miss'] = None
+                continue
+            r_end, _ = propagate_orbit(item['r1'], item['v1'], item['tof'], self.mu, self.num_steps)
+            item['miss'] = vector_norm(vector_subtract(r_end, item['r2']))
+        return batch
+
+class FilterStage(Stage):
+    """Keep items for which predicate(item) is true. Failed solves are dropped."""
+    def __init__(self, predicate):
+        self.predicate = predicate
+
+    def process(self, batch):
+        return [item for item in batch if item.get('error') is None and self.predicate(item)]
+
+class ListSink(Stage):
+    """Collect the selected fields of every item; the list is the pipeline result."""
+    def __init__(self, fields=None):
+        self.fields = fields
+        self.items = []
+
+    def process(self, batch):
+        for item in batch:
+            self.items.append(item if self.fields is None else {k: item.get(k) for k in self.fields})
+        return []
+
+    def finish(self):
+        return self.items
+
+class CsvSink(Stage):
+    """Write the selected fields to a CSV file; the row count is the pipeline result."""
+    def __init__(self, path, fields):
+        self.path = path
+        self.fields = fields
+        self.rows = 0
+        self.file = None
+        self.writer = None
+
+    def process(self, batch):
+        if self.writer is None:
+            self.file = open(self.path, 'w', newline='')
+            self.writer = csv.writer(self.file)
+            self.writer.writerow(self.fields)
+        for item in batch:
+            self.writer.writerow([item.get(k) for k in self.fields])
+        self.rows += len(batch)
+        return []
+
+    def finish(self):
+        if self.file is None:
+            self.file = open(self.path, 'w', newline='')
+            csv.writer(self.file).writerow(self.fields)
+        self.file.close()
+        return self.rows
+
+    def abort(self):
+        if self.file is not None:
+            self.file.close()
+
+class PrintSink(Stage):
+    """Print the selected fields of every item, like the interactive scenarios do."""
+    def __init__(self, fields):
+        self.fields = fields
+        self.rows = 0
+
+    def process(self, batch):
+        for item in batch:
+            print(", ".join(f"{k}: {item.get(k)}" for k in self.fields))
+        self.rows += len(batch)
+        return []
+
+    def finish(self):
+        return self.rows
+
+def grid_source(departure_times, tofs):
+    """Yield one item per (departure time, time of flight) cell, row-major."""
+    for t0 in departure_times:
+        for tof in tofs:
+            yield {'t0': t0, 'tof': tof}
+
+class Pipeline:
+    """
+    :param stages: List of Stage objects; the last one is usually a sink
+    :param batch_size: Items per batch
+    :param queue_size: Batches each inter-stage queue holds before producers block
+    """
+    def __init__(self, stages, batch_size=256, queue_size=4):
+        if not stages:
+            raise ValueError("A pipeline needs at least one stage")
+        self.stages = stages
+        self.batch_size = batch_size
+        self.queue_size = queue_size
+
+    def run(self, source):
+        """
+        Feed every item of source through the stages.
+
+        :param source: Iterable of item dictionaries
+        :return: finish() value of the last stage
+        """
+        queues = [queue.Queue(maxsize=self.queue_size) for _ in self.stages]
+        errors = []
+        results = [None] * len(self.stages)
+        stop = threading.Event()
+
+        def put(q, batch):
+            # Blocking put that gives up once another stage has failed.
+            while not stop.is_set():
+                try:
+                    q.put(batch, timeout=0.1)
+                    return
+                except queue.Full:
+                    pass
+
+        def run_stage(k):
+            stage = self.stages[k]
+            downstream = queues[k + 1] if k + 1 < len(self.stages) else None
+            ended = False
+            try:
+                while True:
+                    batch = queues[k].get()
+                    if batch is _END:
+                        ended = True
+                        break
+                    if stop.is_set():
+                        continue
+                    batch = stage.process(batch)
+                    if downstream is not None and batch:
+                        put(downstream, batch)
+                results[k] = stage.finish()
+            except Exception as e:
+                errors.append(e)
+                stop.set()
+                stage.abort()
+                # Keep draining so the upstream stage never blocks forever.
+                # If finish() raised, _END has already been taken off the queue.
+                while not ended:
+                    ended = queues[k].get() is _END
+            if downstream is not None:
+                downstream.put(_END)
+
+        threads = [threading.Thread(target=run_stage, args=(k,), daemon=True)
+                   for k in range(len(self.stages))]
+        for t in threads:
+            t.start()
+        batch = []
+        try:
+            for item in source:
+                if stop.is_set():
+                    break
+                batch.append(item)
+                if len(batch) == self.batch_size:
+                    put(queues[0], batch)
+                    batch = []
+            if batch and not stop.is_set():
+                put(queues[0], batch)
+        except BaseException:
+            # A failing source still shuts the stages down before re-raising.
+            stop.set()
+            queues[0].put(_END)
+            for t in threads:
+                t.join()
+            raise
+        queues[0].put(_END)
+        for t in threads:
+            t.join()
+        if errors:
+            raise errors[0]
+        return results[-1]
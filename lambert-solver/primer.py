@@ -0,0 +1,141 @@
+"""
+Primer-vector check of two-impulse Lambert transfers.
+
+On an optimal impulsive trajectory the primer vector p(t), the adjoint of
+velocity, is the unit burn direction at every impulse and |p| <= 1 in
+between (Lawden). A two-impulse transfer fixes p at both ends,
+p(0) = dv1 / |dv1| and p(dt) = dv2 / |dv2|. Along a coast arc, p and its
+rate evolve with the two-body state transition matrix:
+
+    p(t) = Phi_rr(t) p(0) + Phi_rv(t) p'(0)
+
+so p'(0) = Phi_rv(dt)^-1 (p(dt) - Phi_rr(dt) p(0)). If |p| exceeds one
+anywhere, an added midcourse impulse near the maximum, along p, lowers the
+total Δv (Lion and Handelsman). A positive slope of |p| at departure or a
+negative one at arrival means an initial or final coast would.
+
+The STM comes from sensitivity.kepler_stm, the universal Kepler solution
+on dual numbers, with no numerical integration. It is built once, at dt.
+Each sample of p(t) is then one dual propagation along (p(0), p'(0)). primer_batch checks many
+solved transfers through the chunked worker pool. Transfers it flags can
+then go to impulse.three_impulse, with the node seeded at t_max.
+"""
+import math
+from batch import DEFAULT_CHUNK_SIZE, make_chunks, imap_chunks, solve_batch
+from sensitivity import cross, dot, kepler, kepler_stm
+
+class PrimerCheck:
+    """
+    Primer history of a two-impulse transfer: optimal (|p| <= 1 + tolerance
+    throughout), max_magnitude and its time t_max (s after departure), the
+    suggested midcourse burn position r_max (None if the maximum is at an
+    end) and unit direction, initial_coast and final_coast, and the sampled
+    times and magnitudes.
+    """
+    def __init__(self, optimal, max_magnitude, t_max, r_max, direction, initial_coast, final_coast, times,
+                 magnitudes):
+        self.optimal = optimal
+        self.max_magnitude = max_magnitude
+        self.t_max = t_max
+        self.r_max = r_max
+        self.direction = direction
+        self.initial_coast = initial_coast
+        self.final_coast = final_coast
+        self.times = times
+        self.magnitudes = magnitudes
+
+def _block(phi, row, column):
+    return [[phi[row + i][column + j] for j in range(3)] for i in range(3)]
+
+def _apply(m, x):
+    return [m[i][0] * x[0] + m[i][1] * x[1] + m[i][2] * x[2] for i in range(3)]
+
+def _unit(v):
+    n = math.sqrt(dot(v, v))
+    if n == 0:
+        raise ValueError("Zero impulse; the primer vector is undefined at that end.")
+    return [x / n for x in v]
+
+def _primer(mu, r1, v1, t, p0, pdot0, chi):
+    # p(t) = Phi(t) (p0, p'(0)) is the derivative of the state along that
+    # direction, so one dual propagation gives it without the full STM
+    r, _, p, pdot, chi = kepler(mu, r1, v1, t, p0, pdot0, chi=chi)
+    return p, pdot, r, chi
+
+def primer_check(mu, r1, v1, v2, dt, v_start, v_end, samples=64, tolerance=1e-6):
+    """
+    Primer-vector optimality check of the transfer (r1, v1) -> v2 in dt.
+
+    :param v_start: Velocity before the departure burn (km/s)
+    :param v_end: Velocity after the arrival burn (km/s)
+    :param samples: Intervals |p| is sampled on; the maximum is refined by a
+                    parabola through the largest sample and its neighbours
+    :param tolerance: Allowed excess of |p| over one
+    :return: PrimerCheck
+    :raises ValueError: If a burn is zero or the STM is singular
+    """
+    p0 = _unit([v1[k] - v_start[k] for k in range(3)])
+    pf = _unit([v_end[k] - v2[k] for k in range(3)])
+    _, _, phi, chi = kepler_stm(mu, r1, v1, dt)
+    # p'(0) from Phi_rv(dt) p'(0) = pf - Phi_rr(dt) p0, by Cramer's rule on the columns
+    m = _block(phi, 0, 3)
+    c1, c2, c3 = ([m[i][j] for i in range(3)] for j in range(3))
+    b = [x - y for x, y in zip(pf, _apply(_block(phi, 0, 0), p0))]
+    det = dot(c1, cross(c2, c3))
+    if abs(det) <= 1e-12 * dt**3:
+        raise ValueError("Phi_rv is singular (transfer angle near 0 or 180 degrees).")
+    pdot0 = [dot(b, cross(c2, c3)) / det, dot(c1, cross(b, c3)) / det, dot(c1, cross(c2, b)) / det]
+    pdotf = [x + y for x, y in zip(_apply(_block(phi, 3, 0), p0), _apply(_block(phi, 3, 3), pdot0))]
+
+    times = [dt * k / samples for k in range(samples + 1)]
+    magnitudes = [1.0]
+    chi = None
+    for t in times[1:-1]:
+        p, _, _, chi = _primer(mu, r1, v1, t, p0, pdot0, chi)
+        magnitudes.append(math.sqrt(dot(p, p)))
+    magnitudes.append(1.0)
+    k = max(range(len(times)), key=lambda i: magnitudes[i])
+    t_max = times[k]
+    if 0 < k < samples:
+        left, mid, right = magnitudes[k - 1], magnitudes[k], magnitudes[k + 1]
+        curvature = left - 2 * mid + right
+        if curvature < 0:
+            t_max += 0.5 * (left - right) / curvature * (dt / samples)
+    if 0 < t_max < dt:
+        p, _, r_max, _ = _primer(mu, r1, v1, t_max, p0, pdot0, None)
+    else:
+        p, r_max = (p0 if t_max <= 0 else pf), None
+    max_magnitude = max(math.sqrt(dot(p, p)), magnitudes[k])
+    return PrimerCheck(max_magnitude <= 1 + tolerance, max_magnitude, t_max, r_max, _unit(p),
+                       dot(p0, pdot0) > 0, dot(pf, pdotf) < 0, times, magnitudes)
+
+def _primer_chunk(mu, transfers, samples, tolerance):
+    out = []
+    for transfer in transfers:
+        if transfer is None:
+            out.append(None)
+            continue
+        try:
+            out.append(primer_check(mu, *transfer, samples=samples, tolerance=tolerance))
+        except (ValueError, ZeroDivisionError, OverflowError):
+            out.append(None)
+    return out
+
+def primer_batch(solver, problems, clockwise=False, samples=64, tolerance=1e-6, workers=1,
+                 chunk_size=DEFAULT_CHUNK_SIZE, placement=None):
+    """
+    Solve and primer-check many (r1, v_start, r2, v_end, dt) transfers, e.g.
+    sweep cells with their departure and arrival body velocities.
+
+    :return: List of PrimerCheck, None where the solve or the check failed
+    """
+    result = solve_batch(solver, [(r1, r2, dt, clockwise) for r1, _, r2, _, dt in problems], workers=workers,
+                         chunk_size=chunk_size, placement=placement)
+    transfers = [(r1, result.v1[k], result.v2[k], dt, v_start, v_end) if result.succeeded(k) else None
+                 for k, (r1, v_start, _, v_end, dt) in enumerate(problems)]
+    chunks = make_chunks(len(transfers), chunk_size)
+    args = ((solver.mu, transfers[start:stop], samples, tolerance) for start, stop in chunks)
+    out = []
+    for chunk_out in imap_chunks(_primer_chunk, args, workers, placement):
+        out.extend(chunk_out)
+    return out
@@ -0,0 +1,209 @@
+"""
+Linearized relative-motion rendezvous for close-range transfers.
+
+For proximity operations r1 and r2 are nearly the same vector, so the
+Lambert geometry degenerates (LambertSolver.solve raises on small transfer
+angles) and loses digits well before that. Here the chaser moves relative to
+a target in the target's LVLH frame: x radial, y along-track, z along the
+orbit normal. The relative state rho, rho' evolves linearly, and the
+two-impulse transfer from rho1 to rho2 in dt is one 3 x 3 solve:
+
+    rho'1 = Phi_rv^-1 (rho2 - Phi_rr rho1),  rho'2 = Phi_vr rho1 + Phi_vv rho'1
+
+- 'cw': Clohessy-Wiltshire, closed form, for circular targets.
+- 'elliptic': the target's two-body STM (sensitivity.kepler_stm) applied to
+  the inertial offset and rotated into LVLH at both ends. This is the same
+  first-order model the Yamanaka-Ankersen solution writes in closed form,
+  and it is exact to first order for any eccentricity.
+
+rendezvous routes a query automatically. A chaser within close_range
+(relative to the target radius) of the target uses a linear model, CW when
+the target orbit is near circular; anything farther goes to Lambert.
+rendezvous_batch evaluates many times of flight over the chunked worker
+pool.
+"""
+import math
+from batch import DEFAULT_CHUNK_SIZE, make_chunks, imap_chunks
+from sensitivity import cross, dot, kepler, kepler_stm
+
+CLOSE_RANGE = 1e-2     # separation / target radius below which the linear models are used
+CIRCULAR_ECCENTRICITY = 1e-3  # below this the target is treated as circular (CW)
+
+class RelativeTransfer:
+    """
+    Two-impulse rendezvous: inertial burns dv1 and dv2 (km/s), the total,
+    the required LVLH relative velocities after the first burn and before
+    the second (rho_dot1, rho_dot2), and the model used ('cw', 'elliptic'
+    or 'lambert'; the rho_dot fields are None for 'lambert').
+    """
+    def __init__(self, dv1, dv2, rho_dot1, rho_dot2, method):
+        self.dv1 = dv1
+        self.dv2 = dv2
+        self.rho_dot1 = rho_dot1
+        self.rho_dot2 = rho_dot2
+        self.method = method
+
+    @property
+    def dv(self):
+        return math.sqrt(dot(self.dv1, self.dv1)) + math.sqrt(dot(self.dv2, self.dv2))
+
+def lvlh_basis(r, v):
+    """Unit radial, along-track and orbit-normal vectors, and the frame rate |h| / r^2 (rad/s)."""
+    h = cross(r, v)
+    r_norm = math.sqrt(dot(r, r))
+    h_norm = math.sqrt(dot(h, h))
+    radial = [x / r_norm for x in r]
+    normal = [x / h_norm for x in h]
+    return (radial, cross(normal, radial), normal), h_norm / (r_norm * r_norm)
+
+def _to_lvlh(basis, a):
+    return [dot(axis, a) for axis in basis]
+
+def _from_lvlh(basis, rho):
+    return [rho[0] * basis[0][k] + rho[1] * basis[1][k] + rho[2] * basis[2][k] for k in range(3)]
+
+def _rate(omega, rho):
+    # omega x rho for omega = (0, 0, omega) in LVLH components
+    return [-omega * rho[1], omega * rho[0], 0.0]
+
+def to_relative(target_r, target_v, r, v):
+    """LVLH (rho, rho') (km, km/s) of an inertial state relative to the target."""
+    basis, omega = lvlh_basis(target_r, target_v)
+    rho = _to_lvlh(basis, [r[k] - target_r[k] for k in range(3)])
+    rate = _to_lvlh(basis, [v[k] - target_v[k] for k in range(3)])
+    return rho, [a - b for a, b in zip(rate, _rate(omega, rho))]
+
+def from_relative(target_r, target_v, rho, rho_dot):
+    """Inertial (r, v) of an LVLH relative state."""
+    basis, omega = lvlh_basis(target_r, target_v)
+    dr = _from_lvlh(basis, rho)
+    dv = _from_lvlh(basis, [a + b for a, b in zip(rho_dot, _rate(omega, rho))])
+    return [target_r[k] + dr[k] for k in range(3)], [target_v[k] + dv[k] for k in range(3)]
+
+def _apply(m, x):
+    return [m[i][0] * x[0] + m[i][1] * x[1] + m[i][2] * x[2] for i in range(3)]
+
+def _solve3(m, b):
+    # Cramer's rule on the columns of m
+    c1, c2, c3 = ([m[i][j] for i in range(3)] for j in range(3))
+    det = dot(c1, cross(c2, c3))
+    # Relative to the largest column: at a full period two columns vanish
+    # to rounding level, and their own norms would hide that
+    scale = max(dot(c1, c1), dot(c2, c2), dot(c3, c3)) ** 1.5
+    if abs(det) <= 1e-12 * scale:
+        raise ValueError("Phi_rv is singular (time of flight near a multiple of the half period).")
+    return [dot(b, cross(c2, c3)) / det, dot(c1, cross(b, c3)) / det, dot(c1, cross(c2, b)) / det]
+
+def cw_stm(n, t):
+    """Clohessy-Wiltshire blocks (Phi_rr, Phi_rv, Phi_vr, Phi_vv) for mean motion n (rad/s) after t (s)."""
+    c, s = math.cos(n * t), math.sin(n * t)
+    return ([[4 - 3 * c, 0.0, 0.0], [6 * (s - n * t), 1.0, 0.0], [0.0, 0.0, c]],
+            [[s / n, 2 * (1 - c) / n, 0.0], [-2 * (1 - c) / n, (4 * s - 3 * n * t) / n, 0.0], [0.0, 0.0, s / n]],
+            [[3 * n * s, 0.0, 0.0], [-6 * n * (1 - c), 0.0, 0.0], [0.0, 0.0, -n * s]],
+            [[c, 2 * s, 0.0], [-2 * s, 4 * c - 3, 0.0], [0.0, 0.0, c]])
+
+def cw_transfer(n, rho1, rho2, dt):
+    """
+    Clohessy-Wiltshire two-impulse transfer from rho1 to rho2 in dt.
+
+    :return: (rho_dot1, rho_dot2), the relative velocities after departure and before arrival (km/s)
+    :raises ValueError: If n dt is too close to a multiple of 2 pi (or pi out of plane)
+    """
+    rr, rv, vr, vv = cw_stm(n, dt)
+    rho_dot1 = _solve3(rv, [a - b for a, b in zip(rho2, _apply(rr, rho1))])
+    return rho_dot1, [a + b for a, b in zip(_apply(vr, rho1), _apply(vv, rho_dot1))]
+
+def elliptic_transfer(mu, target_r, target_v, rho1, rho2, dt):
+    """
+    Linearized two-impulse transfer about a target on any Keplerian orbit,
+    from rho1 (LVLH at departure) to rho2 (LVLH at dt).
+
+    :return: (rho_dot1, rho_dot2) as for cw_transfer
+    """
+    target_r2, target_v2, phi, _ = kepler_stm(mu, target_r, target_v, dt)
+    basis1, omega1 = lvlh_basis(target_r, target_v)
+    basis2, omega2 = lvlh_basis(target_r2, target_v2)
+    rr = [row[:3] for row in phi[:3]]
+    rv = [row[3:] for row in phi[:3]]
+    dr1 = _from_lvlh(basis1, rho1)
+    dr2 = _from_lvlh(basis2, rho2)
+    dv1 = _solve3(rv, [a - b for a, b in zip(dr2, _apply(rr, dr1))])
+    dv2 = [sum(phi[3 + i][j] * (dr1 + dv1)[j] for j in range(6)) for i in range(3)]
+    rho_dot1 = [a - b for a, b in zip(_to_lvlh(basis1, dv1), _rate(omega1, rho1))]
+    rho_dot2 = [a - b for a, b in zip(_to_lvlh(basis2, dv2), _rate(omega2, rho2))]
+    return rho_dot1, rho_dot2
+
+def _eccentricity(mu, r, v):
+    r_norm = math.sqrt(dot(r, r))
+    v_sq = dot(v, v)
+    rv = dot(r, v)
+    e = [((v_sq - mu / r_norm) * r[k] - rv * v[k]) / mu for k in range(3)]
+    return math.sqrt(dot(e, e))
+
+def rendezvous(solver, target_r, target_v, chaser_r, chaser_v, dt, offset=(0.0, 0.0, 0.0), clockwise=False,
+               close_range=CLOSE_RANGE, method='auto'):
+    """
+    Two-impulse transfer from the chaser state to offset (LVLH, km) from the
+    target after dt, arriving at rest in the target's LVLH frame.
+
+    :param method: 'auto' picks 'cw' or 'elliptic' within close_range and
+                   'lambert' beyond it; or force one of those three
+    :param close_range: Separation / target radius below which 'auto' uses a linear model
+    :return: RelativeTransfer
+    :raises ValueError: If the chosen model has no solution for dt
+    """
+    mu = solver.mu
+    rho1, rate1 = to_relative(target_r, target_v, chaser_r, chaser_v)
+    if method == 'auto':
+        separation = max(math.sqrt(dot(rho1, rho1)), math.sqrt(dot(offset, offset)))
+        if separation > close_range * math.sqrt(dot(target_r, target_r)):
+            method = 'lambert'
+        elif _eccentricity(mu, target_r, target_v) < CIRCULAR_ECCENTRICITY:
+            method = 'cw'
+        else:
+            method = 'elliptic'
+    target_r2, target_v2, _, _, _ = kepler(mu, target_r, target_v, dt)
+    basis1, _ = lvlh_basis(target_r, target_v)
+    basis2, _ = lvlh_basis(target_r2, target_v2)
+    if method == 'lambert':
+        r2, v_final = from_relative(target_r2, target_v2, offset, (0.0, 0.0, 0.0))
+        v1, v2 = solver.solve(chaser_r, r2, dt, clockwise)
+        return RelativeTransfer([v1[k] - chaser_v[k] for k in range(3)], [v_final[k] - v2[k] for k in range(3)],
+                                None, None, method)
+    if method == 'cw':
+        a = 1 / (2 / math.sqrt(dot(target_r, target_r)) - dot(target_v, target_v) / mu)
+        rho_dot1, rho_dot2 = cw_transfer(math.sqrt(mu / a**3), rho1, offset, dt)
+    elif method == 'elliptic':
+        rho_dot1, rho_dot2 = elliptic_transfer(mu, target_r, target_v, rho1, offset, dt)
+    else:
+        raise ValueError(f"Unknown rendezvous method {method!r}")
+    # Both frames rotate with the target, so burns are LVLH velocity changes
+    dv1 = _from_lvlh(basis1, [a - b for a, b in zip(rho_dot1, rate1)])
+    dv2 = _from_lvlh(basis2, [-x for x in rho_dot2])
+    return RelativeTransfer(dv1, dv2, rho_dot1, rho_dot2, method)
+
+def _rendezvous_chunk(solver, target_r, target_v, chaser_r, chaser_v, dts, offset, clockwise, close_range, method):
+    out = []
+    for dt in dts:
+        try:
+            out.append(rendezvous(solver, target_r, target_v, chaser_r, chaser_v, dt, offset, clockwise,
+                                  close_range, method))
+        except (ValueError, ZeroDivisionError, OverflowError):
+            out.append(None)
+    return out
+
+def rendezvous_batch(solver, target_r, target_v, chaser_r, chaser_v, dts, offset=(0.0, 0.0, 0.0), clockwise=False,
+                     close_range=CLOSE_RANGE, method='auto', workers=1, chunk_size=DEFAULT_CHUNK_SIZE,
+                     placement=None):
+    """
+    rendezvous over many times of flight, e.g. to pick the cheapest.
+
+    :return: List of RelativeTransfer, None where dt has no solution
+    """
+    chunks = make_chunks(len(dts), chunk_size)
+    args = ((solver, target_r, target_v, chaser_r, chaser_v, list(dts[start:stop]), offset, clockwise,
+             close_range, method) for start, stop in chunks)
+    out = []
+    for chunk_out in imap_chunks(_rendezvous_chunk, args, workers, placement):
+        out.extend(chunk_out)
+    return out
@@ -0,0 +1,201 @@
+"""
+Escalation ladder for ill-conditioned Lambert problems.
+
+The batch kernel (kernel.solve_lanes) is fast but, like LambertSolver.solve,
+computes A = sin(dnu) * sqrt(r1 r2 / (1 - cos(dnu))) from a clamped cosine and
+runs Newton with a numeric derivative. Near 0 and 180 degrees that loses
+digits or fails outright. Lanes that fail, or whose result has a large
+residual, are retried here:
+
+1. solve_bisection: transfer angle from atan2(|r1 x r2|, r1 . r2), the
+   equivalent form A = +-sqrt(2 r1 r2) cos(dnu / 2), and bisection on z over
+   the zero-revolution branch, which cannot diverge.
+2. solve_extended: the same equations in decimal arithmetic (40 digits by
+   default), with A = +-sqrt(r1 r2 + r1 . r2) and series Stumpff functions,
+   refined from the bisection root.
+
+Only exactly collinear geometries are left unsolved; they need a transfer
+plane (see main.solve_in_plane).
+"""
+import math
+from decimal import Decimal, localcontext
+from main import bisect_z, stumpff_c, stumpff_s, vector_cross, vector_dot, vector_norm
+
+FOUR_PI_SQUARED = 4 * math.pi**2
+
+# Relative conservation residual above which a result goes to the next tier.
+# Well-conditioned LEO-GEO problems stay below 1e-13 in the fast kernel.
+RESIDUAL_TOLERANCE = 1e-10
+
+def conservation_residual(mu, r1, r2, v1, v2):
+    """
+    Relative mismatch of angular momentum and energy between both ends of a
+    transfer. Any Keplerian arc has zero residual; lost digits show up here.
+    Written out per component because the batch engine checks every lane.
+    """
+    ax, ay, az = r1[0], r1[1], r1[2]
+    bx, by, bz = r2[0], r2[1], r2[2]
+    ux, uy, uz = v1[0], v1[1], v1[2]
+    wx, wy, wz = v2[0], v2[1], v2[2]
+    h1x, h1y, h1z = ay * uz - az * uy, az * ux - ax * uz, ax * uy - ay * ux
+    h2x, h2y, h2z = by * wz - bz * wy, bz * wx - bx * wz, bx * wy - by * wx
+    h_norm = math.sqrt(h1x * h1x + h1y * h1y + h1z * h1z)
+    if h_norm == 0:
+        return float('inf')
+    dh = math.sqrt((h1x - h2x)**2 + (h1y - h2y)**2 + (h1z - h2z)**2)
+    potential1 = mu / math.sqrt(ax * ax + ay * ay + az * az)
+    e1 = (ux * ux + uy * uy + uz * uz) / 2 - potential1
+    e2 = (wx * wx + wy * wy + wz * wz) / 2 - mu / math.sqrt(bx * bx + by * by + bz * bz)
+    return max(dh / h_norm, abs(e1 - e2) / max(abs(e1), potential1))
+
+def _geometry(r1, r2, clockwise):
+    r1_norm = vector_norm(r1)
+    r2_norm = vector_norm(r2)
+    cross = vector_cross(r1, r2)
+    dnu = math.atan2(vector_norm(cross), vector_dot(r1, r2))
+    long_way = (not clockwise and cross[2] < 0) or (clockwise and cross[2] >= 0)
+    A = math.sqrt(2 * r1_norm * r2_norm) * math.cos(dnu / 2)
+    if long_way:
+        A = -A
+    if vector_norm(cross) == 0 or A == 0:
+        raise ValueError("Position vectors are collinear; the transfer plane is undefined.")
+    return r1_norm, r2_norm, A, long_way
+
+def _velocities(r1, r2, f, g, gdot):
+    v1 = [(r2[i] - f * r1[i]) / g for i in range(3)]
+    v2 = [(gdot * r2[i] - r1[i]) / g for i in range(3)]
+    return v1, v2
+
+def solve_bisection(mu, r1, r2, dt, clockwise=False, max_iterations=200):
+    """
+    Second tier: well-conditioned geometry and bisection on z.
+
+    :return: (v1, v2, z)
+    """
+    r1_norm, r2_norm, A, _ = _geometry(r1, r2, clockwise)
+    z = bisect_z(mu, r1_norm, r2_norm, A, dt, max_iterations)
+    y = r1_norm + r2_norm + A * (z * stumpff_s(z) - 1) / math.sqrt(stumpff_c(z))
+    f = 1 - y / r1_norm
+    g = A * math.sqrt(y / mu)
+    gdot = 1 - y / r2_norm
+    if g == 0:
+        raise ValueError("g is zero; the transfer plane is undefined.")
+    v1, v2 = _velocities(r1, r2, f, g, gdot)
+    return v1, v2, z
+
+def _stumpff_series(z, eps):
+    # C(z) = sum (-z)^k / (2k + 2)!, S(z) = sum (-z)^k / (2k + 3)!
+    C = S = Decimal(0)
+    term = Decimal(1) / 2
+    k = 0
+    while True:
+        C += term
+        s_term = term / (2 * k + 3)
+        S += s_term
+        term = term * -z / ((2 * k + 3) * (2 * k + 4))
+        k += 1
+        if k > 3 and abs(term) <= eps * abs(C) and abs(s_term) <= eps * abs(S):
+            return C, S
+
+def solve_extended(mu, r1, r2, dt, clockwise=False, z_guess=None, precision=40, max_iterations=200):
+    """
+    Third tier: the universal-variable equations in decimal arithmetic.
+
+    :param z_guess: Starting z, e.g. from solve_bisection
+    :param precision: Decimal digits
+    :return: (v1, v2) as floats
+    """
+    _, _, _, long_way = _geometry(r1, r2, clockwise)
+    if z_guess is None:
+        r1_norm, r2_norm, A, _ = _geometry(r1, r2, clockwise)
+        z_guess = bisect_z(mu, r1_norm, r2_norm, A, dt)
+    with localcontext() as ctx:
+        ctx.prec = precision
+        eps = Decimal(10) ** (-precision + 2)
+        R1 = [Decimal(x) for x in r1]
+        R2 = [Decimal(x) for x in r2]
+        Mu = Decimal(mu)
+        Dt = Decimal(dt)
+        r1_norm = sum(x * x for x in R1).sqrt()
+        r2_norm = sum(x * x for x in R2).sqrt()
+        # r1 r2 (1 + cos dnu) without forming the cosine
+        A = (r1_norm * r2_norm + sum(a * b for a, b in zip(R1, R2))).sqrt()
+        if long_way:
+            A = -A
+        if A == 0:
+            raise ValueError("Position vectors are collinear; the transfer plane is undefined.")
+
+        def y_of(z):
+            C, S = _stumpff_series(z, eps)
+            return r1_norm + r2_norm + A * (z * S - 1) / C.sqrt(), C, S
+
+        def residual(z):
+            y, C, S = y_of(z)
+            if y < 0:
+                return -Dt
+            chi = (y / C).sqrt()
+            return (chi**3 * S + A * y.sqrt()) / Mu.sqrt() - Dt
+
+        # Expand a bracket around the guess, then Illinois regula falsi.
+        z0 = Decimal(z_guess)
+        step = Decimal(1e-6) * max(Decimal(1), abs(z0))
+        lo, hi = z0 - step, z0 + step
+        f_lo, f_hi = residual(lo), residual(hi)
+        for _ in range(60):
+            if f_lo <= 0 <= f_hi:
+                break
+            step *= 2
+            if f_lo > 0:
+                lo = z0 - step
+                f_lo = residual(lo)
+            if f_hi < 0:
+                hi = min(z0 + step, Decimal(FOUR_PI_SQUARED) - eps)
+                f_hi = residual(hi)
+        else:
+            raise ValueError("No bracket for the extended-precision solve")
+        side = 0
+        z = lo
+        for _ in range(max_iterations):
+            z = (lo * f_hi - hi * f_lo) / (f_hi - f_lo)
+            f_z = residual(z)
+            if abs(f_z) <= eps * Dt or hi - lo <= eps * max(Decimal(1), abs(z)):
+                break
+            if (f_z < 0) == (f_lo < 0):
+                lo, f_lo = z, f_z
+                if side == -1:
+                    f_hi /= 2
+                side = -1
+            else:
+                hi, f_hi = z, f_z
+                if side == 1:
+                    f_lo /= 2
+                side = 1
+        y, _, _ = y_of(z)
+        f = 1 - y / r1_norm
+        g = A * (y / Mu).sqrt()
+        gdot = 1 - y / r2_norm
+        if g == 0:
+            raise ValueError("g is zero; the transfer plane is undefined.")
+        v1, v2 = _velocities(R1, R2, f, g, gdot)
+        return [float(x) for x in v1], [float(x) for x in v2]
+
+def escalate(mu, r1, r2, dt, clockwise=False, residual_tolerance=RESIDUAL_TOLERANCE):
+    """
+    Run the second and, if needed, the third tier for one problem. Both
+    tiers are held to residual_tolerance.
+
+    :return: (v1, v2, tier) with tier 2 or 3, or None if both tiers fail
+    """
+    try:
+        v1, v2, z = solve_bisection(mu, r1, r2, dt, clockwise)
+    except (ValueError, ZeroDivisionError, OverflowError):
+        return None
+    if conservation_residual(mu, r1, r2, v1, v2) <= residual_tolerance:
+        return v1, v2, 2
+    try:
+        v1, v2 = solve_extended(mu, r1, r2, dt, clockwise, z_guess=z)
+    except (ValueError, ZeroDivisionError, OverflowError, ArithmeticError):
+        return None
+    if conservation_residual(mu, r1, r2, v1, v2) > residual_tolerance:
+        return None
+    return v1, v2, 3
@@ -0,0 +1,274 @@
+"""
+Analytic Lambert partials by forward-mode dual numbers.
+
+A Dual carries a value and its derivative along one input direction. The
+universal-variable equations are evaluated on duals, and the converged z is
+differentiated implicitly: tof(z, p) = dt(p) gives
+dz/dp = -(dtof/dp - ddt/dp) / (dtof/dz). Both partial derivatives of the time of
+flight come from dual evaluations at the converged z, so no finite differences
+and no re-solves are needed.
+
+    v1, v2, dv1, dv2, z = lambert_partials(mu, r1, r2, dt, dr2=direction)
+
+gives the velocities and their derivatives when r2 moves along direction
+(dr1 and ddt work the same way). kepler does the same for two-body
+propagation, differentiating the universal anomaly through the Kepler
+equation, and kepler_stm stacks six directions into the state transition
+matrix.
+"""
+import math
+from kernel import universal_anomaly
+from main import bisect_z
+
+class Dual:
+    """Value a and derivative b of a quantity along one input direction."""
+    __slots__ = ('a', 'b')
+
+    def __init__(self, a, b=0.0):
+        self.a = a
+        self.b = b
+
+    def __add__(self, other):
+        if isinstance(other, Dual):
+            return Dual(self.a + other.a, self.b + other.b)
+        return Dual(self.a + other, self.b)
+
+    __radd__ = __add__
+
+    def __sub__(self, other):
+        if isinstance(other, Dual):
+            return Dual(self.a - other.a, self.b - other.b)
+        return Dual(self.a - other, self.b)
+
+    def __rsub__(self, other):
+        return Dual(other - self.a, -self.b)
+
+    def __mul__(self, other):
+        if isinstance(other, Dual):
+            return Dual(self.a * other.a, self.a * other.b + self.b * other.a)
+        return Dual(self.a * other, self.b * other)
+
+    __rmul__ = __mul__
+
+    def __truediv__(self, other):
+        if isinstance(other, Dual):
+            return Dual(self.a / other.a, (self.b * other.a - self.a * other.b) / (other.a * other.a))
+        return Dual(self.a / other, self.b / other)
+
+    def __rtruediv__(self, other):
+        return Dual(other / self.a, -other * self.b / (self.a * self.a))
+
+    def __neg__(self):
+        return Dual(-self.a, -self.b)
+
+    def __pow__(self, n):
+        return Dual(self.a**n, n * self.a**(n - 1) * self.b)
+
+    def __repr__(self):
+        return f"Dual({self.a!r}, {self.b!r})"
+
+def value(x):
+    return x.a if isinstance(x, Dual) else x
+
+def derivative(x):
+    return x.b if isinstance(x, Dual) else 0.0
+
+def _lift(x, f, df):
+    # f(x) for floats, f(a) + f'(a) b eps for duals
+    if isinstance(x, Dual):
+        return Dual(f(x.a), df(x.a) * x.b)
+    return f(x)
+
+def sqrt(x):
+    return _lift(x, math.sqrt, lambda a: 0.5 / math.sqrt(a))
+
+def sin(x):
+    return _lift(x, math.sin, math.cos)
+
+def cos(x):
+    return _lift(x, math.cos, lambda a: -math.sin(a))
+
+def sinh(x):
+    return _lift(x, math.sinh, math.cosh)
+
+def cosh(x):
+    return _lift(x, math.cosh, math.sinh)
+
+def asin(x):
+    return _lift(x, math.asin, lambda a: 1 / math.sqrt(1 - a * a))
+
+def atan2(y, x):
+    if not isinstance(y, Dual) and not isinstance(x, Dual):
+        return math.atan2(y, x)
+    ya, xa = value(y), value(x)
+    return Dual(math.atan2(ya, xa), (xa * derivative(y) - ya * derivative(x)) / (xa * xa + ya * ya))
+
+def dot(u, v):
+    return u[0] * v[0] + u[1] * v[1] + u[2] * v[2]
+
+def cross(u, v):
+    return [u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0]]
+
+def norm(u):
+    return sqrt(dot(u, u))
+
+def lift_vector(u, du=None):
+    """Vector of duals with values u and derivatives du (zero if None)."""
+    if du is None:
+        return [Dual(x, 0.0) for x in u]
+    return [Dual(x, d) for x, d in zip(u, du)]
+
+# Below this |z| the Stumpff functions use their series; the closed forms lose
+# digits there and are 0/0 at z = 0, which the derivative cannot tolerate.
+SERIES_Z = 0.1
+
+def stumpff(z):
+    """
+    Stumpff functions (C(z), S(z)) for a float or a Dual z.
+    """
+    za = value(z)
+    if abs(za) < SERIES_Z:
+        # C = sum (-z)^k / (2k + 2)!, S = sum (-z)^k / (2k + 3)!, by Horner
+        C = 1 / math.factorial(18)
+        S = 1 / math.factorial(19)
+        for k in range(7, -1, -1):
+            C = 1 / math.factorial(2 * k + 2) - z * C
+            S = 1 / math.factorial(2 * k + 3) - z * S
+        return C, S
+    if za > 0:
+        sz = sqrt(z)
+        return (1 - cos(sz)) / z, (sz - sin(sz)) / sz**3
+    sz = sqrt(-z)
+    return (cosh(sz) - 1) / -z, (sinh(sz) - sz) / sz**3
+
+def time_of_flight(z, r1_norm, r2_norm, A, mu):
+    """
+    Universal-variable time of flight and y for float or Dual arguments.
+
+    :return: (tof, y)
+    """
+    C, S = stumpff(z)
+    y = r1_norm + r2_norm + A * (z * S - 1) / sqrt(C)
+    chi = sqrt(y / C)
+    return (chi**3 * S + A * sqrt(y)) / math.sqrt(mu), y
+
+def solve_z(mu, r1_norm, r2_norm, A, dt, z=None, tolerance=1e-13, max_iterations=30):
+    """
+    Zero-revolution z for tof(z) = dt: Newton with the exact dual derivative
+    from a warm start z, falling back to main.bisect_z if a step leaves the
+    branch or the iteration stalls.
+    """
+    if z is not None:
+        try:
+            for _ in range(max_iterations):
+                tof, y = time_of_flight(Dual(z, 1.0), r1_norm, r2_norm, A, mu)
+                if y.a < 0 or tof.b <= 0:
+                    break
+                step = (tof.a - dt) / tof.b
+                z -= step
+                if not z < 4 * math.pi**2:
+                    break
+                if abs(step) <= tolerance * max(1.0, abs(z)):
+                    return z
+        except (ValueError, ZeroDivisionError, OverflowError):
+            pass
+    return bisect_z(mu, r1_norm, r2_norm, A, dt)
+
+def _geometry(r1, r2, clockwise, normal):
+    # A = +-sqrt(r1 r2 + r1 . r2), i.e. +-sqrt(2 r1 r2) cos(dnu / 2), with the
+    # long way chosen as in LambertSolver (about normal instead of +z if given)
+    r1_norm = norm(r1)
+    r2_norm = norm(r2)
+    c = cross([value(x) for x in r1], [value(x) for x in r2])
+    turn = c[2] if normal is None else dot(c, normal)
+    long_way = (not clockwise and turn < 0) or (clockwise and turn >= 0)
+    A = sqrt(r1_norm * r2_norm + dot(r1, r2))
+    if long_way:
+        A = -A
+    return r1_norm, r2_norm, A
+
+def lambert_partials(mu, r1, r2, dt, clockwise=False, dr1=None, dr2=None, ddt=0.0, z=None, normal=None):
+    """
+    Zero-revolution Lambert solution and its derivatives along one input
+    direction (dr1, dr2, ddt).
+
+    :param z: Optional warm start for z, e.g. from a neighbouring solution
+    :param normal: Direction sense reference (default +z, as in LambertSolver)
+    :return: (v1, v2, dv1, dv2, z) with dv1, dv2 the derivatives of v1 and v2
+    """
+    r1_norm, r2_norm, A = _geometry(r1, r2, clockwise, normal)
+    if A == 0:
+        raise ValueError("Position vectors are collinear; the transfer plane is undefined.")
+    z = solve_z(mu, r1_norm, r2_norm, A, dt, z)
+
+    R1 = lift_vector(r1, dr1)
+    R2 = lift_vector(r2, dr2)
+    R1_norm, R2_norm, A_dual = _geometry(R1, R2, clockwise, normal)
+    tof_z, _ = time_of_flight(Dual(z, 1.0), r1_norm, r2_norm, A, mu)
+    tof_p, _ = time_of_flight(Dual(z, 0.0), R1_norm, R2_norm, A_dual, mu)
+    dz = -(tof_p.b - ddt) / tof_z.b
+
+    _, y = time_of_flight(Dual(z, dz), R1_norm, R2_norm, A_dual, mu)
+    f = 1 - y / R1_norm
+    g = A_dual * sqrt(y / mu)
+    gdot = 1 - y / R2_norm
+    if abs(g.a) == 0:
+        raise ValueError("g is zero; the transfer plane is undefined.")
+    V1 = [(R2[i] - f * R1[i]) / g for i in range(3)]
+    V2 = [(gdot * R2[i] - R1[i]) / g for i in range(3)]
+    return [v.a for v in V1], [v.a for v in V2], [v.b for v in V1], [v.b for v in V2], z
+
+def _kepler_state(chi, r0, v0, dt, mu):
+    # Universal Kepler equation residual and the propagated state by
+    # Lagrange f and g, for float or Dual arguments
+    sqrt_mu = math.sqrt(mu)
+    r0_norm = norm(r0)
+    alpha = 2 / r0_norm - dot(v0, v0) / mu
+    chi2 = chi * chi
+    psi = alpha * chi2
+    C, S = stumpff(psi)
+    F = dot(r0, v0) / sqrt_mu * chi2 * C + (1 - alpha * r0_norm) * chi2 * chi * S + r0_norm * chi - sqrt_mu * dt
+    f = 1 - chi2 / r0_norm * C
+    g = dt - chi2 * chi / sqrt_mu * S
+    r = [f * r0[k] + g * v0[k] for k in range(3)]
+    r_norm = norm(r)
+    fdot = sqrt_mu / (r_norm * r0_norm) * chi * (psi * S - 1)
+    gdot = 1 - chi2 / r_norm * C
+    return F, r, [fdot * r0[k] + gdot * v0[k] for k in range(3)]
+
+def kepler(mu, r0, v0, dt, dr0=None, dv0=None, ddt=0.0, chi=None):
+    """
+    Two-body state at dt > 0 after (r0, v0) and its derivatives along one
+    input direction (dr0, dv0, ddt).
+
+    :param chi: Optional starting universal anomaly, e.g. from a nearby time
+    :return: (r, v, dr, dv, chi)
+    """
+    r0_norm = math.sqrt(dot(r0, r0))
+    alpha = 2 / r0_norm - dot(v0, v0) / mu
+    sqrt_mu = math.sqrt(mu)
+    if chi is None:
+        chi = sqrt_mu * abs(alpha) * dt
+    chi = universal_anomaly(r0_norm, dot(r0, v0) / r0_norm, alpha, sqrt_mu, dt, chi)
+
+    R0 = lift_vector(r0, dr0)
+    V0 = lift_vector(v0, dv0)
+    T = Dual(dt, ddt)
+    F_chi, _, _ = _kepler_state(Dual(chi, 1.0), r0, v0, dt, mu)
+    F_p, _, _ = _kepler_state(Dual(chi, 0.0), R0, V0, T, mu)
+    _, R, V = _kepler_state(Dual(chi, -F_p.b / F_chi.b), R0, V0, T, mu)
+    return [x.a for x in R], [x.a for x in V], [x.b for x in R], [x.b for x in V], chi
+
+def kepler_stm(mu, r0, v0, dt, chi=None):
+    """
+    Two-body state at dt > 0 and the 6 x 6 state transition matrix
+    phi[i][j] = d(r, v)_i / d(r0, v0)_j.
+
+    :return: (r, v, phi, chi)
+    """
+    columns = []
+    for j in range(6):
+        direction = [1.0 if k == j else 0.0 for k in range(6)]
+        r, v, dr, dv, chi = kepler(mu, r0, v0, dt, direction[:3], direction[3:], chi=chi)
+        columns.append(dr + dv)
+    return r, v, [[columns[j][i] for j in range(6)] for i in range(6)], chi
@@ -0,0 +1,308 @@
+"""
+Sharded sweep driver.
+
+A job directory holds a manifest.json describing the work and how it is split
+into shards. Any number of worker processes, on one or several hosts sharing
+the directory, run `python shard.py work <dir>`. Workers claim shards through
+lock files, write each shard result atomically and skip shards that are
+already done, so a crashed or killed run resumes where it stopped.
+
+Layout:
+    <dir>/manifest.json
+    <dir>/locks/<shard>.lock
+    <dir>/results/<shard>.json
+"""
+import json
+import os
+import socket
+import sys
+import time
+from batch import BatchResult, _solve_chunk, make_chunks, merge_best, merge_histograms
+from ephemeris import CircularOrbit
+from sweep import SweepResult, _sweep_chunk
+
+MANIFEST = 'manifest.json'
+DEFAULT_LEASE = 600.0  # s without heartbeat before a lock is considered stale
+
+def _write_atomic(path, data):
+    """Write JSON to a temporary file in the same directory, then rename over path."""
+    tmp = f"{path}.tmp.{socket.gethostname()}.{os.getpid()}"
+    with open(tmp, 'w') as f:
+        json.dump(data, f)
+        f.flush()
+        os.fsync(f.fileno())
+    os.replace(tmp, path)
+
+def _body_to_dict(body):
+    return {'radius': body.radius, 'mu': body.mu, 'phase': body.phase,
+            'inclination': body.inclination}
+
+def _body_from_dict(d):
+    return CircularOrbit(d['radius'], d['mu'], d['phase'], d['inclination'])
+
+def _create(directory, manifest):
+    os.makedirs(os.path.join(directory, 'locks'), exist_ok=True)
+    os.makedirs(os.path.join(directory, 'results'), exist_ok=True)
+    path = os.path.join(directory, MANIFEST)
+    if os.path.exists(path):
+        raise ValueError(f"Manifest already exists: {path}")
+    _write_atomic(path, manifest)
+    return manifest
+
+def create_grid_job(directory, mu, departure_body, arrival_body, departure_times, tofs,
+                    clockwise=False, shard_size=4096, chunk_size=256, edges=None, cutoff=None,
+                    max_iterations=1000, tolerance=1e-8):
+    """
+    Describe a porkchop sweep split into shards of shard_size cells.
+    Cells whose Δv lower bound exceeds cutoff are skipped (see sweep.porkchop_sweep).
+    max_iterations and tolerance are stored for the workers' solves.
+
+    :param departure_body: ephemeris.CircularOrbit
+    :param arrival_body: ephemeris.CircularOrbit
+    """
+    if edges is None:
+        edges = [0.0, 1.0, 2.0, 5.0, 10.0, 20.0, float('inf')]
+    cells = len(departure_times) * len(tofs)
+    return _create(directory, {
+        'kind': 'grid',
+        'mu': mu,
+        'departure_body': _body_to_dict(departure_body),
+        'arrival_body': _body_to_dict(arrival_body),
+        'departure_times': list(departure_times),
+        'tofs': list(tofs),
+        'clockwise': clockwise,
+        'chunk_size': chunk_size,
+        'edges': edges,
+        'cutoff': cutoff,
+        'max_iterations': max_iterations,
+        'tolerance': tolerance,
+        'shards': make_chunks(cells, shard_size),
+    })
+
+def create_catalog_job(directory, mu, problems, shard_size=4096, chunk_size=256, max_iterations=1000,
+                       tolerance=1e-8):
+    """
+    Describe a batch of (r1, r2, dt[, clockwise]) problems split into shards,
+    solved with the given max_iterations and tolerance.
+    """
+    problems = [list(p) + [False] if len(p) == 3 else list(p) for p in problems]
+    return _create(directory, {
+        'kind': 'catalog',
+        'mu': mu,
+        'problems': problems,
+        'chunk_size': chunk_size,
+        'max_iterations': max_iterations,
+        'tolerance': tolerance,
+        'shards': make_chunks(len(problems), shard_size),
+    })
+
+def load_manifest(directory):
+    with open(os.path.join(directory, MANIFEST)) as f:
+        return json.load(f)
+
+def _shard_name(index):
+    return f"{index:06d}"
+
+def _result_path(directory, index):
+    return os.path.join(directory, 'results', _shard_name(index) + '.json')
+
+def _lock_path(directory, index):
+    return os.path.join(directory, 'locks', _shard_name(index) + '.lock')
+
+def _owner():
+    return f"{socket.gethostname()}:{os.getpid()}"
+
+def _read_lock(path):
+    """(owner, mtime) of a lock file, or None if it is gone."""
+    try:
+        mtime = os.path.getmtime(path)
+        with open(path) as f:
+            return f.read(), mtime
+    except FileNotFoundError:
+        return None
+
+def _try_claim(directory, index, lease):
+    """
+    Claim a shard by creating its lock file exclusively. A lock whose
+    heartbeat is older than lease is broken by renaming it away first.
+    """
+    path = _lock_path(directory, index)
+    owner = _owner()
+    for _ in range(2):
+        try:
+            fd = os.open(path, os.O_CREAT | os.O_EXCL | os.O_WRONLY)
+        except FileExistsError:
+            seen = _read_lock(path)
+            if seen is None:
+                continue
+            if time.time() - seen[1] < lease:
+                return False
+            stale = f"{path}.stale.{owner.replace(':', '.')}"
+            try:
+                # Only one worker wins the rename, so a stale lock is broken once.
+                os.rename(path, stale)
+            except FileNotFoundError:
+                return False
+            if _read_lock(stale) != seen:
+                # Another worker broke the stale lock and claimed the shard
+                # between our check and the rename: we took its fresh lock.
+                # Put it back unless a newer lock has appeared, and back off.
+                try:
+                    os.link(stale, path)
+                except FileExistsError:
+                    pass
+                os.remove(stale)
+                return False
+            os.remove(stale)
+            continue
+        with os.fdopen(fd, 'w') as f:
+            f.write(owner)
+        return True
+    return False
+
+def _heartbeat(directory, index):
+    # Only refresh our own lock, as in _release: touching a lock another
+    # worker took after ours was broken would keep its lease alive for us.
+    path = _lock_path(directory, index)
+    lock = _read_lock(path)
+    if lock is not None and lock[0] == _owner():
+        try:
+            os.utime(path)
+        except FileNotFoundError:
+            pass
+
+def _release(directory, index):
+    # Only remove our own lock; if ours was broken as stale, the file may
+    # now belong to the worker that claimed the shard after us.
+    path = _lock_path(directory, index)
+    lock = _read_lock(path)
+    if lock is not None and lock[0] == _owner():
+        try:
+            os.remove(path)
+        except FileNotFoundError:
+            pass
+
+def _run_shard(directory, manifest, index):
+    start, stop = manifest['shards'][index]
+    chunk_size = manifest['chunk_size']
+    # Manifests written before the solver settings were stored use the defaults.
+    max_iterations = manifest.get('max_iterations', 1000)
+    tolerance = manifest.get('tolerance', 1e-8)
+    out = {'start': start, 'stop': stop}
+    if manifest['kind'] == 'grid':
+        departure = _body_from_dict(manifest['departure_body'])
+        arrival = _body_from_dict(manifest['arrival_body'])
+        out.update({'dv': [], 'best': [], 'failures': 0, 'skipped': 0, 'skipped_hyperbolic': 0,
+                    'skipped_chunks': 0, 'histograms': []})
+        for lo in range(start, stop, chunk_size):
+            hi = min(lo + chunk_size, stop)
+            dvs, best, stats, hist = _sweep_chunk(
+                manifest['mu'], departure, arrival, manifest['departure_times'],
+                manifest['tofs'], lo, hi, manifest['clockwise'], manifest['edges'],
+                cutoff=manifest.get('cutoff'), max_iterations=max_iterations, tolerance=tolerance)
+            out['dv'].extend(dvs)
+            out['best'].append(best)
+            out['failures'] += stats[0]
+            out['skipped'] += stats[1]
+            out['skipped_hyperbolic'] += stats[2]
+            out['skipped_chunks'] += stats[1] == hi - lo
+            out['histograms'].append(hist)
+            _heartbeat(directory, index)
+    else:
+        out.update({'v1': [], 'v2': [], 'errors': []})
+        problems = manifest['problems']
+        for lo in range(start, stop, chunk_size):
+            hi = min(lo + chunk_size, stop)
+            for v1, v2, error in _solve_chunk(manifest['mu'], problems[lo:hi], max_iterations, tolerance):
+                out['v1'].append(v1)
+                out['v2'].append(v2)
+                out['errors'].append(error)
+            _heartbeat(directory, index)
+    return out
+
+def work(directory, lease=DEFAULT_LEASE, max_shards=None):
+    """
+    Process unclaimed shards until none are left.
+
+    :param lease: Seconds without heartbeat after which another worker's lock is broken
+    :param max_shards: Stop after this many shards (None for no limit)
+    :return: Number of shards completed by this worker
+    """
+    manifest = load_manifest(directory)
+    done = 0
+    for index in range(len(manifest['shards'])):
+        if max_shards is not None and done >= max_shards:
+            break
+        if os.path.exists(_result_path(directory, index)):
+            continue
+        if not _try_claim(directory, index, lease):
+            continue
+        try:
+            # Another worker may have finished it between our check and claim.
+            if not os.path.exists(_result_path(directory, index)):
+                _write_atomic(_result_path(directory, index), _run_shard(directory, manifest, index))
+                done += 1
+        finally:
+            _release(directory, index)
+    return done
+
+def status(directory):
+    """:return: (completed, locked, total) shard counts"""
+    manifest = load_manifest(directory)
+    total = len(manifest['shards'])
+    completed = sum(1 for i in range(total) if os.path.exists(_result_path(directory, i)))
+    locked = sum(1 for i in range(total) if os.path.exists(_lock_path(directory, i)))
+    return completed, locked, total
+
+def collect(directory):
+    """
+    Merge shard results in shard order.
+
+    :return: SweepResult for grid jobs, BatchResult for catalog jobs
+    """
+    manifest = load_manifest(directory)
+    shards = []
+    for index in range(len(manifest['shards'])):
+        path = _result_path(directory, index)
+        if not os.path.exists(path):
+            raise ValueError(f"Shard {index} has no result yet")
+        with open(path) as f:
+            shards.append(json.load(f))
+    if manifest['kind'] == 'grid':
+        result = SweepResult(manifest['departure_times'], manifest['tofs'])
+        n_tof = len(manifest['tofs'])
+        partials = []
+        hists = []
+        for shard in shards:
+            for k, dv in enumerate(shard['dv']):
+                cell = shard['start'] + k
+                result.dv[cell // n_tof][cell % n_tof] = dv
+            partials.extend(tuple(b) for b in shard['best'])
+            hists.extend(shard['histograms'])
+            result.failures += shard['failures']
+            result.skipped += shard.get('skipped', 0)
+            result.skipped_hyperbolic += shard.get('skipped_hyperbolic', 0)
+            result.skipped_chunks += shard.get('skipped_chunks', 0)
+        index, value = merge_best(partials)
+        if index is not None:
+            result.best = ((index // n_tof, index % n_tof), value)
+        result.histogram = merge_histograms(hists)
+        result.edges = manifest['edges']
+        return result
+    result = BatchResult(len(manifest['problems']))
+    for shard in shards:
+        for k in range(shard['stop'] - shard['start']):
+            result.v1[shard['start'] + k] = shard['v1'][k]
+            result.v2[shard['start'] + k] = shard['v2'][k]
+            result.errors[shard['start'] + k] = shard['errors'][k]
+    return result
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3 or sys.argv[1] not in ('work', 'status'):
+        print("Usage: python shard.py work|status <job directory>")
+        sys.exit(1)
+    if sys.argv[1] == 'work':
+        print(f"Completed {work(sys.argv[2])} shards")
+    else:
+        completed, locked, total = status(sys.argv[2])
+        print(f"{completed}/{total} shards done, {locked} in progress")
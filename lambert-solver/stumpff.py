@@ -0,0 +1,29 @@
+"""
+Stumpff functions and the parabolic time of flight, shared by the scalar
+solver (main.py) and the lane kernel (kernel.py).
+"""
+import math
+
+def stumpff_c(z):
+    if z > 0:
+        sz = math.sqrt(z)
+        return (1 - math.cos(sz)) / z
+    elif z < 0:
+        sz = math.sqrt(-z)
+        return (1 - math.cosh(sz)) / z
+    else:
+        return 0.5
+
+def stumpff_s(z):
+    if z > 0:
+        sz = math.sqrt(z)
+        return (sz - math.sin(sz)) / (sz**3)
+    elif z < 0:
+        sz = math.sqrt(-z)
+        return (math.sinh(sz) - sz) / (sz**3)
+    else:
+        return 1/6
+
+def parabolic_time(s, c, mu, long_way=False):
+    """Calculate parabolic transfer time from the semiperimeter s and chord c."""
+    return math.sqrt(2 / mu) / 3 * (s**1.5 + (1.0 if long_way else -1.0) * max(s - c, 0.0)**1.5)
@@ -0,0 +1,204 @@
+import math
+from main import vector_norm, vector_subtract, vector_dot, vector_cross, parabolic_time
+from backends import batch_policy
+from kernel import METRIC_FIELDS
+from batch import DEFAULT_CHUNK_SIZE, _solve_chunk, make_chunks, imap_chunks, best_index, merge_best, histogram, merge_histograms
+
+DV = METRIC_FIELDS.index('dv')
+
+def dv_lower_bound(mu, r1, vb1, r2, vb2, tof, clockwise=False):
+    """
+    Cheap lower bound on the total Δv of a transfer, valid without solving.
+
+    Every conic through r1 and r2 has at least the minimum energy -mu/s, and a
+    transfer faster than the parabola is hyperbolic (energy > 0); this bounds
+    the transfer speeds at both ends. The transfer velocities lie in the plane
+    of r1 and r2, so the body velocity components normal to that plane must be
+    cancelled in full.
+
+    :return: (bound, hyperbolic) with bound in km/s and hyperbolic True when
+             tof is below the parabolic time of flight
+    """
+    r1_norm = vector_norm(r1)
+    r2_norm = vector_norm(r2)
+    c = vector_norm(vector_subtract(r2, r1))
+    s = (r1_norm + r2_norm + c) / 2
+    normal = vector_cross(r1, r2)
+    long_way = (not clockwise and normal[2] < 0) or (clockwise and normal[2] >= 0)
+    hyperbolic = tof < parabolic_time(s, c, mu, long_way)
+    energy = 0.0 if hyperbolic else -mu / s
+    normal_norm = vector_norm(normal)
+    planar = normal_norm > 1e-12 * r1_norm * r2_norm
+    bound = 0.0
+    for r_norm, vb in ((r1_norm, vb1), (r2_norm, vb2)):
+        v_min = math.sqrt(max(2 * (energy + mu / r_norm), 0.0))
+        vb_norm = vector_norm(vb)
+        if planar:
+            out_of_plane = vector_dot(vb, normal) / normal_norm
+            in_plane = math.sqrt(max(vb_norm**2 - out_of_plane**2, 0.0))
+        else:
+            out_of_plane = 0.0
+            in_plane = vb_norm
+        bound += math.sqrt(out_of_plane**2 + max(v_min - in_plane, 0.0)**2)
+    return bound, hyperbolic
+
+def _collinear_plane(r1, vb1, r2):
+    """Departure orbit normal if r1 and r2 are collinear, else None."""
+    if vector_norm(vector_cross(r1, r2)) > 1e-8 * vector_norm(r1) * vector_norm(r2):
+        return None
+    return vector_cross(r1, vb1)
+
+# Cells are bounded and solved in groups of this size inside a chunk, so a
+# top-k heap filled by one group tightens the cutoff for the next.
+SOLVE_GROUP = 32
+
+def _sweep_chunk(mu, departure_body, arrival_body, departure_times, tofs, start, stop,
+                 clockwise, edges, select=None, cutoff=None, policy=None, check=None,
+                 max_iterations=1000, tolerance=1e-8):
+    n_tof = len(tofs)
+    dvs = []
+    selected = []
+    failures = 0
+    skipped = 0
+    skipped_hyperbolic = 0
+    # Cells whose bound exceeds the user cutoff, the selection threshold or,
+    # once this chunk's top-k heap is full, the worst kept Δv, cannot matter.
+    limit = cutoff
+    if select is not None and select.threshold is not None:
+        limit = select.threshold if limit is None else min(limit, select.threshold)
+    use_bounds = limit is not None or (select is not None and select.top_k is not None)
+    for group_start in range(start, stop, SOLVE_GROUP):
+        group_limit = limit
+        if select is not None and select.top_k is not None and len(selected) == select.top_k:
+            worst = -selected[0][0]
+            group_limit = worst if group_limit is None else min(group_limit, worst)
+        cells = []
+        states = []
+        for cell in range(group_start, min(group_start + SOLVE_GROUP, stop)):
+            t0 = departure_times[cell // n_tof]
+            tof = tofs[cell % n_tof]
+            r1, vb1 = departure_body.state(t0)
+            r2, vb2 = arrival_body.state(t0 + tof)
+            if use_bounds and group_limit is not None:
+                bound, hyperbolic = dv_lower_bound(mu, r1, vb1, r2, vb2, tof, clockwise)
+                if bound > group_limit:
+                    skipped += 1
+                    skipped_hyperbolic += hyperbolic
+                    continue
+            cells.append(cell)
+            states.append((r1, vb1, r2, vb2, tof))
+        # Survivors go through the bucketed batch kernel together. Collinear
+        # cells are solved in the departure body's orbit plane.
+        problems = [(r1, r2, tof, clockwise, _collinear_plane(r1, vb1, r2)) for r1, vb1, r2, _, tof in states]
+        velocities = [(vb1, vb2) for _, vb1, _, vb2, _ in states]
+        group_dvs = {}
+        for cell, (_, _, error, metrics) in zip(
+                cells, _solve_chunk(mu, problems, max_iterations, tolerance, policy=policy, velocities=velocities,
+                                    metrics=True, check=check)):
+            if error is None:
+                dv = metrics[DV]
+            else:
+                dv = None
+                failures += 1
+            if select is not None:
+                select.push(selected, cell, dv)
+            group_dvs[cell] = dv
+        for cell in range(group_start, min(group_start + SOLVE_GROUP, stop)):
+            dvs.append(group_dvs.get(cell))
+    index, value = best_index(dvs)
+    best = (None if index is None else start + index, value)
+    hist = histogram(dvs, edges)
+    stats = (failures, skipped, skipped_hyperbolic)
+    if select is not None:
+        # Only the selection leaves the worker; the chunk's Δv values are dropped.
+        return selected, best, stats, hist
+    return dvs, best, stats, hist
+
+class SweepResult:
+    """
+    Porkchop sweep output. dv[i][j] is the total Δv (km/s) for departure_times[i]
+    and tofs[j], or None where the solver failed or the cell was skipped. When
+    the sweep ran with a Selection, dv is None and selected holds ((i, j), dv)
+    pairs instead. skipped counts cells whose Δv lower bound exceeded the
+    cutoff (skipped_hyperbolic of them by the parabolic time limit) and
+    skipped_chunks the chunks in which every cell's bound exceeded it, so
+    that the chunk ran no Lambert solve. Chunks are not skipped on a bound
+    of their own: body states come from arbitrary state(t) objects, so the
+    cheapest valid chunk bound is the minimum of its cell bounds. The
+    histogram only counts solved cells.
+    """
+    def __init__(self, departure_times, tofs, keep_grid=True):
+        self.departure_times = departure_times
+        self.tofs = tofs
+        self.dv = [[None] * len(tofs) for _ in departure_times] if keep_grid else None
+        self.selected = None
+        self.best = None
+        self.failures = 0
+        self.skipped = 0
+        self.skipped_hyperbolic = 0
+        self.skipped_chunks = 0
+        self.histogram = None
+        self.edges = None
+
+def porkchop_sweep(solver, departure_body, arrival_body, departure_times, tofs,
+                   clockwise=False, workers=1, chunk_size=DEFAULT_CHUNK_SIZE, edges=None,
+                   select=None, cutoff=None, backend='universal', check=None, placement=None,
+                   max_iterations=1000, tolerance=1e-8):
+    """
+    Total Δv over a grid of departure times and times of flight.
+
+    :param departure_body: Object with state(t) -> (r, v), e.g. ephemeris.CircularOrbit
+    :param arrival_body: Object with state(t) -> (r, v)
+    :param departure_times: Departure times (s)
+    :param tofs: Times of flight (s)
+    :param workers: Number of worker processes
+    :param chunk_size: Cells per chunk (fixes the reduction shape)
+    :param edges: Δv histogram bin edges (km/s)
+    :param select: Optional batch.Selection on total Δv; only the selected cells are kept,
+                   so memory does not grow with the grid size
+    :param cutoff: Skip solving cells whose analytic Δv lower bound exceeds cutoff (km/s).
+                   Selection thresholds and full top-k heaps are used as cutoffs too.
+    :param backend: Lambert backend or 'auto', as for batch.solve_batch
+    :param check: Analytic self-check tolerance, as for batch.solve_batch; cells that
+                  fail it count as failures
+    :param placement: Optional numa.NumaPlacement for the worker processes
+    :param max_iterations: Newton iterations per cell, as for LambertSolver.solve
+    :param tolerance: Newton convergence tolerance, as for LambertSolver.solve
+    :return: SweepResult; best is ((i, j), dv) with ties going to the lowest row-major cell
+    """
+    if edges is None:
+        edges = [0.0, 1.0, 2.0, 5.0, 10.0, 20.0, float('inf')]
+    cells = len(departure_times) * len(tofs)
+    chunks = make_chunks(cells, chunk_size)
+    policy = batch_policy(backend, solver.policy)
+    args = ((solver.mu, departure_body, arrival_body, departure_times, tofs, start, stop,
+             clockwise, edges, select, cutoff, policy, check, max_iterations, tolerance) for start, stop in chunks)
+    result = SweepResult(departure_times, tofs, keep_grid=select is None)
+    n_tof = len(tofs)
+    best_cell = (None, None)
+    counts = [0] * (len(edges) - 1)
+    selected = []
+    for (start, stop), (dvs, best, stats, hist) in zip(chunks, imap_chunks(_sweep_chunk, args, workers, placement)):
+        if select is None:
+            for k, dv in enumerate(dvs):
+                cell = start + k
+                result.dv[cell // n_tof][cell % n_tof] = dv
+        else:
+            # Fold each chunk's selection in as it arrives; only one list is kept.
+            select.absorb(selected, dvs)
+        best_cell = merge_best([best_cell, best])
+        counts = merge_histograms([counts, hist])
+        failures, skipped, skipped_hyperbolic = stats
+        result.failures += failures
+        result.skipped += skipped
+        result.skipped_hyperbolic += skipped_hyperbolic
+        if skipped == stop - start:
+            result.skipped_chunks += 1
+    index, value = best_cell
+    if index is not None:
+        result.best = ((index // n_tof, index % n_tof), value)
+    result.histogram = counts
+    result.edges = edges
+    if select is not None:
+        result.selected = [((cell // n_tof, cell % n_tof), dv) for cell, dv, _ in select.entries(selected)]
+    return result
@@ -0,0 +1,123 @@
+"""
+Scratch and node arenas: buffers are reused after reset(), node columns are
+kept across generations, and searches built on them drop old generations.
+"""
+import math
+import unittest
+from arena import NodeArena, ScratchArena, thread_nodes, thread_scratch
+from ephemeris import CircularOrbit
+from explore import NODE_FIELDS, MgaProblem, beam_search, mcts
+from flyby import min_periapsis
+from main import LambertSolver
+from mga import search
+from tisserand import TisserandGraph
+
+MU_SUN = 1.32712440018e11
+AU = 1.495978707e8
+DAY = 86400.0
+
+def small_problem():
+    """Earth to Mars with at most one Venus or Earth flyby."""
+    ephemerides = {'earth': CircularOrbit(AU, MU_SUN),
+                   'venus': CircularOrbit(0.723 * AU, MU_SUN, phase=1.2),
+                   'mars': CircularOrbit(1.524 * AU, MU_SUN, phase=0.6)}
+    tofs = [k * 40 * DAY for k in range(3, 9)]
+    tof_choices = {(p, q): tofs for p in ephemerides for q in ephemerides}
+    rp_min = {name: min_periapsis(name) for name in ephemerides}
+    launch_epochs = [k * 30 * DAY for k in range(4)]
+    return ephemerides, tof_choices, rp_min, launch_epochs
+
+class ScratchArenaTest(unittest.TestCase):
+    def test_reset_reuses_one_block(self):
+        arena = ScratchArena(block_size=8)
+        a = arena.take(6)
+        b = arena.take(6)
+        a[0] = 1.5
+        b[5] = 2.5
+        self.assertEqual((a[0], b[5]), (1.5, 2.5))
+        self.assertEqual(len(arena.blocks['d']), 2)
+        arena.reset()
+        # The generation needed 12 items, so one block of 12 replaces the two
+        self.assertEqual(len(arena.blocks['d']), 1)
+        block = arena.blocks['d'][0]
+        arena.take(6)
+        arena.take(6)
+        self.assertIs(arena.blocks['d'][0], block)
+        self.assertEqual(len(arena.blocks['d']), 1)
+
+    def test_typecodes_are_separate(self):
+        arena = ScratchArena(block_size=4)
+        arena.take(3, 'd')
+        ints = arena.take(3, 'b')
+        ints[2] = 7
+        self.assertEqual(ints[2], 7)
+        self.assertEqual(sorted(arena.blocks), ['b', 'd'])
+
+    def test_thread_scratch(self):
+        self.assertIs(thread_scratch(), thread_scratch())
+
+class NodeArenaTest(unittest.TestCase):
+    def test_allocate_and_path(self):
+        arena = NodeArena(('parent', 'cost'))
+        root = arena.allocate(cost=0.0)
+        child = arena.allocate(parent=root, cost=1.0)
+        leaf = arena.allocate(parent=child, cost=2.0)
+        self.assertEqual(arena.path(leaf), [root, child, leaf])
+        self.assertEqual(arena.get('cost', leaf), 2.0)
+        arena.set('cost', leaf, 3.0)
+        self.assertEqual(arena.get('cost', leaf), 3.0)
+
+    def test_reset_keeps_columns(self):
+        arena = NodeArena(('parent', 'cost'))
+        for k in range(5):
+            arena.allocate(cost=float(k))
+        column = arena.columns['cost']
+        arena.reset()
+        self.assertEqual(len(arena), 0)
+        index = arena.allocate(cost=9.0)
+        self.assertEqual(index, 0)
+        self.assertIs(arena.columns['cost'], column)
+        self.assertEqual(len(column), 5)
+        self.assertIsNone(arena.get('parent', 0))
+
+    def test_thread_nodes_slots(self):
+        fields = ('parent', 'cost')
+        self.assertIs(thread_nodes(fields), thread_nodes(fields, 0))
+        self.assertIsNot(thread_nodes(fields, 0), thread_nodes(fields, 1))
+
+class SearchArenaTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_SUN)
+        self.ephemerides, self.tof_choices, self.rp_min, self.launch_epochs = small_problem()
+
+    def problem(self):
+        return MgaProblem(self.solver, self.ephemerides, 'earth', 'mars', ['venus', 'earth'], self.launch_epochs,
+                          self.tof_choices, self.rp_min, max_flybys=1)
+
+    def test_wide_beam_matches_exhaustive_search(self):
+        # Epochs and times of flight are whole hours, so snapping changes nothing
+        result = beam_search(self.problem(), beam_width=10 ** 6)
+        best = search(self.solver, self.ephemerides, TisserandGraph(), 'earth', 'mars', ['venus', 'earth'], 1,
+                      self.launch_epochs, self.tof_choices, self.rp_min, vinf_launch=math.inf)[0]
+        self.assertEqual(result.best.sequence, best.sequence)
+        self.assertAlmostEqual(result.best.cost, best.cost, places=9)
+
+    def test_beam_keeps_only_the_last_generation(self):
+        result = beam_search(self.problem(), beam_width=3)
+        self.assertIsNotNone(result.best)
+        arena = thread_nodes(NODE_FIELDS, 0)
+        spare = thread_nodes(NODE_FIELDS, 1)
+        # The last compaction kept only the best path; the other arena holds
+        # one generation, not every node expanded
+        self.assertEqual(min(len(arena), len(spare)), len(result.best.sequence))
+        self.assertLess(max(len(arena), len(spare)), result.legs)
+
+    def test_searches_reset_the_thread_arena(self):
+        first = mcts(self.problem(), iterations=10, parallel=4)
+        size = len(thread_nodes(NODE_FIELDS))
+        second = mcts(self.problem(), iterations=10, parallel=4)
+        self.assertEqual(len(thread_nodes(NODE_FIELDS)), size)
+        self.assertEqual(first.best.cost, second.best.cost)
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,129 @@
+"""
+Every Lambert backend must find the transfer the universal lane kernel finds,
+and 'auto' must only pick backends from its policy.
+"""
+import json
+import math
+import os
+import tempfile
+import unittest
+from backends import (BACKENDS, DEFAULT_POLICY, batch_policy, load_policy, resolve_policy, select_backend,
+                      solve_battin, solve_izzo, solve_with_backend)
+from batch import solve_batch
+from benchmark import bucket_problems, leo_geo_problems
+from kernel import BUCKET_NAMES, kepler_miss
+from main import LambertSolver
+from robust import solve_extended
+
+MU_EARTH = 398600.4418
+
+class BackendAgreementTest(unittest.TestCase):
+    def setUp(self):
+        self.problems = leo_geo_problems(100, seed=2)
+        self.reference = solve_batch(LambertSolver(MU_EARTH), self.problems)
+        self.assertEqual(self.reference.failures(), 0)
+
+    def assertSameTransfer(self, v, reference):
+        for a, b in zip(v, reference):
+            self.assertAlmostEqual(a, b, delta=1e-7 * max(1.0, abs(b)))
+
+    def test_single_problem_backends(self):
+        for backend in ('izzo', 'hypergeometric', 'battin'):
+            for k, (r1, r2, dt) in enumerate(self.problems):
+                v1, v2 = solve_with_backend(backend, MU_EARTH, r1, r2, dt)
+                self.assertSameTransfer(v1, self.reference.v1[k])
+                self.assertSameTransfer(v2, self.reference.v2[k])
+
+    def test_batch_backends(self):
+        for backend in list(BACKENDS) + ['auto']:
+            result = solve_batch(LambertSolver(MU_EARTH), self.problems, backend=backend)
+            self.assertEqual(result.failures(), 0, backend)
+            for k in range(len(self.problems)):
+                self.assertSameTransfer(result.v1[k], self.reference.v1[k])
+                self.assertSameTransfer(result.v2[k], self.reference.v2[k])
+
+    def test_solver_backends(self):
+        r1, r2, dt = [7000.0, 0.0, 0.0], [0.0, 42164.0, 100.0], 20000.0
+        reference = LambertSolver(MU_EARTH).solve(r1, r2, dt)
+        for backend in list(BACKENDS) + ['auto']:
+            v1, v2 = LambertSolver(MU_EARTH, backend=backend, policy={}).solve(r1, r2, dt)
+            self.assertSameTransfer(v1, reference[0])
+            self.assertSameTransfer(v2, reference[1])
+
+    def test_multi_revolution(self):
+        r1, r2, dt = [7000.0, 0.0, 0.0], [0.0, 8000.0, 500.0], 4 * 3600.0
+        for branch in ('left', 'right'):
+            v1, _ = solve_with_backend('izzo', MU_EARTH, r1, r2, dt, revolutions=1, branch=branch)
+            self.assertLess(kepler_miss(MU_EARTH, r1, v1, r2, dt), 1e-6)
+        with self.assertRaises(ValueError):
+            solve_battin(MU_EARTH, r1, r2, dt, revolutions=1)
+
+class BattinTest(unittest.TestCase):
+    def test_every_bucket(self):
+        for bucket, problems in bucket_problems(30).items():
+            for r1, r2, dt in problems:
+                v1, v2 = solve_battin(MU_EARTH, r1, r2, dt)
+                w1, w2 = solve_izzo(MU_EARTH, r1, r2, dt)
+                for a, b in zip(v1 + v2, w1 + w2):
+                    self.assertAlmostEqual(a, b, delta=1e-9 * max(1.0, abs(b)), msg=BUCKET_NAMES[bucket])
+
+    def test_near_180_degrees(self):
+        # Full precision against 50-digit decimal solutions, where the Lagrange
+        # coefficients and lambda = sqrt(1 - c / s) both lose digits
+        for eps in (1e-3, 1e-5, 1e-7, 1e-9):
+            angle = math.pi - eps
+            r1, r2, dt = [7000.0, 0.0, 0.0], [42164.0 * math.cos(angle), 42164.0 * math.sin(angle), 0.0], 5 * 3600.0
+            v1, v2 = solve_battin(MU_EARTH, r1, r2, dt)
+            w1, w2 = solve_extended(MU_EARTH, r1, r2, dt, precision=50)
+            for a, b in zip(v1 + v2, w1 + w2):
+                self.assertAlmostEqual(a, b, delta=1e-13 * max(1.0, abs(b)), msg=eps)
+
+class SolverSettingsTest(unittest.TestCase):
+    def test_settings_reach_backends(self):
+        r1, r2, dt = [7000.0, 0.0, 0.0], [0.0, 42164.0, 100.0], 20000.0
+        for backend in ('izzo', 'hypergeometric', 'battin'):
+            solver = LambertSolver(MU_EARTH, backend=backend)
+            with self.assertRaises(ValueError, msg=backend):
+                solver.solve(r1, r2, dt, max_iterations=1)
+            coarse = solver.solve(r1, r2, dt, tolerance=1e-1)
+            fine = solver.solve(r1, r2, dt, tolerance=1e-14)
+            self.assertNotEqual(coarse, fine, backend)
+            self.assertLess(kepler_miss(MU_EARTH, r1, fine[0], r2, dt), 1e-10)
+
+    def test_batch_settings_reach_backends(self):
+        problems = leo_geo_problems(5, seed=2)
+        result = solve_batch(LambertSolver(MU_EARTH), problems, backend='izzo', escalation=False, max_iterations=1)
+        self.assertEqual(result.failures(), len(problems))
+
+class PolicyTest(unittest.TestCase):
+    def test_default_policy(self):
+        self.assertEqual(set(DEFAULT_POLICY), set(BUCKET_NAMES))
+        self.assertTrue(set(DEFAULT_POLICY.values()) <= set(BACKENDS))
+        self.assertEqual(DEFAULT_POLICY['degenerate'], 'universal')
+
+    def test_policy_picks_backend(self):
+        policy = resolve_policy({name: 'battin' for name in BUCKET_NAMES})
+        r1, r2, dt = [7000.0, 0.0, 0.0], [0.0, 42164.0, 100.0], 20000.0
+        self.assertEqual(select_backend(MU_EARTH, r1, r2, dt, policy=policy), 'battin')
+        self.assertEqual(select_backend(MU_EARTH, r1, r2, dt, revolutions=1, policy=policy), 'izzo')
+
+    def test_fixed_backend_ignores_policy(self):
+        self.assertEqual(set(batch_policy('universal', {'elliptic': 'izzo'}).values()), {'universal'})
+
+    def test_policy_file(self):
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'backend_policy.json')
+            with open(path, 'w') as f:
+                json.dump({'elliptic': 'battin'}, f)
+            self.assertEqual(load_policy(path)['elliptic'], 'battin')
+            with open(path, 'w') as f:
+                json.dump({'elliptic': 'gooding'}, f)
+            with self.assertRaises(ValueError):
+                load_policy(path)
+
+    def test_unknown_backend(self):
+        with self.assertRaises(ValueError):
+            batch_policy('gooding')
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,182 @@
+"""
+Batch results must not depend on how the work is split: the same problems
+give bitwise identical output for any worker count and chunk size.
+"""
+import math
+import os
+import unittest
+from array import array
+import batch
+from main import LambertSolver, propagate_orbit
+from batch import (Selection, best_index, chunked_sum, imap_chunks, merge_best, monte_carlo_dispersion,
+                   propagate_batch_arrays, solve_batch, solve_batch_arrays, solve_batch_select)
+from benchmark import leo_geo_problems
+from kernel import kepler_miss
+from numa import NumaPlacement
+
+MU_EARTH = 398600.4418
+
+def speed(index, problem, v1, v2):
+    return math.sqrt(v1[0]**2 + v1[1]**2 + v1[2]**2)
+
+def even(index, value):
+    return index % 2 == 0
+
+def square(x):
+    return x * x
+
+class BatchDeterminismTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_EARTH)
+        self.problems = leo_geo_problems(300, seed=1)
+
+    def test_worker_count_and_chunking(self):
+        reference = solve_batch(self.solver, self.problems, chunk_size=256)
+        for workers, chunk_size in ((1, 7), (1, 64), (3, 7), (3, 256)):
+            result = solve_batch(self.solver, self.problems, workers=workers, chunk_size=chunk_size)
+            self.assertEqual(result.v1, reference.v1, (workers, chunk_size))
+            self.assertEqual(result.v2, reference.v2, (workers, chunk_size))
+            self.assertEqual(result.errors, reference.errors, (workers, chunk_size))
+
+    def test_matches_solver(self):
+        # Where the scalar solver converges, the batch finds the same transfer
+        result = solve_batch(self.solver, self.problems[:50])
+        compared = 0
+        for k, (r1, r2, dt) in enumerate(self.problems[:50]):
+            try:
+                v1, v2 = self.solver.solve(r1, r2, dt)
+            except (OverflowError, ValueError, RuntimeError):
+                continue
+            if not kepler_miss(MU_EARTH, r1, v1, r2, dt) < 1e-6:
+                continue
+            for a, b in zip(result.v1[k] + result.v2[k], v1 + v2):
+                self.assertAlmostEqual(a, b, delta=1e-8 * max(1.0, abs(b)))
+            compared += 1
+        self.assertGreater(compared, 25)
+
+    def test_solutions_reach_r2(self):
+        result = solve_batch(self.solver, self.problems)
+        self.assertEqual(result.failures(), 0)
+        for k, (r1, r2, dt) in enumerate(self.problems):
+            self.assertLess(kepler_miss(MU_EARTH, r1, result.v1[k], r2, dt), 1e-8)
+
+    def test_dispersion(self):
+        r1, r2, dt = self.problems[0]
+        reference = monte_carlo_dispersion(self.solver, r1, r2, dt, 1e-4, 200, seed=5, chunk_size=64, num_steps=50)
+        for workers in (1, 3):
+            result = monte_carlo_dispersion(self.solver, r1, r2, dt, 1e-4, 200, seed=5, workers=workers,
+                                            chunk_size=64, num_steps=50)
+            self.assertEqual(result, reference)
+
+class ArraysTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_EARTH)
+        self.problems = leo_geo_problems(40, seed=1)
+        self.r1 = array('d', (x for p in self.problems for x in p[0]))
+        self.r2 = array('d', (x for p in self.problems for x in p[1]))
+        self.dt = array('d', (p[2] for p in self.problems))
+
+    def test_arrays_match_lists(self):
+        result = solve_batch(self.solver, self.problems)
+        for workers in (1, 2):
+            v1, v2, status = solve_batch_arrays(self.solver, self.r1, self.r2, self.dt, chunk_size=9, workers=workers)
+            for k in range(len(self.problems)):
+                self.assertEqual(status[k], 0)
+                self.assertEqual(list(v1[3 * k:3 * k + 3]), result.v1[k])
+                self.assertEqual(list(v2[3 * k:3 * k + 3]), result.v2[k])
+
+    def test_outputs_written_in_place(self):
+        n = len(self.problems)
+        v1, v2, status = array('d', bytes(24 * n)), array('d', bytes(24 * n)), array('b', bytes(n))
+        out = solve_batch_arrays(self.solver, self.r1, self.r2, self.dt, v1_out=v1, v2_out=v2, status_out=status)
+        self.assertIs(out[0], v1)
+        self.assertIs(out[1], v2)
+        self.assertIs(out[2], status)
+        reference = solve_batch_arrays(self.solver, list(self.r1), list(self.r2), list(self.dt))
+        self.assertEqual(v1, reference[0])
+        self.assertEqual(v2, reference[1])
+
+    def test_rejects_mistyped_outputs(self):
+        n = len(self.problems)
+        with self.assertRaises(ValueError):
+            solve_batch_arrays(self.solver, self.r1, self.r2, self.dt, v1_out=array('f', bytes(12 * n)))
+        with self.assertRaises(ValueError):
+            solve_batch_arrays(self.solver, self.r1, self.r2, self.dt, v1_out=array('d', bytes(8 * n)))
+        with self.assertRaises(ValueError):
+            solve_batch_arrays(self.solver, self.r1, self.r2, self.dt, v1_out=bytes(24 * n))
+
+    def test_propagate_matches_scalar(self):
+        result = solve_batch(self.solver, self.problems[:6])
+        r0 = array('d', (x for p in self.problems[:6] for x in p[0]))
+        v0 = array('d', (x for v in result.v1 for x in v))
+        dt = array('d', (p[2] for p in self.problems[:6]))
+        for workers in (1, 2):
+            r, v = propagate_batch_arrays(MU_EARTH, r0, v0, dt, num_steps=50, workers=workers, chunk_size=4)
+            for k, (r1, _, tof) in enumerate(self.problems[:6]):
+                rk, vk = propagate_orbit(list(r1), result.v1[k], tof, MU_EARTH, num_steps=50)
+                for a, b in zip(list(r[3 * k:3 * k + 3]) + list(v[3 * k:3 * k + 3]), rk + vk):
+                    self.assertAlmostEqual(a, b, delta=1e-9 * max(1.0, abs(b)))
+
+class SelectionTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_EARTH)
+        self.problems = leo_geo_problems(300, seed=1)
+        result = solve_batch(self.solver, self.problems)
+        self.speeds = sorted((speed(k, None, result.v1[k], None), k) for k in range(len(self.problems)))
+
+    def select(self, selection, **kwargs):
+        return [(index, value) for index, value, _ in
+                solve_batch_select(self.solver, self.problems, selection, **kwargs)]
+
+    def test_top_k(self):
+        expected = [(k, v) for v, k in self.speeds[:5]]
+        for workers, chunk_size in ((1, 7), (1, 300), (3, 64)):
+            self.assertEqual(self.select(Selection(top_k=5, key=speed), workers=workers, chunk_size=chunk_size),
+                             expected)
+
+    def test_threshold_and_predicate(self):
+        limit = self.speeds[40][0]
+        expected = [(k, v) for v, k in self.speeds if v < limit and k % 2 == 0]
+        selection = Selection(threshold=limit, predicate=even, key=speed)
+        self.assertEqual(self.select(selection, chunk_size=16), expected)
+        self.assertEqual(self.select(selection, workers=3, chunk_size=16), expected)
+
+    def test_streaming_merge_matches_one_list(self):
+        select = Selection(top_k=3)
+        partials = []
+        for lo in range(0, 20, 4):
+            selected = []
+            for index in range(lo, lo + 4):
+                select.push(selected, index, float((index * 7) % 5))
+            partials.append(selected)
+        self.assertEqual([(i, v) for i, v, _ in select.merge(iter(partials))], [(0, 0.0), (5, 0.0), (10, 0.0)])
+
+    def test_imap_chunks_is_lazy(self):
+        cpus = sorted(os.sched_getaffinity(0))
+        with NumaPlacement(nodes={0: cpus}, workers_per_node=2) as placement:
+            for workers, placement_ in ((2, None), (1, placement)):
+                consumed = []
+
+                def chunk_args():
+                    for k in range(50):
+                        consumed.append(k)
+                        yield (k,)
+
+                results = imap_chunks(square, chunk_args(), workers, placement_)
+                self.assertEqual(next(results), 0)
+                self.assertLessEqual(len(consumed), 2 * batch.LOOKAHEAD + 1)
+                self.assertEqual(list(results), [k * k for k in range(1, 50)])
+
+class ReductionTest(unittest.TestCase):
+    def test_chunked_sum(self):
+        values = [None if k % 7 == 0 else 0.1 * k for k in range(1000)]
+        partials = [sum(x for x in values[lo:lo + 64] if x is not None) for lo in range(0, 1000, 64)]
+        self.assertAlmostEqual(chunked_sum(values, 64), sum(partials), places=9)
+        self.assertEqual(chunked_sum(values, 64), chunked_sum(list(values), 64))
+
+    def test_ties_go_to_lowest_index(self):
+        self.assertEqual(best_index([None, 3.0, 1.0, 1.0]), (2, 1.0))
+        self.assertEqual(merge_best([(7, 1.0), (2, 1.0), (None, None), (5, 2.0)]), (2, 1.0))
+
+if __name__ == "__main__":
+    unittest.main()
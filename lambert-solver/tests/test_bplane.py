@@ -0,0 +1,76 @@
+"""
+B-plane parameters of known hyperbolas, and B-plane targeting of an
+Earth-Mars leg that reaches the aim point on the hand-off sphere.
+"""
+import math
+import unittest
+from bplane import bplane, target_bplane, target_bplane_batch
+from ephemeris import CircularOrbit
+from kernel import kepler_miss
+from main import LambertSolver
+from sensitivity import norm
+
+MU_SUN = 1.32712440018e11
+MU_MARS = 42828.37
+AU = 1.495978707e8
+SOI_MARS = 577000.0
+DAY = 86400.0
+
+class BPlaneTest(unittest.TestCase):
+    def test_planar_approach(self):
+        # Approach along +x with a 5000 km offset in z: the motion stays in
+        # the x-z plane, so B lies along -R and |B| = |h| / v_inf.
+        distance, offset, speed = 1e6, 5000.0, 3.0
+        result = bplane(MU_MARS, [-distance, 0.0, offset], [speed, 0.0, 0.0])
+        v_inf = math.sqrt(speed**2 - 2 * MU_MARS / math.hypot(distance, offset))
+        self.assertAlmostEqual(result.v_inf, v_inf, delta=1e-12)
+        self.assertAlmostEqual(result.b_t, 0.0, delta=1e-6)
+        self.assertAlmostEqual(result.b_r, -offset * speed / v_inf, delta=1e-6)
+        self.assertAlmostEqual(result.b, offset * speed / v_inf, delta=1e-6)
+        self.assertAlmostEqual(result.ltof, distance / v_inf, delta=1e-3 * distance / v_inf)
+
+    def test_frame_is_orthonormal(self):
+        result = bplane(MU_MARS, [-8e5, 2e4, -3e4], [2.5, 0.4, 0.3])
+        for axis in (result.s, result.t, result.r):
+            self.assertAlmostEqual(norm(axis), 1.0, delta=1e-12)
+        self.assertAlmostEqual(sum(a * b for a, b in zip(result.s, result.t)), 0.0, delta=1e-12)
+        self.assertAlmostEqual(sum(a * b for a, b in zip(result.s, result.r)), 0.0, delta=1e-12)
+        self.assertAlmostEqual(result.t[2], 0.0, delta=1e-12)
+
+    def test_elliptic_state_rejected(self):
+        with self.assertRaises(ValueError):
+            bplane(MU_MARS, [-1e4, 0.0, 0.0], [0.0, 1.0, 0.0])
+
+class TargetTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_SUN)
+        self.earth = CircularOrbit(AU, MU_SUN)
+        self.mars = CircularOrbit(1.524 * AU, MU_SUN, phase=0.8, inclination=0.032)
+        self.aim = (8000.0, -4000.0)
+
+    def problem(self, t0, tof):
+        return self.earth.state(t0)[0], tof, self.mars.state(t0 + tof)
+
+    def assertTarget(self, target, r1, dt, planet_state):
+        self.assertAlmostEqual(target.bplane.b_t, self.aim[0], delta=1e-4)
+        self.assertAlmostEqual(target.bplane.b_r, self.aim[1], delta=1e-4)
+        self.assertAlmostEqual(norm(target.x), SOI_MARS, delta=1e-4)
+        r2 = [planet_state[0][k] + target.x[k] for k in range(3)]
+        self.assertLess(kepler_miss(MU_SUN, r1, target.v1, r2, dt), 1e-6)
+
+    def test_reaches_aim_point(self):
+        r1, dt, planet_state = self.problem(0.0, 200 * DAY)
+        target = target_bplane(self.solver, r1, dt, planet_state, MU_MARS, self.aim, SOI_MARS)
+        self.assertTarget(target, r1, dt, planet_state)
+        self.assertLessEqual(target.iterations, 10)
+
+    def test_batch(self):
+        problems = [self.problem(0.0, (200 + k) * DAY) for k in range(8)]
+        reference = target_bplane_batch(self.solver, problems, MU_MARS, self.aim, SOI_MARS, chunk_size=3)
+        for (r1, dt, planet_state), target in zip(problems, reference):
+            self.assertTarget(target, r1, dt, planet_state)
+        result = target_bplane_batch(self.solver, problems, MU_MARS, self.aim, SOI_MARS, chunk_size=3, workers=2)
+        self.assertEqual([t.x for t in result], [t.x for t in reference])
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,108 @@
+"""
+Porkchop contours: crossings lie on the requested level, tiling does not
+change the result, and segments from neighbouring tiles join into polylines.
+"""
+import math
+import unittest
+from contour import _stitch, porkchop_contours, transfer_metrics
+from ephemeris import CircularOrbit
+from main import LambertSolver
+from sweep import porkchop_sweep
+
+MU_SUN = 1.32712440018e11
+AU = 1.495978707e8
+DAY = 86400.0
+
+class ContourTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_SUN)
+        self.earth = CircularOrbit(AU, MU_SUN)
+        self.mars = CircularOrbit(1.524 * AU, MU_SUN, phase=0.8, inclination=0.032)
+        self.departure_times = [k * 12 * DAY for k in range(14)]
+        self.tofs = [140 * DAY + k * 12 * DAY for k in range(14)]
+        self.levels = [6.0, 8.0]
+
+    def contours(self, **kwargs):
+        return porkchop_contours(self.solver, self.earth, self.mars, self.departure_times, self.tofs,
+                                 self.levels, **kwargs)
+
+    def test_crossings_match_grid(self):
+        # Every grid edge whose end values straddle a level holds one contour point
+        grid = porkchop_sweep(self.solver, self.earth, self.mars, self.departure_times, self.tofs).dv
+        for level in self.levels:
+            points = {point for line in self.contours()[level] for point in line}
+            crossings = 0
+            for i in range(len(self.departure_times)):
+                for j in range(len(self.tofs)):
+                    for i2, j2 in ((i, j + 1), (i + 1, j)):
+                        if i2 < len(self.departure_times) and j2 < len(self.tofs):
+                            crossings += (grid[i][j] > level) != (grid[i2][j2] > level)
+            self.assertGreater(crossings, 0)
+            self.assertEqual(len(points), crossings)
+
+    def test_refined_points_lie_on_level(self):
+        for level, lines in self.contours(refine=8).items():
+            for line in lines:
+                for t0, tof in line:
+                    dv = transfer_metrics(self.solver, self.earth, self.mars, t0, tof)['dv']
+                    self.assertAlmostEqual(dv, level, delta=1e-6)
+
+    def test_solver_settings(self):
+        loose = porkchop_sweep(self.solver, self.earth, self.mars, self.departure_times[:1], self.tofs[:1],
+                               tolerance=1e-1).dv[0][0]
+        metrics = transfer_metrics(self.solver, self.earth, self.mars, self.departure_times[0], self.tofs[0],
+                                   tolerance=1e-1)
+        self.assertEqual(metrics['dv'], loose)
+        self.assertNotEqual(self.contours(tolerance=1e-1), self.contours())
+
+    def test_tiling_and_workers(self):
+        def canonical(contours):
+            return {level: sorted(sorted(line) for line in lines) for level, lines in contours.items()}
+        reference = canonical(self.contours(tile_size=32))
+        tiles = []
+        self.assertEqual(canonical(self.contours(tile_size=3, on_tile=lambda k, s: tiles.append(k))), reference)
+        self.assertEqual(tiles, sorted(tiles))
+        self.assertEqual(len(tiles), 25)
+        self.assertEqual(canonical(self.contours(tile_size=5, workers=2)), reference)
+
+class CollinearTest(unittest.TestCase):
+    def test_no_holes_at_collinear_nodes(self):
+        # Mars is placed opposite the Earth at t0 = 0 for the middle time of flight,
+        # so that node has exactly collinear r1 and r2 (a 180 degree transfer)
+        solver = LambertSolver(MU_SUN)
+        earth = CircularOrbit(AU, MU_SUN)
+        tofs = [230 * DAY + k * 10 * DAY for k in range(5)]
+        mars = CircularOrbit(1.524 * AU, MU_SUN)
+        mars = CircularOrbit(1.524 * AU, MU_SUN, phase=math.pi - mars.mean_motion * tofs[2])
+        metrics = transfer_metrics(solver, earth, mars, 0.0, tofs[2])
+        self.assertIsNotNone(metrics)
+        grid = porkchop_sweep(solver, earth, mars, [0.0, 10 * DAY], tofs).dv
+        self.assertAlmostEqual(metrics['dv'], grid[0][2], delta=1e-9)
+        level = (grid[0][2] + grid[0][3]) / 2
+        lines = porkchop_contours(solver, earth, mars, [0.0, 10 * DAY], tofs, [level])[level]
+        points = {point for line in lines for point in line}
+        crossings = sum((a > level) != (b > level) for row in grid for a, b in zip(row, row[1:]))
+        crossings += sum((a > level) != (b > level) for a, b in zip(grid[0], grid[1]))
+        self.assertGreater(crossings, 0)
+        self.assertEqual(len(points), crossings)
+
+class StitchTest(unittest.TestCase):
+    def test_closed_square(self):
+        # Four segments around one node, given out of order, close into one loop
+        keys = [('h', 0, 0), ('v', 0, 1), ('h', 1, 0), ('v', 0, 0)]
+        points = {(1.0, key): (float(n), 0.0) for n, key in enumerate(keys)}
+        segments = [(keys[2], keys[3]), (keys[0], keys[1]), (keys[3], keys[0]), (keys[1], keys[2])]
+        lines = _stitch(segments, points, 1.0)
+        self.assertEqual(len(lines), 1)
+        self.assertEqual(len(lines[0]), 5)
+        self.assertEqual(lines[0][0], lines[0][-1])
+
+    def test_open_line(self):
+        keys = [('v', 0, 0), ('v', 1, 0), ('v', 2, 0)]
+        points = {(2.0, key): (0.0, float(n)) for n, key in enumerate(keys)}
+        lines = _stitch([(keys[1], keys[2]), (keys[0], keys[1])], points, 2.0)
+        self.assertEqual(len(lines), 1)
+        self.assertEqual(sorted(lines[0]), [(0.0, 0.0), (0.0, 1.0), (0.0, 2.0)])
+
+if __name__ == "__main__":
+    unittest.main()
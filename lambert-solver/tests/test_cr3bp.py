@@ -0,0 +1,116 @@
+"""
+CR3BP propagation and shooting: frame conversions, the Jacobi constant,
+the STM against finite differences, and Earth-Moon shooting within the
+iteration counts stated in cr3bp.py.
+"""
+import math
+import unittest
+from cr3bp import EARTH_MOON, propagate, propagate_batch_arrays, propagate_lanes, shoot_batch, shoot_transfer
+
+HOUR = 3600.0
+DAY = 86400.0
+
+def jacobi(mu, s):
+    x, y, z, vx, vy, vz = s
+    r1 = math.sqrt((x + mu)**2 + y * y + z * z)
+    r2 = math.sqrt((x - 1 + mu)**2 + y * y + z * z)
+    return x * x + y * y + 2 * (1 - mu) / r1 + 2 * mu / r2 - (vx * vx + vy * vy + vz * vz)
+
+def translunar(dt):
+    # From a 300 km parking orbit to 8000 km ahead of and 2000 km above the Moon
+    r1 = [-6678.0 * math.cos(0.3), -6678.0 * math.sin(0.3), 0.0]
+    moon = EARTH_MOON.secondary_position(dt)
+    return r1, [moon[0], moon[1] + 8000.0, moon[2] + 2000.0], dt
+
+class PropagateTest(unittest.TestCase):
+    def setUp(self):
+        self.mu = EARTH_MOON.mu
+        # Translunar coast state in the rotating frame
+        self.state = EARTH_MOON.to_rotating([-6678.0, 0.0, 0.0], [0.0, -10.9, 0.3], 0.0)
+
+    def test_frame_round_trip(self):
+        r, v = [12000.0, -3000.0, 500.0], [1.0, 4.5, -0.2]
+        for t in (0.0, 2.5 * DAY):
+            r_back, v_back = EARTH_MOON.to_inertial(EARTH_MOON.to_rotating(r, v, t), t)
+            for a, b in zip(r + v, r_back + v_back):
+                self.assertAlmostEqual(a, b, delta=1e-9 * max(abs(b), 1.0))
+        # The Moon is at rest at (1 - mu, 0, 0)
+        moon = EARTH_MOON.to_rotating(EARTH_MOON.secondary_position(DAY), [0.0] * 3, DAY)
+        self.assertAlmostEqual(moon[0], 1 - self.mu, delta=1e-12)
+        self.assertAlmostEqual(moon[1], 0.0, delta=1e-12)
+
+    def test_jacobi_constant(self):
+        # RK4 at the default steps, through perigee and out to lunar distance
+        final, _, steps = propagate(self.mu, self.state, 1.0)
+        self.assertGreater(steps, 100)
+        self.assertAlmostEqual(jacobi(self.mu, final), jacobi(self.mu, self.state), delta=1e-6)
+        fine, _, _ = propagate(self.mu, self.state, 1.0, eta=0.002, max_step=0.002)
+        self.assertAlmostEqual(jacobi(self.mu, fine), jacobi(self.mu, self.state), delta=1e-9)
+
+    def test_stm_matches_finite_differences(self):
+        tau = 0.5
+        _, phi, _ = propagate(self.mu, self.state, tau, stm=True)
+        h = 1e-7
+        for j in range(6):
+            plus = list(self.state)
+            minus = list(self.state)
+            plus[j] += h
+            minus[j] -= h
+            a = propagate(self.mu, plus, tau)[0]
+            b = propagate(self.mu, minus, tau)[0]
+            for i in range(6):
+                self.assertAlmostEqual(phi[i][j], (a[i] - b[i]) / (2 * h), delta=1e-5 * max(1.0, abs(phi[i][j])))
+
+    def test_batch_arrays(self):
+        states = [self.state, EARTH_MOON.to_rotating([-7000.0, 0.0, 0.0], [0.0, -10.7, 0.0], 0.0)]
+        dt = [0.3, 0.6]
+        out = [0.0] * 12
+        stm_out = [0.0] * 72
+        propagate_lanes(self.mu, [x for s in states for x in s], dt, out, stm_out)
+        for workers in (1, 2):
+            states_out, phi = propagate_batch_arrays(self.mu, states, dt, stm=True, workers=workers, chunk_size=1)
+            self.assertEqual(list(states_out), out)
+            self.assertEqual(list(phi), stm_out)
+        with self.assertRaises(ValueError):
+            propagate_batch_arrays(self.mu, states, [0.3])
+
+class ShootTest(unittest.TestCase):
+    def assertArrives(self, transfer, r1, r2, dt):
+        self.assertLessEqual(transfer.miss, 1e-3)
+        # An independent finer propagation of the converged departure state
+        start = EARTH_MOON.to_rotating(r1, transfer.v1, 0.0)
+        final, _, _ = propagate(EARTH_MOON.mu, start, dt / EARTH_MOON.time, eta=0.002, max_step=0.002)
+        r, _ = EARTH_MOON.to_inertial(final, dt)
+        self.assertLess(math.dist(r, r2), 1.0)
+
+    def test_converges_from_lambert_seed(self):
+        # cr3bp.py: 5 to 9 iterations from the bare Lambert seed
+        r1, r2, dt = translunar(3.5 * DAY)
+        transfer = shoot_transfer(EARTH_MOON, r1, r2, dt)
+        self.assertLessEqual(transfer.iterations, 9)
+        self.assertArrives(transfer, r1, r2, dt)
+        # Three-body dynamics move the patched-conic departure by a measurable amount
+        self.assertGreater(transfer.correction, 0.01)
+
+    def test_warm_start_converges_faster(self):
+        # cr3bp.py: 3 to 5 iterations per cell of an hourly sweep when warm-started
+        problems = [translunar(3.5 * DAY + k * HOUR) for k in range(4)]
+        result = shoot_batch(EARTH_MOON, problems)
+        for (r1, r2, dt), transfer in zip(problems, result):
+            self.assertArrives(transfer, r1, r2, dt)
+        for transfer in result[1:]:
+            self.assertLessEqual(transfer.iterations, 5)
+        cold = shoot_transfer(EARTH_MOON, *problems[1])
+        self.assertLess(result[1].iterations, cold.iterations)
+        # Warm starts restart at chunk boundaries, so only the first chunk
+        # matches the single-chunk run
+        parallel = shoot_batch(EARTH_MOON, problems, workers=2, chunk_size=2)
+        self.assertEqual([t.v1 for t in parallel[:2]], [t.v1 for t in result[:2]])
+
+    def test_iteration_limit(self):
+        with self.assertRaises(ValueError):
+            shoot_transfer(EARTH_MOON, *translunar(3.5 * DAY), max_iterations=1)
+        self.assertEqual(shoot_batch(EARTH_MOON, [translunar(3.5 * DAY)], max_iterations=1), [None])
+
+if __name__ == "__main__":
+    unittest.main()
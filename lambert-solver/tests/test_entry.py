@@ -0,0 +1,53 @@
+"""
+Entry-interface targeting reaches the requested flight-path angle on the
+entry sphere, from a scan or a warm start, for single problems and batches.
+"""
+import math
+import unittest
+from entry import flight_path_angle, target_entry, target_entry_batch
+from kernel import kepler_miss
+from main import LambertSolver
+from sensitivity import norm
+
+MU_EARTH = 398600.4418
+ENTRY_RADIUS = 6371.0 + 122.0
+GAMMA = math.radians(-6.5)
+DAY = 86400.0
+
+class EntryTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_EARTH)
+        self.r1 = [-150000.0, 40000.0, 0.0]
+        self.dt = 2.5 * DAY
+
+    def assertEntry(self, target, r1, dt):
+        self.assertAlmostEqual(target.flight_path_angle, GAMMA, delta=1e-10)
+        self.assertAlmostEqual(flight_path_angle(target.r2, target.v2), GAMMA, delta=1e-10)
+        self.assertAlmostEqual(norm(target.r2), ENTRY_RADIUS, delta=1e-8)
+        self.assertAlmostEqual(target.r2[2], 0.0, delta=1e-9)
+        self.assertLess(kepler_miss(MU_EARTH, r1, target.v1, target.r2, dt), 1e-8)
+
+    def test_scan_finds_target(self):
+        target = target_entry(self.solver, self.r1, self.dt, ENTRY_RADIUS, GAMMA)
+        self.assertEntry(target, self.r1, self.dt)
+
+    def test_warm_start_converges_quickly(self):
+        cold = target_entry(self.solver, self.r1, self.dt, ENTRY_RADIUS, GAMMA)
+        warm = target_entry(self.solver, self.r1, self.dt + 600.0, ENTRY_RADIUS, GAMMA, angle=cold.angle)
+        self.assertEntry(warm, self.r1, self.dt + 600.0)
+        self.assertLessEqual(warm.iterations, 5)
+
+    def test_unreachable_angle(self):
+        with self.assertRaises(ValueError):
+            target_entry(self.solver, self.r1, self.dt, ENTRY_RADIUS, math.radians(89.9))
+
+    def test_batch(self):
+        problems = [(self.r1, self.dt + k * 3600.0) for k in range(12)]
+        reference = target_entry_batch(self.solver, problems, ENTRY_RADIUS, GAMMA, chunk_size=5)
+        for (r1, dt), target in zip(problems, reference):
+            self.assertEntry(target, r1, dt)
+        result = target_entry_batch(self.solver, problems, ENTRY_RADIUS, GAMMA, chunk_size=5, workers=2)
+        self.assertEqual([t.r2 for t in result], [t.r2 for t in reference])
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,89 @@
+"""
+Beam search and MCTS over MGA decisions against the exhaustive search,
+with early stops, Tisserand pruning and legs shared through the cache.
+"""
+import math
+import time
+import unittest
+from ephemeris import CircularOrbit
+from explore import MgaProblem, beam_search, mcts
+from flyby import min_periapsis
+from main import LambertSolver
+from mga import LegCache, search
+from tisserand import TisserandGraph
+
+MU_SUN = 1.32712440018e11
+AU = 1.495978707e8
+DAY = 86400.0
+
+class ExploreTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_SUN)
+        self.ephemerides = {'earth': CircularOrbit(AU, MU_SUN),
+                            'venus': CircularOrbit(0.723 * AU, MU_SUN, phase=1.2),
+                            'mars': CircularOrbit(1.524 * AU, MU_SUN, phase=0.6)}
+        tofs = [k * 40 * DAY for k in range(3, 9)]
+        self.tof_choices = {(p, q): tofs for p in self.ephemerides for q in self.ephemerides}
+        self.rp_min = {name: min_periapsis(name) for name in self.ephemerides}
+        self.launch_epochs = [k * 30 * DAY for k in range(4)]
+        self.exhaustive = search(self.solver, self.ephemerides, TisserandGraph(), 'earth', 'mars',
+                                 ['venus', 'earth'], 1, self.launch_epochs, self.tof_choices, self.rp_min,
+                                 vinf_launch=math.inf)[0]
+
+    def problem(self, **kwargs):
+        return MgaProblem(self.solver, self.ephemerides, 'earth', 'mars', ['venus', 'earth'], self.launch_epochs,
+                          self.tof_choices, self.rp_min, max_flybys=1, **kwargs)
+
+    def assertConsistent(self, path):
+        # Cost is the launch v_inf plus the flyby Δv, and epochs follow the legs
+        launch = math.sqrt(sum(c * c for c in path.legs[0][0]))
+        self.assertAlmostEqual(path.cost, launch + sum(path.flyby_dv), places=9)
+        self.assertEqual(len(path.epochs), len(path.sequence))
+        self.assertEqual(path.sequence[0], 'earth')
+        self.assertEqual(path.sequence[-1], 'mars')
+
+    def test_narrow_beam(self):
+        wide = beam_search(self.problem(), beam_width=10 ** 6)
+        narrow = beam_search(self.problem(), beam_width=2)
+        self.assertConsistent(narrow.best)
+        self.assertGreaterEqual(narrow.best.cost, self.exhaustive.cost - 1e-9)
+        self.assertLess(narrow.expanded, wide.expanded)
+        self.assertFalse(narrow.stopped)
+
+    def test_mcts_finds_exhaustive_best(self):
+        result = mcts(self.problem(), iterations=400, parallel=8)
+        self.assertConsistent(result.best)
+        self.assertEqual(result.best.sequence, self.exhaustive.sequence)
+        self.assertAlmostEqual(result.best.cost, self.exhaustive.cost, places=9)
+
+    def test_mcts_shares_legs(self):
+        cache = LegCache()
+        result = mcts(self.problem(legs=cache), iterations=50, parallel=8)
+        self.assertEqual(cache.hits + cache.misses + cache.waits, result.legs)
+        self.assertEqual(len(cache.entries), cache.misses)
+
+    def test_deadline_and_stop(self):
+        for search_fn in (beam_search, mcts):
+            result = search_fn(self.problem(), deadline=time.monotonic() - 1.0)
+            self.assertTrue(result.stopped)
+            self.assertIsNone(result.best)
+            self.assertEqual(result.expanded, 0)
+        calls = []
+        result = mcts(self.problem(), iterations=400, stop=lambda: calls.append(1) or len(calls) > 3)
+        self.assertTrue(result.stopped)
+        self.assertEqual(len(calls), 4)
+        self.assertLessEqual(result.expanded, 3 * 8)
+
+    def test_tisserand_pruning(self):
+        graph = TisserandGraph({name: orbit.radius for name, orbit in self.ephemerides.items()})
+        full = beam_search(self.problem(), beam_width=10 ** 6)
+        # 2.6 km/s is below the Hohmann v_inf to Mars, so the direct leg is ruled out
+        pruned = beam_search(self.problem(graph=graph, vinf_launch=2.6), beam_width=10 ** 6)
+        self.assertLess(pruned.legs, full.legs)
+        reference = search(self.solver, self.ephemerides, graph, 'earth', 'mars', ['venus', 'earth'], 1,
+                           self.launch_epochs, self.tof_choices, self.rp_min, vinf_launch=2.6)[0]
+        self.assertEqual(pruned.best.sequence, reference.sequence)
+        self.assertAlmostEqual(pruned.best.cost, reference.cost, places=9)
+
+if __name__ == "__main__":
+    unittest.main()
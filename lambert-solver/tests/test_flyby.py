@@ -0,0 +1,89 @@
+"""
+Powered flybys: periapsis and Δv against the turn equation, continuity at
+the turn limit, the unpowered forward model and the batch paths.
+"""
+import math
+import unittest
+from array import array
+from flyby import (FLYBY_ERROR, FLYBY_OK, PLANETS, TURN_LIMITED, flyby, flyby_batch, min_periapsis,
+                   rotate_flybys)
+
+MU_VENUS = PLANETS['venus'][0]
+RP_MIN = min_periapsis('venus')
+
+def turned(speed, angle):
+    # v_inf of the given speed turned by angle from +x in the x-y plane
+    return [speed * math.cos(angle), speed * math.sin(angle), 0.0]
+
+def turn_angle(rp, v_in, v_out):
+    return (math.asin(1 / (1 + rp * v_in**2 / MU_VENUS))
+            + math.asin(1 / (1 + rp * v_out**2 / MU_VENUS)))
+
+class FlybyTest(unittest.TestCase):
+    def test_powered_flyby(self):
+        delta = math.radians(30.0)
+        rp, dv, status = flyby(MU_VENUS, turned(5.0, 0.0), turned(6.0, delta), RP_MIN)
+        self.assertEqual(status, FLYBY_OK)
+        self.assertGreater(rp, RP_MIN)
+        self.assertAlmostEqual(turn_angle(rp, 5.0, 6.0), delta, delta=1e-12)
+        expected = math.sqrt(36.0 + 2 * MU_VENUS / rp) - math.sqrt(25.0 + 2 * MU_VENUS / rp)
+        self.assertAlmostEqual(dv, expected, delta=1e-12)
+
+    def test_no_turn(self):
+        rp, dv, status = flyby(MU_VENUS, turned(5.0, 0.3), turned(5.5, 0.3), RP_MIN)
+        self.assertEqual(status, FLYBY_OK)
+        self.assertEqual(rp, float('inf'))
+        self.assertAlmostEqual(dv, 0.5, delta=1e-12)
+
+    def test_zero_v_inf(self):
+        rp, dv, status = flyby(MU_VENUS, [0.0, 0.0, 0.0], turned(5.0, 0.0), RP_MIN)
+        self.assertEqual(status, FLYBY_ERROR)
+        self.assertTrue(math.isnan(rp) and math.isnan(dv))
+
+    def test_turn_limit_is_continuous(self):
+        limit = turn_angle(RP_MIN, 5.0, 6.0)
+        below = flyby(MU_VENUS, turned(5.0, 0.0), turned(6.0, limit - 1e-9), RP_MIN)
+        above = flyby(MU_VENUS, turned(5.0, 0.0), turned(6.0, limit + 1e-9), RP_MIN)
+        self.assertEqual(below[2], FLYBY_OK)
+        self.assertEqual(above[2], TURN_LIMITED)
+        self.assertAlmostEqual(below[0], RP_MIN, delta=1e-3)
+        self.assertEqual(above[0], RP_MIN)
+        self.assertAlmostEqual(below[1], above[1], delta=1e-7)
+        # Beyond the limit the deficit is paid by rotating v_inf_out
+        deficit = math.radians(10.0)
+        rp, dv, status = flyby(MU_VENUS, turned(5.0, 0.0), turned(6.0, limit + deficit), RP_MIN)
+        self.assertEqual(status, TURN_LIMITED)
+        self.assertAlmostEqual(dv - above[1], 2 * 6.0 * math.sin(deficit / 2), delta=1e-7)
+
+    def test_rotation_round_trip(self):
+        # rotate_flybys turns v_inf_in by the unpowered angle at rp; solving
+        # the junction it produces recovers rp with no burn.
+        vinf_in = [4.0, -1.0, 0.5, 7.0, 2.0, -3.0]
+        rp = [8000.0, 20000.0]
+        beta = [0.4, -2.0]
+        vinf_out = [0.0] * 6
+        rotate_flybys(MU_VENUS, vinf_in, rp, beta, vinf_out)
+        for i in range(2):
+            v_in, v_out = vinf_in[3 * i:3 * i + 3], vinf_out[3 * i:3 * i + 3]
+            self.assertAlmostEqual(math.hypot(*v_out), math.hypot(*v_in), delta=1e-12)
+            rp_i, dv, status = flyby(MU_VENUS, v_in, v_out, RP_MIN)
+            self.assertEqual(status, FLYBY_OK)
+            self.assertAlmostEqual(rp_i, rp[i], delta=1e-6 * rp[i])
+            self.assertAlmostEqual(dv, 0.0, delta=1e-10)
+
+    def test_batch_matches_single(self):
+        vinf_in = [turned(4.0 + 0.1 * k, 0.05 * k) for k in range(40)]
+        vinf_out = [turned(5.0, 0.07 * k) for k in range(40)]
+        rp, dv, status = flyby_batch(MU_VENUS, vinf_in, vinf_out, RP_MIN, chunk_size=7)
+        self.assertIsInstance(rp, array)
+        for k in range(40):
+            self.assertEqual((rp[k], dv[k], status[k]), flyby(MU_VENUS, vinf_in[k], vinf_out[k], RP_MIN))
+        parallel = flyby_batch(MU_VENUS, vinf_in, vinf_out, RP_MIN, chunk_size=7, workers=2)
+        self.assertEqual([list(a) for a in parallel], [list(rp), list(dv), list(status)])
+
+    def test_batch_rejects_mismatched_inputs(self):
+        with self.assertRaises(ValueError):
+            flyby_batch(MU_VENUS, [turned(5.0, 0.0)], [turned(5.0, 0.1), turned(5.0, 0.2)], RP_MIN)
+
+if __name__ == "__main__":
+    unittest.main()
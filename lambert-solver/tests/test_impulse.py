@@ -0,0 +1,76 @@
+"""
+Three-impulse transfers: a midcourse burn beats the direct transfer for a
+plane change, not for a coplanar transfer, and the legs meet at the node.
+"""
+import math
+import unittest
+from impulse import MIN_SAVING, three_impulse, three_impulse_batch
+from kernel import kepler_miss
+from main import LambertSolver
+from sensitivity import norm
+
+MU_EARTH = 398600.4418
+HOUR = 3600.0
+
+def circular_state(radius, angle, inclination):
+    # Circular orbit inclined about the x-axis, at the given argument of latitude
+    speed = math.sqrt(MU_EARTH / radius)
+    ci, si = math.cos(inclination), math.sin(inclination)
+    r = [radius * math.cos(angle), radius * math.sin(angle) * ci, radius * math.sin(angle) * si]
+    v = [-speed * math.sin(angle), speed * math.cos(angle) * ci, speed * math.cos(angle) * si]
+    return r, v
+
+class ThreeImpulseTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_EARTH)
+        self.r1, self.v_start = circular_state(7000.0, 0.0, 0.0)
+
+    def assertLegsMeet(self, result, r2, v_end, dt):
+        v1, v_m_in, v_m_out, v2 = result.velocities
+        self.assertLess(kepler_miss(MU_EARTH, self.r1, v1, result.r_m, result.t_m), 1e-6)
+        self.assertLess(kepler_miss(MU_EARTH, result.r_m, v_m_out, r2, dt - result.t_m), 1e-6)
+        burns = [[v1[k] - self.v_start[k] for k in range(3)], [v_m_out[k] - v_m_in[k] for k in range(3)],
+                 [v_end[k] - v2[k] for k in range(3)]]
+        for burn, expected in zip(result.burns, burns):
+            for a, b in zip(burn, expected):
+                self.assertAlmostEqual(a, b, delta=1e-12)
+        self.assertAlmostEqual(result.dv, sum(norm(b) for b in burns), delta=1e-12)
+
+    def test_plane_change_improves(self):
+        r2, v_end = circular_state(7000.0, math.radians(120.0), math.radians(60.0))
+        result = three_impulse(self.solver, self.r1, self.v_start, r2, v_end, HOUR, heights=(0.0, 0.5))
+        self.assertTrue(result.improved)
+        self.assertGreater(result.saving, MIN_SAVING)
+        self.assertLegsMeet(result, r2, v_end, HOUR)
+
+    def test_coplanar_does_not_improve(self):
+        # The direct arc is stationary: a node on it costs nothing extra and
+        # saves nothing
+        r2, v_end = circular_state(7000.0, math.radians(120.0), 0.0)
+        result = three_impulse(self.solver, self.r1, self.v_start, r2, v_end, HOUR)
+        self.assertFalse(result.improved)
+        self.assertGreater(result.saving, -1e-6)
+        self.assertLessEqual(result.saving, MIN_SAVING)
+        self.assertLegsMeet(result, r2, v_end, HOUR)
+
+    def test_batch(self):
+        problems = []
+        for inclination in (0.0, 0.5, 1.0):
+            r2, v_end = circular_state(7000.0, math.radians(120.0), inclination)
+            problems.append((self.r1, self.v_start, r2, v_end, HOUR))
+        reference = three_impulse_batch(self.solver, problems, chunk_size=2)
+        for (r1, v_start, r2, v_end, dt), result in zip(problems, reference):
+            single = three_impulse(self.solver, r1, v_start, r2, v_end, dt)
+            self.assertEqual((result.dv, result.t_m), (single.dv, single.t_m))
+        parallel = three_impulse_batch(self.solver, problems, chunk_size=2, workers=2)
+        self.assertEqual([r.dv for r in parallel], [r.dv for r in reference])
+
+    def test_collinear_rejected(self):
+        r2 = [-7000.0, 0.0, 0.0]
+        with self.assertRaises(ValueError):
+            three_impulse(self.solver, self.r1, self.v_start, r2, [0.0, -7.5, 0.0], HOUR)
+        self.assertEqual(three_impulse_batch(self.solver, [(self.r1, self.v_start, r2, [0.0, -7.5, 0.0], HOUR)]),
+                         [None])
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,157 @@
+"""
+Lane kernel: regime buckets, fused metrics and the analytic self-check.
+"""
+import math
+import unittest
+from main import LambertSolver, orbital_energy, propagate_orbit, parabolic_transfer_time, vector_cross, vector_norm, vector_subtract
+from batch import solve_batch, solve_batch_arrays
+from benchmark import leo_geo_problems
+from kernel import (CHECK_FAILED, DEGENERATE, ELLIPTIC, ELLIPTIC_FAST, ELLIPTIC_LONG, ELLIPTIC_SLOW, HYPERBOLIC, NEAR_PI,
+                    METRIC_COUNT, METRIC_FIELDS, classify, kepler_miss, lane_metrics,
+                    status_message)
+
+MU_EARTH = 398600.4418
+
+def position(radius, angle):
+    return [radius * math.cos(angle), radius * math.sin(angle), 0.0]
+
+def circular_velocity(r):
+    speed = math.sqrt(MU_EARTH / vector_norm(r))
+    return [-r[1] / vector_norm(r) * speed, r[0] / vector_norm(r) * speed, 0.0]
+
+class ClassifyTest(unittest.TestCase):
+    def setUp(self):
+        self.r1 = position(7000.0, 0.0)
+        self.r2 = position(12000.0, 2.0)
+        self.tp = parabolic_transfer_time(self.r1, self.r2, MU_EARTH)
+
+    def bucket(self, ratio, r2=None, clockwise=False):
+        r2 = self.r2 if r2 is None else r2
+        tp = parabolic_transfer_time(self.r1, r2, MU_EARTH, clockwise)
+        return classify(MU_EARTH, self.r1, r2, ratio * tp, clockwise)
+
+    def test_time_of_flight_edges(self):
+        # Bucket edges at 1, 2, 10 and 30 parabolic times
+        for ratio, bucket in ((0.999, HYPERBOLIC), (1.001, ELLIPTIC_FAST), (1.999, ELLIPTIC_FAST),
+                              (2.001, ELLIPTIC), (9.999, ELLIPTIC), (10.001, ELLIPTIC_SLOW),
+                              (29.999, ELLIPTIC_SLOW), (30.001, ELLIPTIC_LONG)):
+            self.assertEqual(self.bucket(ratio)[0], bucket, ratio)
+
+    def test_angle_edges(self):
+        self.assertEqual(self.bucket(3.0, position(12000.0, 0.0))[0], DEGENERATE)
+        self.assertEqual(self.bucket(3.0, position(12000.0, math.pi))[0], DEGENERATE)
+        self.assertEqual(self.bucket(3.0, position(12000.0, math.pi - 5e-4))[0], NEAR_PI)
+        self.assertEqual(self.bucket(3.0, position(12000.0, math.pi - 2e-3))[0], ELLIPTIC)
+        # Near zero degrees is not near 180
+        self.assertEqual(self.bucket(3.0, position(12000.0, 5e-4))[0], ELLIPTIC)
+
+    def test_long_way(self):
+        self.assertFalse(self.bucket(3.0)[1])
+        self.assertTrue(self.bucket(3.0, clockwise=True)[1])
+        self.assertTrue(self.bucket(3.0, position(12000.0, -2.0))[1])
+
+class BucketingTest(unittest.TestCase):
+    def test_bucketed_batch_matches_unbucketed(self):
+        solver = LambertSolver(MU_EARTH)
+        problems = leo_geo_problems(300, seed=6)
+        buckets = {classify(MU_EARTH, r1, r2, dt)[0] for r1, r2, dt in problems}
+        self.assertGreaterEqual(len(buckets), 3)
+        bucketed = solve_batch(solver, problems, chunk_size=64, escalation=False)
+        plain = solve_batch(solver, problems, chunk_size=64, bucketing=False, escalation=False)
+        self.assertEqual(bucketed.failures(), 0)
+        plain_misses = 0
+        for k, (r1, r2, dt) in enumerate(problems):
+            self.assertLess(kepler_miss(MU_EARTH, r1, bucketed.v1[k], r2, dt), 1e-8)
+            # From z = 0 Newton often stalls or lands on a wrong root of slow transfers
+            if not plain.succeeded(k) or not kepler_miss(MU_EARTH, r1, plain.v1[k], r2, dt) < 1e-6:
+                plain_misses += 1
+                continue
+            for a, b in zip(bucketed.v1[k], plain.v1[k]):
+                self.assertAlmostEqual(a, b, delta=1e-7)
+        self.assertGreater(plain_misses, 0)
+class MetricsTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_EARTH)
+        self.problems = leo_geo_problems(20, seed=4)
+        # Circular-orbit body velocities at both ends
+        self.velocities = [(circular_velocity(r1), circular_velocity(r2)) for r1, r2, _ in self.problems]
+
+    def test_fused_metrics_match_separate(self):
+        result = solve_batch(self.solver, self.problems, metrics=True, body_velocities=self.velocities)
+        for k, (r1, r2, _) in enumerate(self.problems):
+            v1, v2 = result.v1[k], result.v2[k]
+            vb1, vb2 = self.velocities[k]
+            metrics = result.metrics[k]
+            energy = orbital_energy(r1, v1, MU_EARTH)
+            h = vector_cross(r1, v1)
+            vinf1 = vector_norm(vector_subtract(v1, vb1))
+            vinf2 = vector_norm(vector_subtract(v2, vb2))
+            expected = {'energy': energy, 'c3': vinf1**2, 'vinf1': vinf1, 'vinf2': vinf2, 'dv': vinf1 + vinf2,
+                        'a': -MU_EARTH / (2 * energy),
+                        'e': math.sqrt(max(1 + 2 * energy * vector_norm(h)**2 / MU_EARTH**2, 0.0)),
+                        'inclination': math.acos(h[2] / vector_norm(h))}
+            for name in METRIC_FIELDS:
+                self.assertAlmostEqual(metrics[name], expected[name], delta=1e-9 * max(1.0, abs(expected[name])),
+                                       msg=name)
+            self.assertEqual(tuple(metrics[name] for name in METRIC_FIELDS),
+                             lane_metrics(MU_EARTH, r1, v1, r2, v2, vb1, vb2))
+
+    def test_nan_without_body_velocities(self):
+        r1, r2, dt = self.problems[0]
+        result = solve_batch(self.solver, [(r1, r2, dt)], metrics=True)
+        metrics = result.metrics[0]
+        for name in ('c3', 'vinf1', 'vinf2', 'dv'):
+            self.assertTrue(math.isnan(metrics[name]), name)
+        for name in ('energy', 'a', 'e', 'inclination'):
+            self.assertFalse(math.isnan(metrics[name]), name)
+        vb1, vb2 = self.velocities[0]
+        only_departure = lane_metrics(MU_EARTH, r1, result.v1[0], r2, result.v2[0], vb1, None)
+        self.assertFalse(math.isnan(only_departure[METRIC_FIELDS.index('c3')]))
+        self.assertTrue(math.isnan(only_departure[METRIC_FIELDS.index('vinf2')]))
+        self.assertTrue(math.isnan(only_departure[METRIC_FIELDS.index('dv')]))
+
+    def test_array_metrics_match_batch(self):
+        result = solve_batch(self.solver, self.problems, metrics=True, body_velocities=self.velocities)
+        flat = lambda rows: [x for row in rows for x in row]
+        _, _, _, metrics = solve_batch_arrays(
+            self.solver, flat(p[0] for p in self.problems), flat(p[1] for p in self.problems),
+            [p[2] for p in self.problems], vb1=flat(v[0] for v in self.velocities),
+            vb2=flat(v[1] for v in self.velocities), metrics=True, chunk_size=6)
+        for k in range(len(self.problems)):
+            self.assertEqual(list(metrics[METRIC_COUNT * k:METRIC_COUNT * (k + 1)]),
+                             [result.metrics[k][name] for name in METRIC_FIELDS])
+class SelfCheckTest(unittest.TestCase):
+    def test_circular_quarter_orbit(self):
+        r1 = position(7000.0, 0.0)
+        v1 = circular_velocity(r1)
+        quarter = math.pi / 2 * math.sqrt(7000.0**3 / MU_EARTH)
+        r2 = position(7000.0, math.pi / 2)
+        self.assertLess(kepler_miss(MU_EARTH, r1, v1, r2, quarter), 1e-12)
+        self.assertLess(kepler_miss(MU_EARTH, r1, v1, r2, quarter, v2=circular_velocity(r2)), 1e-12)
+        self.assertGreater(kepler_miss(MU_EARTH, r1, [x * (1 + 1e-4) for x in v1], r2, quarter), 1e-5)
+
+    def test_hyperbola_against_rk4(self):
+        r1 = position(7000.0, 0.3)
+        v1 = [x * 1.6 for x in circular_velocity(r1)]
+        r2, _ = propagate_orbit(r1, v1, 5000.0, MU_EARTH, num_steps=20000)
+        self.assertLess(kepler_miss(MU_EARTH, r1, v1, r2, 5000.0), 1e-9)
+
+    def test_check_fails_wrong_roots(self):
+        # The unbucketed kernel without escalation lands on wrong roots for some
+        # slow transfers; with check= those lanes fail instead of returning garbage
+        solver = LambertSolver(MU_EARTH)
+        problems = leo_geo_problems(300, seed=6)
+        plain = solve_batch(solver, problems, bucketing=False, escalation=False)
+        checked = solve_batch(solver, problems, bucketing=False, escalation=False, check=1e-6)
+        check_failures = 0
+        for k, (r1, r2, dt) in enumerate(problems):
+            if checked.succeeded(k):
+                self.assertLess(kepler_miss(MU_EARTH, r1, checked.v1[k], r2, dt), 1e-6)
+            elif checked.errors[k] == status_message(CHECK_FAILED, 1000):
+                check_failures += 1
+                self.assertTrue(plain.succeeded(k))
+        self.assertGreater(check_failures, 0)
+        self.assertEqual(solve_batch(solver, problems, check=1e-6).failures(), 0)
+
+if __name__ == "__main__":
+    unittest.main()
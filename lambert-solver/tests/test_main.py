@@ -0,0 +1,69 @@
+"""
+LambertSolver.solve and the batch lane kernel against published solutions.
+
+Run from lambert-solver/: python -m unittest discover tests
+"""
+import math
+import unittest
+from main import LambertSolver, solve_in_plane
+from batch import solve_batch
+
+MU_EARTH = 398600.0
+
+# Curtis, Orbital Mechanics for Engineering Students, Example 5.2
+CURTIS_5_2 = ([5000.0, 10000.0, 2100.0], [-14600.0, 2500.0, 7000.0], 3600.0)
+CURTIS_5_2_V1 = [-5.9925, 1.9254, 3.2456]
+CURTIS_5_2_V2 = [-3.3125, -4.1966, -0.38529]
+
+class LambertSolverTest(unittest.TestCase):
+    def assertVector(self, v, expected, places):
+        for a, b in zip(v, expected):
+            self.assertAlmostEqual(a, b, places=places)
+
+    def test_curtis_example(self):
+        v1, v2 = LambertSolver(MU_EARTH).solve(*CURTIS_5_2)
+        self.assertVector(v1, CURTIS_5_2_V1, 4)
+        self.assertVector(v2, CURTIS_5_2_V2, 4)
+
+    def test_lane_kernel_matches_solver(self):
+        v1, v2 = LambertSolver(MU_EARTH).solve(*CURTIS_5_2)
+        result = solve_batch(LambertSolver(MU_EARTH), [CURTIS_5_2])
+        self.assertVector(result.v1[0], v1, 10)
+        self.assertVector(result.v2[0], v2, 10)
+class TransferPlaneTest(unittest.TestCase):
+    def test_hohmann_at_180_degrees(self):
+        # Half a period of the Hohmann ellipse between collinear r1 and r2 gives
+        # tangential vis-viva speeds at perigee and apogee
+        r1, r2 = 6678.0, 42164.0
+        a = (r1 + r2) / 2
+        dt = math.pi * math.sqrt(a**3 / MU_EARTH)
+        v1, v2 = solve_in_plane(MU_EARTH, [r1, 0.0, 0.0], [-r2, 0.0, 0.0], dt, [0.0, 0.0, 1.0])
+        vp = math.sqrt(MU_EARTH * (2 / r1 - 1 / a))
+        va = math.sqrt(MU_EARTH * (2 / r2 - 1 / a))
+        for x, y in zip(v1 + v2, [0.0, vp, 0.0, 0.0, -va, 0.0]):
+            self.assertAlmostEqual(x, y, places=8)
+
+    def test_plane_normal_sets_direction(self):
+        r1, r2, dt = [6678.0, 0.0, 0.0], [-42164.0, 0.0, 0.0], 5 * 3600.0
+        v1, _ = solve_in_plane(MU_EARTH, r1, r2, dt, [0.0, 0.0, 1.0])
+        w1, _ = solve_in_plane(MU_EARTH, r1, r2, dt, [0.0, 0.0, 1.0], clockwise=True)
+        u1, _ = solve_in_plane(MU_EARTH, r1, r2, dt, [0.0, 1.0, 0.0])
+        self.assertGreater(v1[1], 0)
+        self.assertAlmostEqual(w1[1], -v1[1], places=9)
+        self.assertAlmostEqual(u1[2], -v1[1], places=9)
+        with self.assertRaises(ValueError):
+            solve_in_plane(MU_EARTH, r1, [0.0, 42164.0, 100.0], dt, [0.0, 0.0, 1.0])
+
+    def test_collinear_through_solver_and_batch(self):
+        solver = LambertSolver(MU_EARTH)
+        r1, r2, dt = [6671.0, 0.0, 0.0], [-42157.0, 0.0, 0.0], 5 * 3600.0
+        with self.assertRaises(ValueError):
+            solver.solve(r1, r2, dt)
+        v1, v2 = solver.leo_to_geo(dt)
+        result = solve_batch(solver, [(r1, r2, dt, False, [0.0, 0.0, 1.0])])
+        self.assertTrue(result.succeeded(0))
+        for x, y in zip(result.v1[0] + result.v2[0], v1 + v2):
+            self.assertAlmostEqual(x, y, places=9)
+
+if __name__ == "__main__":
+    unittest.main()
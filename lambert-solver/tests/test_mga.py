@@ -0,0 +1,118 @@
+"""
+MGA search: the default leg cache shares legs across sequences without
+changing the result, stays within its bound and serves concurrent requests.
+"""
+import threading
+import time
+import unittest
+from unittest import mock
+import mga
+from ephemeris import CircularOrbit
+from flyby import min_periapsis
+from main import LambertSolver
+from mga import LegCache, evaluate_sequence, search, snap_times, solve_legs
+from tisserand import TisserandGraph
+
+MU_SUN = 1.32712440018e11
+AU = 1.495978707e8
+DAY = 86400.0
+
+class CountingSolve:
+    """solve_legs that records how many legs it was asked for."""
+    def __init__(self):
+        self.legs = 0
+
+    def __call__(self, solver, ephemerides, legs, workers=1, placement=None):
+        self.legs += len(legs)
+        return solve_legs(solver, ephemerides, legs, workers, placement)
+
+class MgaTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_SUN)
+        self.ephemerides = {'earth': CircularOrbit(AU, MU_SUN),
+                            'venus': CircularOrbit(0.723 * AU, MU_SUN, phase=1.2),
+                            'mars': CircularOrbit(1.524 * AU, MU_SUN, phase=0.6)}
+        # Whole hours, so snapping to the default quantum changes nothing
+        tofs = [k * 40 * DAY for k in range(3, 9)]
+        self.tof_choices = {(p, q): tofs for p in self.ephemerides for q in self.ephemerides}
+        self.rp_min = {name: min_periapsis(name) for name in self.ephemerides}
+        self.launch_epochs = [k * 30 * DAY for k in range(4)]
+
+    def search(self, legs=None, max_flybys=1):
+        return search(self.solver, self.ephemerides, TisserandGraph(), 'earth', 'mars', ['venus', 'earth'],
+                      max_flybys, self.launch_epochs, self.tof_choices, self.rp_min, vinf_launch=6.0, legs=legs)
+
+    def test_cache_is_the_default(self):
+        with mock.patch.object(mga, 'LegCache', wraps=LegCache) as cache:
+            cached = self.search()
+        cache.assert_called_once_with()
+        exact = self.search(legs=solve_legs)
+        self.assertEqual([p.sequence for p in cached], [p.sequence for p in exact])
+        for a, b in zip(cached, exact):
+            self.assertAlmostEqual(a.cost, b.cost, places=12)
+            self.assertEqual(a.epochs, b.epochs)
+
+    def test_sequences_share_legs(self):
+        solve = CountingSolve()
+        cache = LegCache(solve=solve)
+        # E-V-M and E-V-E-M share their first legs
+        paths = self.search(legs=cache, max_flybys=2)
+        self.assertGreater(len(paths), 1)
+        self.assertGreater(cache.hits, 0)
+        self.assertEqual(solve.legs, cache.misses)
+        self.assertEqual(len(cache.entries), cache.misses)
+        self.assertIn("0 evicted", cache.report())
+
+    def test_bound_evicts_least_recently_used(self):
+        solve = CountingSolve()
+        cache = LegCache(solve=solve, max_entries=2)
+        a, b, c = (('earth', 'mars', 0.0, tof * DAY) for tof in (200, 240, 280))
+        reference = solve_legs(self.solver, self.ephemerides, [a, b, c])
+        cache(self.solver, self.ephemerides, [a, b])
+        cache(self.solver, self.ephemerides, [a])
+        cache(self.solver, self.ephemerides, [c])
+        self.assertEqual(list(cache.entries), [cache.key(*a), cache.key(*c)])
+        self.assertEqual(cache.evictions, 1)
+        self.assertEqual(cache(self.solver, self.ephemerides, [b]), [reference[1]])
+        self.assertEqual(solve.legs, 4)
+        # A request larger than the bound still gets every leg
+        self.assertEqual(cache(self.solver, self.ephemerides, [a, b, c]), reference)
+        self.assertLessEqual(len(cache.entries), 2)
+
+    def test_concurrent_requests_solve_once(self):
+        started = threading.Event()
+        release = threading.Event()
+
+        def slow(solver, ephemerides, legs, workers=1, placement=None):
+            started.set()
+            release.wait()
+            return solve_legs(solver, ephemerides, legs, workers, placement)
+
+        cache = LegCache(solve=slow)
+        leg = ('earth', 'mars', 0.0, 200 * DAY)
+        results = []
+        first = threading.Thread(target=lambda: results.append(cache(self.solver, self.ephemerides, [leg])))
+        first.start()
+        started.wait()
+        second = threading.Thread(target=lambda: results.append(cache(self.solver, self.ephemerides, [leg])))
+        second.start()
+        # Hold the first solve until the second request is waiting on it
+        deadline = time.monotonic() + 10.0
+        while cache.waits == 0 and time.monotonic() < deadline:
+            time.sleep(0.001)
+        release.set()
+        first.join()
+        second.join()
+        self.assertEqual((cache.misses, cache.waits), (1, 1))
+        self.assertEqual(results[0], results[1])
+
+    def test_snapped_epochs_stay_on_the_grid(self):
+        cache = LegCache()
+        self.assertEqual(snap_times(cache, [0.0, 1000.0, 2000.0, 7100.0]), [0.0, 3600.0, 7200.0])
+        self.assertEqual(snap_times(solve_legs, [1000.0, 1000.0]), [1000.0, 1000.0])
+        path = evaluate_sequence(self.solver, self.ephemerides, ('earth', 'venus', 'mars'), [1000.0],
+                                 [[100 * DAY + 900.0], [150 * DAY - 900.0]], self.rp_min, legs=cache)
+        self.assertEqual(path.epochs, [0.0, 100 * DAY, 250 * DAY])
+
+if __name__ == "__main__":
+    unittest.main()
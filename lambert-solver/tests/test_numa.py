@@ -0,0 +1,109 @@
+"""
+NUMA placement gives the same results as unplaced runs, streams chunks with a
+bounded window per node, keeps its pools until close() and reports the CPU
+affinity the workers really had.
+"""
+import os
+import unittest
+import numa
+from batch import solve_batch
+from benchmark import leo_geo_problems
+from ephemeris import CircularOrbit, EphemerisTable
+from main import LambertSolver
+from numa import NumaPlacement, Replica, _format_cpus, _parse_cpulist
+from sweep import porkchop_sweep
+
+MU_EARTH = 398600.4418
+MU_SUN = 1.32712440018e11
+AU = 1.495978707e8
+DAY = 86400.0
+
+def square(x):
+    return x * x
+
+def fail_on(x, bad):
+    if x == bad:
+        raise ValueError(x)
+    return x
+
+class NumaPlacementTest(unittest.TestCase):
+    def setUp(self):
+        # Two nodes sharing the CPUs this process may use, as on a one-node machine
+        cpus = sorted(os.sched_getaffinity(0))
+        self.placement = NumaPlacement(nodes={0: cpus, 1: cpus}, workers_per_node=2)
+        self.addCleanup(self.placement.close)
+
+    def test_solve_batch_matches_unplaced(self):
+        solver = LambertSolver(MU_EARTH)
+        problems = leo_geo_problems(120, seed=4)
+        reference = solve_batch(solver, problems, chunk_size=16)
+        result = solve_batch(solver, problems, chunk_size=16, placement=self.placement)
+        self.assertEqual(result.v1, reference.v1)
+        self.assertEqual(result.v2, reference.v2)
+        self.assertEqual(sum(self.placement.assignment.values()), 8)
+        self.assertEqual(set(self.placement.assignment), {0, 1})
+
+    def test_sweep_with_replicas(self):
+        earth = CircularOrbit(AU, MU_SUN)
+        mars = CircularOrbit(1.524 * AU, MU_SUN, phase=0.8)
+        departure_times = [k * 10 * DAY for k in range(8)]
+        tofs = [150 * DAY + k * 20 * DAY for k in range(8)]
+        tables = {name: EphemerisTable(body, 0.0, 400 * DAY, DAY) for name, body in (('earth', earth),
+                                                                                       ('mars', mars))}
+        solver = LambertSolver(MU_SUN)
+        reference = porkchop_sweep(solver, tables['earth'], tables['mars'], departure_times, tofs, chunk_size=5)
+        with NumaPlacement(nodes=self.placement.nodes, workers_per_node=1, replicas=tables) as placement:
+            result = porkchop_sweep(solver, Replica('earth'), Replica('mars'), departure_times, tofs,
+                                    chunk_size=5, placement=placement)
+        self.assertEqual(result.dv, reference.dv)
+        self.assertEqual(result.best, reference.best)
+
+    def test_imap_is_lazy(self):
+        consumed = []
+
+        def chunk_args():
+            for k in range(100):
+                consumed.append(k)
+                yield (k,)
+
+        results = self.placement.imap(square, chunk_args())
+        self.assertEqual(next(results), 0)
+        # Two nodes of two workers, LOOKAHEAD chunks each, plus the one about to be submitted
+        self.assertLessEqual(len(consumed), 2 * 2 * numa.LOOKAHEAD + 1)
+        self.assertEqual(list(results), [k * k for k in range(1, 100)])
+        self.assertEqual(len(consumed), 100)
+
+    def test_errors_propagate(self):
+        with self.assertRaises(ValueError):
+            self.placement.map(fail_on, [(k, 7) for k in range(20)])
+        # The pools survive a failed chunk
+        self.assertEqual(self.placement.map(square, [(k,) for k in range(5)]), [0, 1, 4, 9, 16])
+
+    def test_pools_persist_until_close(self):
+        self.placement.map(square, [(k,) for k in range(8)])
+        executors = dict(self.placement.executors)
+        self.placement.map(square, [(k,) for k in range(8)])
+        self.assertEqual(self.placement.executors, executors)
+        self.placement.close()
+        self.assertEqual(self.placement.executors, {})
+        self.assertEqual(self.placement.map(square, [(3,)]), [9])
+
+    def test_report_shows_real_affinity(self):
+        self.placement.map(square, [(k,) for k in range(16)])
+        allowed = set(os.sched_getaffinity(0))
+        for node in (0, 1):
+            seen = self.placement.affinity[node]
+            self.assertTrue(seen)
+            for cpus in seen.values():
+                self.assertLessEqual(set(cpus), allowed)
+        report = self.placement.report()
+        self.assertIn("NUMA nodes: 2", report)
+        self.assertIn("workers seen", report)
+
+class CpuListTest(unittest.TestCase):
+    def test_round_trip(self):
+        self.assertEqual(_parse_cpulist("0-3,8,10-11\n"), [0, 1, 2, 3, 8, 10, 11])
+        self.assertEqual(_format_cpus([0, 1, 2, 3, 8, 10, 11]), "0-3,8,10-11")
+
+if __name__ == "__main__":
+    unittest.main()
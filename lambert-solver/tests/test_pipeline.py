@@ -0,0 +1,109 @@
+"""
+Pipeline runs deliver every item in order, and a failure anywhere (source,
+process or finish) is re-raised from run() without leaving stages blocked.
+"""
+import os
+import shutil
+import tempfile
+import threading
+import unittest
+from ephemeris import CircularOrbit
+from main import LambertSolver
+from pipeline import (CsvSink, DeltaVStage, EphemerisStage, FilterStage, LambertStage, ListSink, Pipeline, Stage,
+                      grid_source)
+from sweep import porkchop_sweep
+
+MU_SUN = 1.32712440018e11
+AU = 1.495978707e8
+DAY = 86400.0
+
+class FailingProcess(Stage):
+    def process(self, batch):
+        raise ValueError("process")
+
+class FailingFinish(Stage):
+    def finish(self):
+        raise RuntimeError("finish")
+
+class FailingCsvSink(CsvSink):
+    def process(self, batch):
+        super().process(batch)
+        raise OSError("disk full")
+
+def items(count):
+    return ({'t0': k, 'tof': 1.0} for k in range(count))
+
+def failing_source():
+    yield {'t0': 0, 'tof': 1.0}
+    raise KeyError("source")
+
+class PipelineTest(unittest.TestCase):
+    def run_pipeline(self, pipeline, source, timeout=30.0):
+        """pipeline.run(source) in a thread; fails the test if it hangs."""
+        outcome = {}
+        def target():
+            try:
+                outcome['result'] = pipeline.run(source)
+            except BaseException as e:
+                outcome['error'] = e
+        thread = threading.Thread(target=target, daemon=True)
+        thread.start()
+        thread.join(timeout)
+        self.assertFalse(thread.is_alive(), "pipeline did not finish")
+        if 'error' in outcome:
+            raise outcome['error']
+        return outcome['result']
+
+    def test_items_in_order(self):
+        pipeline = Pipeline([Stage(), FilterStage(lambda item: item['t0'] % 3), ListSink(['t0'])],
+                            batch_size=7, queue_size=1)
+        result = self.run_pipeline(pipeline, items(100))
+        self.assertEqual([item['t0'] for item in result], [k for k in range(100) if k % 3])
+
+    def test_grid_source(self):
+        result = self.run_pipeline(Pipeline([ListSink()]), grid_source([0, 1], [10, 20, 30]))
+        self.assertEqual([(item['t0'], item['tof']) for item in result],
+                         [(0, 10), (0, 20), (0, 30), (1, 10), (1, 20), (1, 30)])
+
+    def test_transfer_stages_match_sweep(self):
+        earth = CircularOrbit(AU, MU_SUN)
+        mars = CircularOrbit(1.524 * AU, MU_SUN, phase=0.8, inclination=0.032)
+        departure_times = [k * 20 * DAY for k in range(5)]
+        tofs = [150 * DAY + k * 30 * DAY for k in range(5)]
+        solver = LambertSolver(MU_SUN)
+        pipeline = Pipeline([EphemerisStage(earth, mars), LambertStage(solver), DeltaVStage(),
+                             ListSink(['t0', 'tof', 'dv'])], batch_size=6)
+        items = self.run_pipeline(pipeline, grid_source(departure_times, tofs))
+        sweep = porkchop_sweep(solver, earth, mars, departure_times, tofs)
+        self.assertEqual(len(items), 25)
+        for k, item in enumerate(items):
+            self.assertAlmostEqual(item['dv'], sweep.dv[k // 5][k % 5], places=9)
+
+    def test_process_error(self):
+        for stages in ([FailingProcess(), ListSink()], [Stage(), FailingProcess(), Stage()]):
+            with self.assertRaises(ValueError):
+                self.run_pipeline(Pipeline(stages, batch_size=3, queue_size=1), items(100))
+
+    def test_finish_error(self):
+        for stages in ([FailingFinish(), ListSink()], [Stage(), FailingFinish()]):
+            with self.assertRaises(RuntimeError):
+                self.run_pipeline(Pipeline(stages, batch_size=3, queue_size=1), items(100))
+
+    def test_source_error(self):
+        with self.assertRaises(KeyError):
+            self.run_pipeline(Pipeline([Stage(), ListSink()]), failing_source())
+
+    def test_csv_sink(self):
+        directory = tempfile.mkdtemp()
+        self.addCleanup(shutil.rmtree, directory)
+        path = os.path.join(directory, 'out.csv')
+        self.assertEqual(self.run_pipeline(Pipeline([CsvSink(path, ['t0'])], batch_size=4), items(10)), 10)
+        with open(path) as f:
+            self.assertEqual(f.read().split(), ['t0'] + [str(k) for k in range(10)])
+        sink = FailingCsvSink(path, ['t0'])
+        with self.assertRaises(OSError):
+            self.run_pipeline(Pipeline([sink]), items(10))
+        self.assertTrue(sink.file.closed)
+
+if __name__ == "__main__":
+    unittest.main()
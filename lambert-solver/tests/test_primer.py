@@ -0,0 +1,109 @@
+"""
+Primer-vector check: a known non-optimal plane-change transfer is flagged,
+coplanar transfers pass, and the primer meets the arrival burn direction.
+"""
+import math
+import unittest
+from impulse import three_impulse
+from main import LambertSolver
+from primer import _primer, primer_batch, primer_check
+from sensitivity import kepler_stm, norm
+
+MU_EARTH = 398600.4418
+HOUR = 3600.0
+
+def circular_state(radius, angle, inclination):
+    # Circular orbit inclined about the x-axis, at the given argument of latitude
+    speed = math.sqrt(MU_EARTH / radius)
+    ci, si = math.cos(inclination), math.sin(inclination)
+    r = [radius * math.cos(angle), radius * math.sin(angle) * ci, radius * math.sin(angle) * si]
+    v = [-speed * math.sin(angle), speed * math.cos(angle) * ci, speed * math.cos(angle) * si]
+    return r, v
+
+def transfer_time(r1, r2, angle):
+    # The transfer angle over the mean motion of the Hohmann ellipse between the radii
+    return math.sqrt(((r1 + r2) / 2)**3 / MU_EARTH) * angle
+
+def solve_pdot(phi, p0, pf):
+    # p'(0) = Phi_rv^-1 (pf - Phi_rr p0) by Gaussian elimination
+    a = [[phi[i][3 + j] for j in range(3)] + [pf[i] - sum(phi[i][j] * p0[j] for j in range(3))] for i in range(3)]
+    for c in range(3):
+        pivot = max(range(c, 3), key=lambda r: abs(a[r][c]))
+        a[c], a[pivot] = a[pivot], a[c]
+        for r in range(3):
+            if r != c:
+                f = a[r][c] / a[c][c]
+                a[r] = [x - f * y for x, y in zip(a[r], a[c])]
+    return [a[i][3] / a[i][i] for i in range(3)]
+
+class PrimerTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_EARTH)
+        self.r1, self.v_start = circular_state(7000.0, 0.0, 0.0)
+
+    def check(self, r2, v_end, dt):
+        v1, v2 = self.solver.solve(self.r1, r2, dt)
+        return primer_check(MU_EARTH, self.r1, v1, v2, dt, self.v_start, v_end)
+
+    def test_flags_plane_change(self):
+        # A 60 degree plane change in one hour: a midcourse burn saves Δv
+        r2, v_end = circular_state(7000.0, math.radians(120.0), math.radians(60.0))
+        check = self.check(r2, v_end, HOUR)
+        self.assertFalse(check.optimal)
+        self.assertGreater(check.max_magnitude, 1.4)
+        self.assertTrue(0 < check.t_max < HOUR)
+        self.assertIsNotNone(check.r_max)
+        self.assertAlmostEqual(norm(check.direction), 1.0, delta=1e-12)
+        self.assertTrue(check.initial_coast)
+        self.assertTrue(three_impulse(self.solver, self.r1, self.v_start, r2, v_end, HOUR,
+                                      heights=(0.0, 0.5)).improved)
+
+    def test_coplanar_transfers_pass(self):
+        for radius, degrees in ((8000.0, 120.0), (10000.0, 150.0), (10000.0, 170.0), (42164.0, 160.0)):
+            angle = math.radians(degrees)
+            r2, v_end = circular_state(radius, angle, 0.0)
+            check = self.check(r2, v_end, transfer_time(7000.0, radius, angle))
+            self.assertTrue(check.optimal, (radius, degrees))
+            self.assertLessEqual(max(check.magnitudes), 1.0 + 1e-6)
+            self.assertIsNone(check.r_max)
+            self.assertFalse(check.initial_coast or check.final_coast)
+
+    def test_primer_meets_arrival_direction(self):
+        # p'(0) solved from the STM at dt, propagated by _primer, ends on the
+        # arrival burn direction
+        r2, v_end = circular_state(9000.0, math.radians(100.0), math.radians(20.0))
+        v1, v2 = self.solver.solve(self.r1, r2, HOUR)
+        burn = [v1[k] - self.v_start[k] for k in range(3)]
+        p0 = [c / norm(burn) for c in burn]
+        burn = [v_end[k] - v2[k] for k in range(3)]
+        pf = [c / norm(burn) for c in burn]
+        _, _, phi, _ = kepler_stm(MU_EARTH, self.r1, v1, HOUR)
+        p, _, r, _ = _primer(MU_EARTH, self.r1, v1, HOUR, p0, solve_pdot(phi, p0, pf), None)
+        for a, b in zip(p, pf):
+            self.assertAlmostEqual(a, b, delta=1e-9)
+        for a, b in zip(r, r2):
+            self.assertAlmostEqual(a, b, delta=1e-6)
+
+    def test_zero_burn_rejected(self):
+        r2, v_end = circular_state(9000.0, math.radians(100.0), 0.0)
+        v1, v2 = self.solver.solve(self.r1, r2, HOUR)
+        with self.assertRaises(ValueError):
+            primer_check(MU_EARTH, self.r1, v1, v2, HOUR, v1, v_end)
+
+    def test_batch(self):
+        problems = []
+        for inclination in (0.0, 0.5, 1.0):
+            r2, v_end = circular_state(7000.0, math.radians(120.0), inclination)
+            problems.append((self.r1, self.v_start, r2, v_end, HOUR))
+        r2 = [-7000.0, 0.0, 0.0]
+        problems.append((self.r1, self.v_start, r2, [0.0, -7.5, 0.0], HOUR))
+        reference = primer_batch(self.solver, problems, chunk_size=2)
+        self.assertIsNone(reference[-1])
+        for (r1, v_start, r2, v_end, dt), check in zip(problems, reference[:-1]):
+            self.assertEqual(check.max_magnitude, self.check(r2, v_end, dt).max_magnitude)
+        self.assertEqual([c.optimal for c in reference[:-1]], [True, False, False])
+        parallel = primer_batch(self.solver, problems, chunk_size=2, workers=2)
+        self.assertEqual([c and c.magnitudes for c in parallel], [c and c.magnitudes for c in reference])
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,102 @@
+"""
+Linearized rendezvous: CW agrees with the elliptic model for a circular
+target, both reach the offset under full two-body motion, and rendezvous
+routes queries to the right model.
+"""
+import math
+import unittest
+from main import LambertSolver
+from relative import (cw_transfer, elliptic_transfer, from_relative, rendezvous, rendezvous_batch,
+                      to_relative)
+from sensitivity import kepler
+
+MU_EARTH = 398600.4418
+
+def target_state(eccentricity, periapsis=6778.0):
+    # At periapsis on the x-axis, moving along +y with a slight inclination
+    speed = math.sqrt(MU_EARTH * (1 + eccentricity) / periapsis)
+    return [periapsis, 0.0, 0.0], [0.0, speed * math.cos(0.5), speed * math.sin(0.5)]
+
+def arrival_offset(target_r, target_v, chaser_r, chaser_v, transfer, dt):
+    # Propagate both spacecraft with full two-body motion after the first burn
+    v1 = [chaser_v[k] + transfer.dv1[k] for k in range(3)]
+    target_r2, target_v2, _, _, _ = kepler(MU_EARTH, target_r, target_v, dt)
+    r2, v2, _, _, _ = kepler(MU_EARTH, chaser_r, v1, dt)
+    return to_relative(target_r2, target_v2, r2, [v2[k] + transfer.dv2[k] for k in range(3)])
+
+class RelativeTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_EARTH)
+        self.rho1 = [-0.5, -8.0, 0.3]
+        self.rho_dot1 = [0.0, 0.002, 0.0]
+        self.offset = (0.0, -0.1, 0.0)
+
+    def chaser(self, target_r, target_v, scale=1.0):
+        return from_relative(target_r, target_v, [scale * x for x in self.rho1], [scale * x for x in self.rho_dot1])
+
+    def test_round_trip(self):
+        target_r, target_v = target_state(0.1)
+        rho, rho_dot = to_relative(target_r, target_v, *self.chaser(target_r, target_v))
+        for a, b in zip(rho + rho_dot, self.rho1 + self.rho_dot1):
+            self.assertAlmostEqual(a, b, delta=1e-12)
+
+    def test_cw_matches_elliptic_for_circular_target(self):
+        target_r, target_v = target_state(0.0)
+        n = math.sqrt(MU_EARTH / 6778.0**3)
+        for dt in (600.0, 1800.0, 4000.0):
+            cw = cw_transfer(n, self.rho1, self.offset, dt)
+            elliptic = elliptic_transfer(MU_EARTH, target_r, target_v, self.rho1, self.offset, dt)
+            for a, b in zip(cw[0] + cw[1], elliptic[0] + elliptic[1]):
+                self.assertAlmostEqual(a, b, delta=1e-9)
+
+    def test_linear_models_reach_offset(self):
+        # The miss under full two-body motion is second order in the
+        # separation: tens of metres at 8 km, a quarter of that at 4 km
+        for eccentricity, method in ((0.0, 'cw'), (0.1, 'elliptic')):
+            target_r, target_v = target_state(eccentricity)
+            misses = []
+            for scale in (1.0, 0.5):
+                chaser_r, chaser_v = self.chaser(target_r, target_v, scale)
+                transfer = rendezvous(self.solver, target_r, target_v, chaser_r, chaser_v, 1800.0, self.offset)
+                self.assertEqual(transfer.method, method)
+                rho, rho_dot = arrival_offset(target_r, target_v, chaser_r, chaser_v, transfer, 1800.0)
+                misses.append(math.dist(rho, self.offset))
+                self.assertLess(math.hypot(*rho_dot), 1e-4)
+            self.assertLess(misses[0], 0.05)
+            self.assertAlmostEqual(misses[0] / misses[1], 4.0, delta=0.3)
+
+    def test_cw_misses_eccentric_target(self):
+        target_r, target_v = target_state(0.1)
+        chaser_r, chaser_v = self.chaser(target_r, target_v)
+        transfer = rendezvous(self.solver, target_r, target_v, chaser_r, chaser_v, 1800.0, self.offset,
+                              method='cw')
+        rho, _ = arrival_offset(target_r, target_v, chaser_r, chaser_v, transfer, 1800.0)
+        self.assertGreater(math.dist(rho, self.offset), 0.1)
+
+    def test_far_chaser_uses_lambert(self):
+        target_r, target_v = target_state(0.0)
+        chaser_r, chaser_v = from_relative(target_r, target_v, [0.0, -500.0, 0.0], [0.0, 0.0, 0.0])
+        transfer = rendezvous(self.solver, target_r, target_v, chaser_r, chaser_v, 1800.0, self.offset)
+        self.assertEqual(transfer.method, 'lambert')
+        self.assertIsNone(transfer.rho_dot1)
+        rho, rho_dot = arrival_offset(target_r, target_v, chaser_r, chaser_v, transfer, 1800.0)
+        self.assertLess(math.dist(rho, self.offset), 1e-3)
+        self.assertLess(math.hypot(*rho_dot), 1e-6)
+
+    def test_singular_time_of_flight(self):
+        target_r, target_v = target_state(0.0)
+        period = 2 * math.pi * math.sqrt(6778.0**3 / MU_EARTH)
+        with self.assertRaises(ValueError):
+            cw_transfer(math.sqrt(MU_EARTH / 6778.0**3), self.rho1, self.offset, period)
+        with self.assertRaises(ValueError):
+            rendezvous(self.solver, target_r, target_v, *self.chaser(target_r, target_v), 1800.0, method='hohmann')
+        dts = [1200.0, period, 2400.0]
+        result = rendezvous_batch(self.solver, target_r, target_v, *self.chaser(target_r, target_v), dts,
+                                  self.offset, chunk_size=2)
+        self.assertIsNone(result[1])
+        parallel = rendezvous_batch(self.solver, target_r, target_v, *self.chaser(target_r, target_v), dts,
+                                    self.offset, chunk_size=2, workers=2)
+        self.assertEqual([t and t.dv for t in parallel], [t and t.dv for t in result])
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,82 @@
+"""
+Escalation ladder: near-0 and near-180 degree transfers that the fast kernel
+solves badly or not at all come back within the residual limit.
+"""
+import math
+import unittest
+from unittest import mock
+import batch
+from main import LambertSolver
+from batch import solve_batch
+from kernel import RESIDUAL_FAILED, kepler_miss, status_message
+from robust import RESIDUAL_TOLERANCE, conservation_residual, escalate, solve_bisection, solve_extended
+
+MU_EARTH = 398600.4418
+
+def near_pi(eps):
+    a = math.pi - eps
+    return [7000.0, 0.0, 0.0], [42164.0 * math.cos(a), 42164.0 * math.sin(a), 0.0], 5 * 3600.0
+
+def near_zero(eps):
+    return [7000.0, 0.0, 0.0], [8000.0 * math.cos(eps), 8000.0 * math.sin(eps), 0.0], 1800.0
+
+class ResidualTest(unittest.TestCase):
+    def test_keplerian_arc_has_no_residual(self):
+        r1, r2, dt = near_pi(0.3)
+        v1, v2 = LambertSolver(MU_EARTH).solve(r1, r2, dt)
+        self.assertLess(conservation_residual(MU_EARTH, r1, r2, v1, v2), 1e-12)
+
+    def test_lost_digits_show_up(self):
+        r1, r2, dt = near_pi(0.3)
+        v1, v2 = LambertSolver(MU_EARTH).solve(r1, r2, dt)
+        self.assertGreater(conservation_residual(MU_EARTH, r1, r2, [x * (1 + 1e-7) for x in v1], v2), 1e-8)
+
+class LadderTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_EARTH)
+        self.problems = [make(10.0**-k) for k in range(1, 9) for make in (near_pi, near_zero)]
+
+    def test_fast_path_alone_misses(self):
+        result = solve_batch(self.solver, self.problems, escalation=False)
+        bad = 0
+        for k, (r1, r2, dt) in enumerate(self.problems):
+            if not result.succeeded(k) or conservation_residual(MU_EARTH, r1, r2, result.v1[k], result.v2[k]) > RESIDUAL_TOLERANCE:
+                bad += 1
+        self.assertGreater(bad, 3)
+
+    def test_escalation_meets_residual(self):
+        result = solve_batch(self.solver, self.problems)
+        self.assertEqual(result.failures(), 0)
+        for k, (r1, r2, dt) in enumerate(self.problems):
+            self.assertLessEqual(conservation_residual(MU_EARTH, r1, r2, result.v1[k], result.v2[k]), RESIDUAL_TOLERANCE)
+            self.assertLess(kepler_miss(MU_EARTH, r1, result.v1[k], r2, dt), 1e-8)
+
+    def test_well_conditioned_lanes_untouched(self):
+        # The fast path's own answer is kept wherever it already meets the limit
+        plain = solve_batch(self.solver, self.problems, escalation=False)
+        escalated = solve_batch(self.solver, self.problems)
+        for k, (r1, r2, _) in enumerate(self.problems):
+            if plain.succeeded(k) and conservation_residual(MU_EARTH, r1, r2, plain.v1[k], plain.v2[k]) <= RESIDUAL_TOLERANCE:
+                self.assertEqual(escalated.v1[k], plain.v1[k])
+
+    def test_tiers(self):
+        r1, r2, dt = near_pi(1e-7)
+        v1, v2, z = solve_bisection(MU_EARTH, r1, r2, dt)
+        self.assertLess(kepler_miss(MU_EARTH, r1, v1, r2, dt), 1e-8)
+        w1, w2 = solve_extended(MU_EARTH, r1, r2, dt, z_guess=z)
+        self.assertLessEqual(conservation_residual(MU_EARTH, r1, r2, w1, w2), RESIDUAL_TOLERANCE)
+        self.assertIn(escalate(MU_EARTH, r1, r2, dt)[2], (2, 3))
+
+    def test_collinear_is_left_unsolved(self):
+        self.assertIsNone(escalate(MU_EARTH, [7000.0, 0.0, 0.0], [-42164.0, 0.0, 0.0], 5 * 3600.0))
+
+    def test_residual_failed(self):
+        # A kernel result that no tier can repair is reported, not kept
+        r1, r2, dt = near_pi(1e-6)
+        with mock.patch.object(batch, 'escalate', return_value=None):
+            result = solve_batch(self.solver, [(r1, r2, dt)])
+        self.assertFalse(result.succeeded(0))
+        self.assertEqual(result.errors[0], status_message(RESIDUAL_FAILED, 1000))
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,48 @@
+"""
+Dual-number Lambert partials against central differences of LambertSolver.
+"""
+import unittest
+from main import LambertSolver
+from sensitivity import lambert_partials
+
+MU_EARTH = 398600.4418
+
+def central_difference(solve, h):
+    plus = solve(h)
+    minus = solve(-h)
+    return [(a - b) / (2 * h) for a, b in zip(plus[0] + plus[1], minus[0] + minus[1])]
+
+class LambertPartialsTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_EARTH)
+        self.r1 = [7000.0, 200.0, -300.0]
+        self.r2 = [-5000.0, 30000.0, 1500.0]
+        self.dt = 5 * 3600.0
+
+    def solve(self, r1, r2, dt):
+        return self.solver.solve(r1, r2, dt, tolerance=1e-14)
+
+    def assertPartials(self, partials, expected):
+        for a, b in zip(partials, expected):
+            self.assertAlmostEqual(a, b, delta=1e-6 * max(1e-3, abs(b)))
+
+    def test_values_match_solver(self):
+        v1, v2, _, _, _ = lambert_partials(MU_EARTH, self.r1, self.r2, self.dt)
+        for a, b in zip(v1 + v2, sum(self.solve(self.r1, self.r2, self.dt), [])):
+            self.assertAlmostEqual(a, b, delta=1e-9)
+
+    def test_position_directions(self):
+        d = [0.3, -0.5, 0.8]
+        _, _, dv1, dv2, _ = lambert_partials(MU_EARTH, self.r1, self.r2, self.dt, dr1=d)
+        self.assertPartials(dv1 + dv2, central_difference(
+            lambda h: self.solve([x + h * e for x, e in zip(self.r1, d)], self.r2, self.dt), 1e-2))
+        _, _, dv1, dv2, _ = lambert_partials(MU_EARTH, self.r1, self.r2, self.dt, dr2=d)
+        self.assertPartials(dv1 + dv2, central_difference(
+            lambda h: self.solve(self.r1, [x + h * e for x, e in zip(self.r2, d)], self.dt), 1e-2))
+
+    def test_time_of_flight(self):
+        _, _, dv1, dv2, _ = lambert_partials(MU_EARTH, self.r1, self.r2, self.dt, ddt=1.0)
+        self.assertPartials(dv1 + dv2, central_difference(lambda h: self.solve(self.r1, self.r2, self.dt + h), 1e-1))
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,136 @@
+"""
+Sharded jobs: interrupted runs resume to the same result as one uninterrupted
+batch, and workers only ever break stale locks and release their own.
+"""
+import os
+import shutil
+import tempfile
+import time
+import unittest
+import shard
+from batch import _solve_chunk
+from benchmark import leo_geo_problems
+from ephemeris import CircularOrbit
+from main import LambertSolver
+from sweep import porkchop_sweep
+
+MU_EARTH = 398600.4418
+MU_SUN = 1.32712440018e11
+AU = 1.495978707e8
+DAY = 86400.0
+
+class ShardJobTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+        self.addCleanup(shutil.rmtree, self.directory)
+
+    def test_catalog_resume(self):
+        problems = leo_geo_problems(50, seed=3)
+        shard.create_catalog_job(self.directory, MU_EARTH, problems, shard_size=16, chunk_size=8)
+        self.assertEqual(shard.work(self.directory, max_shards=1), 1)
+        self.assertEqual(shard.status(self.directory), (1, 0, 4))
+        with self.assertRaises(ValueError):
+            shard.collect(self.directory)
+        # A resumed run only does the remaining shards
+        self.assertEqual(shard.work(self.directory), 3)
+        self.assertEqual(shard.work(self.directory), 0)
+        result = shard.collect(self.directory)
+        expected = []
+        for lo in range(0, 50, 8):
+            expected.extend(_solve_chunk(MU_EARTH, [list(p) + [False] for p in problems[lo:lo + 8]], 1000, 1e-8))
+        self.assertEqual(result.v1, [v1 for v1, _, _ in expected])
+        self.assertEqual(result.v2, [v2 for _, v2, _ in expected])
+        self.assertEqual(result.errors, [error for _, _, error in expected])
+
+    def test_grid_matches_sweep(self):
+        earth = CircularOrbit(AU, MU_SUN)
+        mars = CircularOrbit(1.524 * AU, MU_SUN, phase=0.8, inclination=0.032)
+        departure_times = [k * 15 * DAY for k in range(6)]
+        tofs = [150 * DAY + k * 20 * DAY for k in range(7)]
+        shard.create_grid_job(self.directory, MU_SUN, earth, mars, departure_times, tofs,
+                              shard_size=7, chunk_size=1, cutoff=8.0)
+        shard.work(self.directory, max_shards=2)
+        shard.work(self.directory)
+        result = shard.collect(self.directory)
+        expected = porkchop_sweep(LambertSolver(MU_SUN), earth, mars, departure_times, tofs, chunk_size=1,
+                                  cutoff=8.0)
+        self.assertEqual(result.dv, expected.dv)
+        self.assertEqual(result.best, expected.best)
+        self.assertEqual(result.histogram, expected.histogram)
+        self.assertGreater(expected.skipped_chunks, 0)
+        for name in ('failures', 'skipped', 'skipped_hyperbolic', 'skipped_chunks'):
+            self.assertEqual(getattr(result, name), getattr(expected, name), name)
+
+    def test_solver_settings_in_manifest(self):
+        earth = CircularOrbit(AU, MU_SUN)
+        mars = CircularOrbit(1.524 * AU, MU_SUN, phase=0.8, inclination=0.032)
+        departure_times = [k * 15 * DAY for k in range(3)]
+        tofs = [150 * DAY + k * 20 * DAY for k in range(4)]
+        shard.create_grid_job(self.directory, MU_SUN, earth, mars, departure_times, tofs, shard_size=5,
+                              chunk_size=2, tolerance=1e-1)
+        shard.work(self.directory)
+        expected = porkchop_sweep(LambertSolver(MU_SUN), earth, mars, departure_times, tofs, tolerance=1e-1)
+        self.assertEqual(shard.collect(self.directory).dv, expected.dv)
+        self.assertNotEqual(expected.dv, porkchop_sweep(LambertSolver(MU_SUN), earth, mars, departure_times, tofs).dv)
+
+class ShardLockTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+        self.addCleanup(shutil.rmtree, self.directory)
+        os.makedirs(os.path.join(self.directory, 'locks'))
+        self.path = shard._lock_path(self.directory, 0)
+
+    def write_lock(self, owner, age=0.0):
+        with open(self.path, 'w') as f:
+            f.write(owner)
+        t = time.time() - age
+        os.utime(self.path, (t, t))
+
+    def read_lock(self):
+        with open(self.path) as f:
+            return f.read()
+
+    def test_fresh_lock_is_respected(self):
+        self.write_lock('other:1')
+        self.assertFalse(shard._try_claim(self.directory, 0, 600))
+        self.assertEqual(self.read_lock(), 'other:1')
+
+    def test_stale_lock_is_broken(self):
+        self.write_lock('other:1', age=1000)
+        self.assertTrue(shard._try_claim(self.directory, 0, 600))
+        self.assertEqual(self.read_lock(), shard._owner())
+        shard._release(self.directory, 0)
+        self.assertFalse(os.path.exists(self.path))
+
+    def test_release_leaves_foreign_lock(self):
+        self.write_lock('other:1')
+        shard._release(self.directory, 0)
+        self.assertEqual(self.read_lock(), 'other:1')
+
+    def test_heartbeat_only_touches_own_lock(self):
+        self.write_lock('other:1', age=1000)
+        shard._heartbeat(self.directory, 0)
+        self.assertGreater(time.time() - os.path.getmtime(self.path), 900)
+        self.write_lock(shard._owner(), age=1000)
+        shard._heartbeat(self.directory, 0)
+        self.assertLess(time.time() - os.path.getmtime(self.path), 60)
+
+    def test_rename_race_keeps_winner(self):
+        # Another worker breaks the stale lock and claims the shard between
+        # our staleness check and our rename.
+        self.write_lock('old:1', age=1000)
+        rename = os.rename
+        def racing_rename(src, dst):
+            os.remove(src)
+            self.write_lock('winner:2')
+            rename(src, dst)
+        os.rename = racing_rename
+        try:
+            self.assertFalse(shard._try_claim(self.directory, 0, 600))
+        finally:
+            os.rename = rename
+        self.assertEqual(self.read_lock(), 'winner:2')
+        self.assertEqual(os.listdir(os.path.join(self.directory, 'locks')), ['000000.lock'])
+
+if __name__ == "__main__":
+    unittest.main()
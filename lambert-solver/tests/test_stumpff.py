@@ -0,0 +1,38 @@
+"""
+Stumpff functions and the parabolic time of flight.
+"""
+import math
+import unittest
+from main import universal_time_of_flight
+from stumpff import parabolic_time, stumpff_c, stumpff_s
+
+MU_EARTH = 398600.4418
+
+class StumpffTest(unittest.TestCase):
+    def test_series_at_zero(self):
+        self.assertEqual(stumpff_c(0.0), 0.5)
+        self.assertEqual(stumpff_s(0.0), 1 / 6)
+        # C(z) = 1/2 - z/24 + ..., S(z) = 1/6 - z/120 + ... on both sides of zero
+        for z in (1e-3, -1e-3):
+            self.assertAlmostEqual(stumpff_c(z), 0.5 - z / 24 + z * z / 720, delta=1e-10)
+            self.assertAlmostEqual(stumpff_s(z), 1 / 6 - z / 120 + z * z / 5040, delta=1e-10)
+
+    def test_closed_forms(self):
+        self.assertAlmostEqual(stumpff_c(math.pi**2), 2 / math.pi**2, places=15)
+        self.assertAlmostEqual(stumpff_s(4 * math.pi**2), 1 / (4 * math.pi**2), places=15)
+        self.assertAlmostEqual(stumpff_c(-1.0), (math.cosh(1.0) - 1), places=14)
+        self.assertAlmostEqual(stumpff_s(-1.0), math.sinh(1.0) - 1, places=14)
+
+class ParabolicTimeTest(unittest.TestCase):
+    def test_matches_universal_time_at_zero_z(self):
+        # z = 0 is the parabola, so the universal time of flight there is Lambert's parabolic time
+        r1_norm, r2_norm = 7000.0, 12000.0
+        for dnu in (0.5, 2.0, 3.0, 4.0, 5.5):
+            c = math.sqrt(r1_norm**2 + r2_norm**2 - 2 * r1_norm * r2_norm * math.cos(dnu))
+            s = (r1_norm + r2_norm + c) / 2
+            A = math.sin(dnu) * math.sqrt(r1_norm * r2_norm / (1 - math.cos(dnu)))
+            expected = universal_time_of_flight(0.0, r1_norm, r2_norm, A, MU_EARTH)
+            self.assertAlmostEqual(parabolic_time(s, c, MU_EARTH, dnu > math.pi), expected, delta=1e-9 * expected)
+
+if __name__ == "__main__":
+    unittest.main()
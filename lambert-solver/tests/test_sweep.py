@@ -0,0 +1,101 @@
+"""
+Porkchop sweeps give bitwise identical grids, best cells and histograms for
+any worker count and chunk size.
+"""
+import os
+import unittest
+from main import LambertSolver
+from batch import Selection
+from ephemeris import CircularOrbit
+from numa import NumaPlacement
+from sweep import dv_lower_bound, porkchop_sweep
+
+MU_SUN = 1.32712440018e11
+AU = 1.495978707e8
+DAY = 86400.0
+
+class SweepTest(unittest.TestCase):
+    def setUp(self):
+        self.solver = LambertSolver(MU_SUN)
+        self.earth = CircularOrbit(AU, MU_SUN)
+        self.mars = CircularOrbit(1.524 * AU, MU_SUN, phase=0.8, inclination=0.032)
+        self.departure_times = [k * 9 * DAY for k in range(16)]
+        self.tofs = [120 * DAY + k * 11 * DAY for k in range(16)]
+
+    def sweep(self, **kwargs):
+        return porkchop_sweep(self.solver, self.earth, self.mars, self.departure_times, self.tofs, **kwargs)
+
+    def test_worker_count_and_chunking(self):
+        reference = self.sweep()
+        for workers, chunk_size in ((1, 5), (1, 64), (3, 5), (3, 256)):
+            result = self.sweep(workers=workers, chunk_size=chunk_size)
+            self.assertEqual(result.dv, reference.dv, (workers, chunk_size))
+            self.assertEqual(result.best, reference.best, (workers, chunk_size))
+            self.assertEqual(result.histogram, reference.histogram, (workers, chunk_size))
+
+    def test_best_is_grid_minimum(self):
+        result = self.sweep()
+        cells = [(dv, (i, j)) for i, row in enumerate(result.dv) for j, dv in enumerate(row) if dv is not None]
+        dv, cell = min(cells)
+        self.assertEqual(result.best, (cell, dv))
+        self.assertEqual(sum(result.histogram), len(cells))
+
+    def test_selection_matches_full_grid(self):
+        full = self.sweep()
+        cells = sorted((dv, (i, j)) for i, row in enumerate(full.dv) for j, dv in enumerate(row) if dv is not None)
+        cpus = sorted(os.sched_getaffinity(0))
+        with NumaPlacement(nodes={0: cpus, 1: cpus}, workers_per_node=1) as placement:
+            for workers, chunk_size, placement_ in ((1, 5, None), (3, 64, None), (1, 7, placement)):
+                top = self.sweep(workers=workers, chunk_size=chunk_size, select=Selection(top_k=8),
+                                 placement=placement_)
+                self.assertIsNone(top.dv)
+                self.assertEqual(top.selected, [(cell, dv) for dv, cell in cells[:8]])
+                self.assertEqual(top.best, full.best)
+                below = self.sweep(workers=workers, chunk_size=chunk_size, select=Selection(threshold=7.0),
+                                   placement=placement_)
+                self.assertEqual(below.selected, [(cell, dv) for dv, cell in cells if dv < 7.0])
+
+    def test_solver_settings_reach_cells(self):
+        full = self.sweep()
+        loose = self.sweep(tolerance=1e-1)
+        self.assertNotEqual(loose.dv, full.dv)
+        for row, full_row in zip(loose.dv, full.dv):
+            for dv, full_dv in zip(row, full_row):
+                self.assertAlmostEqual(dv, full_dv, delta=1e-3 * full_dv)
+
+    def test_lower_bound_below_dv(self):
+        full = self.sweep()
+        for i, t0 in enumerate(self.departure_times):
+            for j, tof in enumerate(self.tofs):
+                r1, vb1 = self.earth.state(t0)
+                r2, vb2 = self.mars.state(t0 + tof)
+                bound, hyperbolic = dv_lower_bound(MU_SUN, r1, vb1, r2, vb2, tof)
+                self.assertFalse(hyperbolic)
+                self.assertLessEqual(bound, full.dv[i][j] + 1e-9)
+
+    def test_cutoff_keeps_cells_below_it(self):
+        full = self.sweep()
+        bounded = self.sweep(cutoff=7.0)
+        self.assertGreater(bounded.skipped, 0)
+        for row, full_row in zip(bounded.dv, full.dv):
+            for dv, full_dv in zip(row, full_row):
+                if full_dv is not None and full_dv <= 7.0:
+                    self.assertEqual(dv, full_dv)
+                elif dv is None:
+                    self.assertGreater(full_dv, 7.0)
+        self.assertEqual(bounded.best, full.best)
+
+    def test_skip_counters(self):
+        # Nothing beats 0.5 km/s, so every chunk is skipped without a solve
+        none = self.sweep(cutoff=0.5, chunk_size=10)
+        self.assertEqual(none.skipped, 256)
+        self.assertEqual(none.skipped_chunks, 26)
+        self.assertIsNone(none.best)
+        # Transfers much faster than the parabola are bounded by the hyperbolic energy limit
+        fast = porkchop_sweep(self.solver, self.earth, self.mars, self.departure_times, [2 * DAY, 4 * DAY],
+                              cutoff=20.0)
+        self.assertEqual(fast.skipped_hyperbolic, fast.skipped)
+        self.assertGreater(fast.skipped, 0)
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,82 @@
+"""
+Tisserand contours against the Hohmann transfer, and graph feasibility of
+flyby sequences.
+"""
+import math
+import unittest
+from tisserand import MU_SUN, ORBIT_RADII, TisserandGraph, contour, vinf_at
+
+R_EARTH = ORBIT_RADII['earth']
+R_MARS = ORBIT_RADII['mars']
+
+def hohmann_vinf(r_from, r_to):
+    # v_inf at both ends of the Hohmann transfer between circular orbits
+    a = (r_from + r_to) / 2
+    depart = math.sqrt(MU_SUN / r_from) * abs(math.sqrt(r_to / a) - 1)
+    arrive = math.sqrt(MU_SUN / r_to) * abs(1 - math.sqrt(r_from / a))
+    return depart, arrive
+
+class ContourTest(unittest.TestCase):
+    def test_hohmann(self):
+        a = (R_EARTH + R_MARS) / 2
+        e = (R_MARS - R_EARTH) / (R_MARS + R_EARTH)
+        depart, arrive = hohmann_vinf(R_EARTH, R_MARS)
+        self.assertAlmostEqual(vinf_at(R_EARTH, a, e), depart, delta=1e-9)
+        self.assertAlmostEqual(vinf_at(R_MARS, a, e), arrive, delta=1e-9)
+
+    def test_unreached_orbit(self):
+        self.assertIsNone(vinf_at(R_MARS, R_EARTH, 0.1))
+
+    def test_contour_keeps_vinf(self):
+        orbits = contour(R_EARTH, 4.0)
+        self.assertEqual(len(orbits), 181)
+        # The pump angles 0 and pi put the body exactly at an apsis, where
+        # rounding may place it just outside the orbit
+        for a, e, rp, ra in orbits[1:-1]:
+            self.assertLessEqual(rp, R_EARTH * (1 + 1e-12))
+            self.assertGreaterEqual(ra, R_EARTH * (1 - 1e-12))
+            self.assertAlmostEqual(vinf_at(R_EARTH, a, e), 4.0, delta=1e-6)
+
+    def test_hyperbolic_orbits_skipped(self):
+        # Above sqrt(2) - 1 of the circular speed every prograde pump angle escapes
+        escape = (math.sqrt(2) - 1) * math.sqrt(MU_SUN / R_EARTH)
+        self.assertLess(len(contour(R_EARTH, escape + 1.0)), 181)
+
+class GraphTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        bodies = {name: ORBIT_RADII[name] for name in ('venus', 'earth', 'mars', 'jupiter')}
+        cls.graph = TisserandGraph(bodies)
+
+    def test_level_mask(self):
+        graph = self.graph
+        self.assertEqual(graph.level_mask(0.0, 0.5), 0b1)
+        self.assertEqual(graph.level_mask(0.9, 1.6), 0b110)
+        self.assertEqual(graph.widen(0b100, 1), 0b1110)
+        self.assertEqual(graph.widen(1 << (len(graph.levels) - 1), 2) >> len(graph.levels), 0)
+
+    def test_hohmann_is_reachable(self):
+        depart, arrive = hohmann_vinf(R_EARTH, R_MARS)
+        mask = self.graph.sequence_mask(('earth', 'mars'), depart + 0.25)
+        self.assertTrue(mask & self.graph.level_mask(arrive, arrive))
+        self.assertTrue(self.graph.feasible(('earth', 'mars'), depart + 0.25))
+        self.assertFalse(self.graph.feasible(('earth', 'mars'), depart - 1.0))
+        self.assertFalse(self.graph.feasible(('earth', 'mars'), depart + 0.25, vinf_arrival=0.5))
+
+    def test_jupiter_needs_energy(self):
+        self.assertFalse(self.graph.feasible(('earth', 'jupiter'), 4.0))
+        self.assertTrue(self.graph.feasible(('earth', 'jupiter'), 10.0))
+
+    def test_sequence_mask_is_memoized_transition(self):
+        graph = self.graph
+        sequence = ('earth', 'venus', 'earth', 'jupiter')
+        mask = graph.level_mask(0.0, 4.0)
+        for p, q in zip(sequence, sequence[1:]):
+            if p != sequence[0]:
+                mask = graph.widen(mask, 1)
+            mask = graph.transition(p, q, mask)
+        self.assertEqual(graph.sequence_mask(sequence, 4.0), mask)
+        self.assertIs(graph.sequence_mask(sequence, 4.0), graph.sequence_mask(list(sequence), 4.0))
+
+if __name__ == "__main__":
+    unittest.main()
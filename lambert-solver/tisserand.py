@@ -0,0 +1,182 @@
+"""
+Tisserand-graph pruning for flyby sequence search.
+
+An unpowered flyby keeps |v_inf| at the flyby body, i.e. the spacecraft's
+Tisserand parameter with respect to that body. For a body on a circular
+orbit of radius R and speed V, each v_inf level is a contour of
+heliocentric orbits (rp, ra), parameterized by the pump angle between v_inf
+and V. An orbit on the contour of body P at level i that also crosses the
+orbit of body Q has a definite v_inf at Q, v_inf^2 / V_Q^2 = 3 - T_Q with
+T_Q = R_Q / a + 2 sqrt(a (1 - e^2) / R_Q).
+
+TisserandGraph samples every contour once and stores, for each body pair and
+level, the bitmask of levels reachable at the other body. Resonant returns
+to the same body (period ratios n:m) are stored as the P -> P masks. A
+sequence query then propagates a level mask along the sequence, with one
+table lookup per leg once a (pair, mask) transition has been seen, and only
+sequences whose mask never empties can be flown. mga.candidate_sequences
+uses this before any Lambert solve.
+"""
+import math
+from bisect import bisect_left, bisect_right
+from itertools import product
+
+MU_SUN = 1.32712440018e11  # km^3/s^2
+AU = 1.495978707e8  # km
+
+# Mean orbit radii (km), treated as circular and coplanar
+ORBIT_RADII = {
+    'mercury': 0.387098 * AU,
+    'venus': 0.723332 * AU,
+    'earth': 1.0 * AU,
+    'mars': 1.523679 * AU,
+    'jupiter': 5.2044 * AU,
+    'saturn': 9.5826 * AU,
+    'uranus': 19.2184 * AU,
+    'neptune': 30.11 * AU,
+}
+
+DEFAULT_LEVELS = tuple(0.5 * k for k in range(1, 31))  # km/s
+
+def contour(radius, vinf, mu=MU_SUN, samples=181):
+    """
+    Heliocentric orbits with the given v_inf at a body on a circular orbit,
+    over pump angles 0..pi (in-plane, zero crank).
+
+    :return: List of (a, e, rp, ra); hyperbolic orbits are skipped
+    """
+    v_body = math.sqrt(mu / radius)
+    out = []
+    for k in range(samples):
+        alpha = math.pi * k / (samples - 1)
+        tangential = v_body + vinf * math.cos(alpha)
+        v_sq = tangential**2 + (vinf * math.sin(alpha))**2
+        energy = v_sq / 2 - mu / radius
+        if energy >= 0:
+            continue
+        a = -mu / (2 * energy)
+        p = (radius * tangential)**2 / mu
+        e = math.sqrt(max(1 - p / a, 0.0))
+        out.append((a, e, a * (1 - e), a * (1 + e)))
+    return out
+
+def vinf_at(radius, a, e, mu=MU_SUN):
+    """v_inf (km/s) of orbit (a, e) at a circular-orbit body, or None if the orbit does not reach it."""
+    if not a * (1 - e) <= radius <= a * (1 + e):
+        return None
+    tisserand = radius / a + 2 * math.sqrt(a * (1 - e * e) / radius)
+    return math.sqrt(mu / radius) * math.sqrt(max(3 - tisserand, 0.0))
+
+class TisserandGraph:
+    """
+    Precomputed level-to-level reachability between bodies.
+
+    :param bodies: Body name -> orbit radius (km); default ORBIT_RADII
+    :param levels: Increasing v_inf levels (km/s); level j covers the half
+                   spacing around levels[j]
+    :param mu: Gravitational parameter of the central body
+    :param samples: Pump-angle samples per contour
+    :param resonances: Largest n and m of the n:m resonant returns to one body
+    """
+    def __init__(self, bodies=None, levels=DEFAULT_LEVELS, mu=MU_SUN, samples=181, resonances=4):
+        self.bodies = dict(bodies if bodies is not None else ORBIT_RADII)
+        self.levels = tuple(levels)
+        self.mu = mu
+        # Bin j spans edges[j]..edges[j + 1], halfway between neighbouring levels
+        self.edges = [0.0] + [(a + b) / 2 for a, b in zip(self.levels, self.levels[1:])] + [float('inf')]
+        self.reach = {}
+        self._transitions = {}
+        self._sequences = {}
+        for p, r_p in self.bodies.items():
+            for i, vinf in enumerate(self.levels):
+                orbits = contour(r_p, vinf, mu, samples)
+                for q, r_q in self.bodies.items():
+                    masks = self.reach.setdefault((p, q), [0] * len(self.levels))
+                    if p == q:
+                        masks[i] = self._resonant(r_p, orbits, i, resonances)
+                    else:
+                        masks[i] = self._crossing(r_q, orbits)
+
+    def level_mask(self, low, high):
+        """Bitmask of the levels inside [low, high] (km/s), widened to whole bins."""
+        first = max(bisect_right(self.edges, low) - 1, 0)
+        stop = min(bisect_left(self.edges, high), len(self.levels))
+        if stop <= first:
+            stop = first + 1
+        return ((1 << stop) - 1) ^ ((1 << first) - 1)
+
+    def _crossing(self, r_q, orbits):
+        # Levels hit at Q between consecutive contour samples that both reach Q
+        mask = 0
+        previous = None
+        for a, e, _, _ in orbits:
+            v = vinf_at(r_q, a, e, self.mu)
+            if v is not None:
+                low, high = (v, v) if previous is None else (min(v, previous), max(v, previous))
+                mask |= self.level_mask(low, high)
+            previous = v
+        return mask
+
+    def _resonant(self, r_p, orbits, i, resonances):
+        # Level i returns to P if an n:m resonant orbit (a = R (n / m)^(2/3))
+        # lies within the contour's range of semi-major axes
+        if not orbits:
+            return 0
+        a_low = min(o[0] for o in orbits)
+        a_high = max(o[0] for o in orbits)
+        for n, m in product(range(1, resonances + 1), repeat=2):
+            if a_low <= r_p * (n / m)**(2 / 3) <= a_high:
+                return 1 << i
+        return 0
+
+    def widen(self, mask, slack):
+        """mask grown by slack levels either side (powered flybys, deep-space manoeuvres)."""
+        for _ in range(slack):
+            mask |= (mask << 1) | (mask >> 1)
+        return mask & ((1 << len(self.levels)) - 1)
+
+    def transition(self, p, q, mask):
+        """Levels reachable at q from any level in mask at p."""
+        key = (p, q, mask)
+        out = self._transitions.get(key)
+        if out is None:
+            out = 0
+            rows = self.reach[(p, q)]
+            m = mask
+            while m:
+                low_bit = m & -m
+                out |= rows[low_bit.bit_length() - 1]
+                m ^= low_bit
+            self._transitions[key] = out
+        return out
+
+    def sequence_mask(self, sequence, vinf_launch, slack=1):
+        """
+        Levels possible on arrival at the last body of sequence, starting
+        from levels up to vinf_launch at the first body. Prefixes are
+        memoized, so extending a known sequence by one body is one lookup.
+        """
+        key = (tuple(sequence), vinf_launch, slack)
+        out = self._sequences.get(key)
+        if out is not None:
+            return out
+        if len(sequence) == 1:
+            out = self.level_mask(0.0, vinf_launch)
+        else:
+            mask = self.sequence_mask(sequence[:-1], vinf_launch, slack)
+            if len(sequence) > 2:
+                # sequence[-2] is a flyby body; its v_inf may change by slack levels
+                mask = self.widen(mask, slack)
+            out = self.transition(sequence[-2], sequence[-1], mask)
+        self._sequences[key] = out
+        return out
+
+    def feasible(self, sequence, vinf_launch, vinf_arrival=None, slack=1):
+        """
+        True if sequence can be flown with launch v_inf up to vinf_launch
+        and, if given, arrival v_inf up to vinf_arrival.
+        """
+        mask = self.sequence_mask(sequence, vinf_launch, slack)
+        if vinf_arrival is not None:
+            mask &= self.level_mask(0.0, vinf_arrival)
+        return mask != 0